@@ -0,0 +1,309 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "..\math\use_math.h"
+
+/*End-to-end ray casting workload: renders primary and shadow lines of an instanced scene on a
+  growing number of threads and reports the throughput, the scaling efficiency and, where the
+  platform exposes them, the cache misses per line.
+
+  Usage: math.bench [-t max threads] [mesh file]
+  Without a mesh file (written by geom::saveMesh) a procedural terrain tile is instanced instead.*/
+
+namespace {
+
+	constexpr int WIDTH = 1280;
+	constexpr int HEIGHT = 720;
+	constexpr int TILE_SIZE = 16;
+	constexpr int INSTANCES_PER_SIDE = 16;
+	constexpr int TERRAIN_RESOLUTION = 128;
+	constexpr int FRAMES = 3;
+
+	using Clock = std::chrono::steady_clock;
+
+	/*Height field over [-1,1]^2 facing +z, 2*resolution^2 triangles.*/
+	geom::TriangleMesh createTerrain(int resolution)
+	{
+		std::vector<mpn::Point3> vertices;
+		vertices.reserve(size_t(resolution + 1) * (resolution + 1));
+		for (int y = 0; y <= resolution; ++y)
+			for (int x = 0; x <= resolution; ++x)
+			{
+				const float u = 2.0f * x / resolution - 1.0f;
+				const float v = 2.0f * y / resolution - 1.0f;
+				vertices.emplace_back(u, v, 0.3f * sinf(3.0f * u) * cosf(4.0f * v) + mpn::frand(0.0f, 0.05f));
+			}
+
+		std::vector<geom::IndexedMesh::Indices> indices;
+		indices.reserve(size_t(resolution) * resolution * 2);
+		const std::uint32_t stride = resolution + 1;
+		for (int y = 0; y < resolution; ++y)
+			for (int x = 0; x < resolution; ++x)
+			{
+				const std::uint32_t corner = y * stride + x;
+				indices.push_back({ corner, corner + 1, corner + stride + 1 });
+				indices.push_back({ corner, corner + stride + 1, corner + stride });
+			}
+
+		// The indexed mesh bounds its triangles with createAABB, the flat copy is what instances share
+		const geom::IndexedMesh indexed(std::move(vertices), std::move(indices));
+		std::vector<geom::Triangle> triangles;
+		triangles.reserve(indexed.size());
+		for (std::uint32_t i = 0; i < indexed.size(); ++i)
+			triangles.push_back(indexed.getTriangle(i));
+		return geom::TriangleMesh(std::move(triangles));
+	}
+
+	/*Grid of randomly turned and scaled copies of the mesh in front of a camera at the origin looking down -z.*/
+	geom::InstancedScene createScene(const geom::TriangleMesh& mesh, int perSide)
+	{
+		const geom::AABB& bounds = mesh.getBounds();
+		const mpn::Vector3 extent = bounds.maxCoords - bounds.minCoords;
+		const float scale = 2.0f / std::max(std::max(extent[0], extent[1]), extent[2]);
+		const mpn::Point3 center = bounds.minCoords + extent * 0.5f;
+
+		std::vector<geom::Instance> instances;
+		instances.reserve(size_t(perSide) * perSide);
+		for (int y = 0; y < perSide; ++y)
+			for (int x = 0; x < perSide; ++x)
+			{
+				const mpn::Point3 position(2.2f * (x - 0.5f * (perSide - 1)), 2.2f * (y - 0.5f * (perSide - 1)), -25.0f + mpn::frand(-2.0f, 2.0f));
+				const geom::Line axis(mpn::Point3(0.0f, 0.0f, 0.0f), mpn::Vector3(0.0f, 0.0f, 1.0f));
+				const float s = scale * mpn::frand(0.8f, 1.2f);
+				const mpn::Transform centering(mpn::Vector3(1.0f, 1.0f, 1.0f), mpn::Point3(0.0f, 0.0f, 0.0f) - center);
+				const mpn::Transform placement(mpn::Vector3(s, s, s), axis, mpn::frand(0.0f, 2.0f * PI), position);
+				instances.push_back(geom::Instance{ &mesh, centering * placement });
+			}
+		return geom::InstancedScene(std::move(instances));
+	}
+
+	/*Hardware cache miss counter of the calling thread and the threads it starts while counting.
+	  Only implemented on Linux (perf events), elsewhere it is never available.*/
+	class CacheMissCounter
+	{
+	public:
+		CacheMissCounter()
+		{
+#ifdef __linux__
+			perf_event_attr attributes{};
+			attributes.type = PERF_TYPE_HARDWARE;
+			attributes.size = sizeof(attributes);
+			attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+			attributes.disabled = 1;
+			attributes.inherit = 1;
+			attributes.exclude_kernel = 1;
+			attributes.exclude_hv = 1;
+			descriptor = static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+#endif
+		}
+
+		~CacheMissCounter()
+		{
+#ifdef __linux__
+			if (descriptor >= 0)
+				close(descriptor);
+#endif
+		}
+
+		CacheMissCounter(const CacheMissCounter&) = delete;
+		CacheMissCounter& operator=(const CacheMissCounter&) = delete;
+
+		bool available() const noexcept { return descriptor >= 0; }
+
+		void start() noexcept
+		{
+#ifdef __linux__
+			if (descriptor >= 0)
+			{
+				ioctl(descriptor, PERF_EVENT_IOC_RESET, 0);
+				ioctl(descriptor, PERF_EVENT_IOC_ENABLE, 0);
+			}
+#endif
+		}
+
+		/*Counts of the threads started in between are only included once they are joined.*/
+		std::uint64_t stop() noexcept
+		{
+			std::uint64_t count = 0;
+#ifdef __linux__
+			if (descriptor >= 0)
+			{
+				ioctl(descriptor, PERF_EVENT_IOC_DISABLE, 0);
+				if (read(descriptor, &count, sizeof(count)) != sizeof(count))
+					count = 0;
+			}
+#endif
+			return count;
+		}
+
+	private:
+		int descriptor = -1;
+	};
+
+	struct FrameResult
+	{
+		double seconds = 0.0;
+		std::uint64_t lines = 0;
+		std::uint64_t hits = 0;
+		std::uint64_t shadowed = 0;
+		std::uint64_t cacheMisses = 0;
+	};
+
+	FrameResult renderFrame(const geom::InstancedScene& scene, const geom::Camera& camera, const mpn::Point3& light, int threadCount, CacheMissCounter& counter)
+	{
+		const int tilesX = (camera.getWidth() + TILE_SIZE - 1) / TILE_SIZE;
+		const int tilesY = (camera.getHeight() + TILE_SIZE - 1) / TILE_SIZE;
+		const int tileCount = tilesX * tilesY;
+		std::atomic<int> nextTile{ 0 };
+		std::atomic<std::uint64_t> totalLines{ 0 }, totalHits{ 0 }, totalShadowed{ 0 };
+
+		auto worker = [&]()
+		{
+			geom::LineBuffer lines;
+			std::uint64_t lineCount = 0, hitCount = 0, shadowedCount = 0;
+			for (int tile = nextTile++; tile < tileCount; tile = nextTile++)
+			{
+				const int x0 = (tile % tilesX) * TILE_SIZE;
+				const int y0 = (tile / tilesX) * TILE_SIZE;
+				camera.generateTile(x0, y0, std::min(TILE_SIZE, camera.getWidth() - x0), std::min(TILE_SIZE, camera.getHeight() - y0), lines);
+				for (size_t i = 0; i < lines.size(); ++i)
+				{
+					const geom::Line primary = lines.line(i);
+					const geom::InstanceHit hit = scene.intersect(primary);
+					++lineCount;
+					if (hit.distance < 0.0f)
+						continue;
+					++hitCount;
+
+					const mpn::Point3 point = primary.P + primary.v * hit.distance;
+					const geom::Line shadow(point, light - point);
+					++lineCount;
+					if (scene.occludes(geom::Line(shadow.P + shadow.v * 1e-4f, shadow.v), 1.0f))
+						++shadowedCount;
+				}
+			}
+			totalLines += lineCount;
+			totalHits += hitCount;
+			totalShadowed += shadowedCount;
+		};
+
+		counter.start();
+		const Clock::time_point begin = Clock::now();
+		std::vector<std::thread> workers;
+		workers.reserve(threadCount - 1);
+		for (int i = 1; i < threadCount; ++i)
+			workers.emplace_back(worker);
+		worker();
+		for (std::thread& thread : workers)
+			thread.join();
+		const Clock::time_point end = Clock::now();
+
+		FrameResult result;
+		result.cacheMisses = counter.stop();
+		result.seconds = std::chrono::duration<double>(end - begin).count();
+		result.lines = totalLines;
+		result.hits = totalHits;
+		result.shadowed = totalShadowed;
+		return result;
+	}
+
+	double secondsSince(Clock::time_point begin)
+	{
+		return std::chrono::duration<double>(Clock::now() - begin).count();
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	try
+	{
+		// Fixed seed, so every run builds and renders the same scene
+		mpn::randomEngine.seed(1);
+		int maxThreads = mpn::defaultThreadCount();
+		std::string meshPath;
+		for (int i = 1; i < argc; ++i)
+		{
+			const std::string argument = argv[i];
+			if (argument == "-t" && i + 1 < argc)
+				maxThreads = std::max(1, std::atoi(argv[++i]));
+			else
+				meshPath = argument;
+		}
+
+		Clock::time_point begin = Clock::now();
+		const geom::TriangleMesh mesh = meshPath.empty() ? createTerrain(TERRAIN_RESOLUTION) : geom::loadMesh(meshPath);
+		std::printf("mesh:  %zu triangles, %.1f ms\n", mesh.getTriangles().size(), 1000.0 * secondsSince(begin));
+
+		begin = Clock::now();
+		const geom::InstancedScene scene = createScene(mesh, INSTANCES_PER_SIDE);
+		std::printf("scene: %zu instances, %.1f ms\n", scene.getInstances().size(), 1000.0 * secondsSince(begin));
+
+		// Perspective projection for row vectors, 90 degree vertical field of view, near 1, far 100
+		const float aspect = float(WIDTH) / float(HEIGHT);
+		const mpn::Matrix4 projection(
+			1.0f / aspect, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f, -101.0f / 99.0f, -1.0f,
+			0.0f, 0.0f, -200.0f / 99.0f, 0.0f);
+		const mpn::Matrix4 inverseProjection(
+			aspect, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f, 0.0f, -99.0f / 200.0f,
+			0.0f, 0.0f, -1.0f, 101.0f / 200.0f);
+		const geom::Camera camera(projection, inverseProjection, WIDTH, HEIGHT);
+		const mpn::Point3 light(20.0f, 30.0f, 10.0f);
+
+		CacheMissCounter counter;
+		std::vector<int> threadCounts;
+		for (int threads = 1; threads < maxThreads; threads *= 2)
+			threadCounts.push_back(threads);
+		threadCounts.push_back(maxThreads);
+
+		std::printf("\n%8s %10s %10s %9s %11s %14s\n", "threads", "ms/frame", "Mlines/s", "speedup", "efficiency", "misses/line");
+		double singleThreadRate = 0.0;
+		for (int threads : threadCounts)
+		{
+			// Best of a few frames, the first one also warms up the caches
+			FrameResult best;
+			for (int frame = 0; frame < FRAMES; ++frame)
+			{
+				const FrameResult result = renderFrame(scene, camera, light, threads, counter);
+				if (frame == 0 || result.seconds < best.seconds)
+					best = result;
+			}
+			const double rate = best.lines / best.seconds;
+			if (singleThreadRate == 0.0)
+				singleThreadRate = rate;
+			const double speedup = rate / singleThreadRate;
+
+			char misses[32] = "n/a";
+			if (counter.available())
+				std::snprintf(misses, sizeof(misses), "%.2f", double(best.cacheMisses) / double(best.lines));
+			std::printf("%8d %10.2f %10.2f %9.2f %10.0f%% %14s   (%llu hits, %llu shadowed)\n",
+				threads, 1000.0 * best.seconds, rate / 1e6, speedup, 100.0 * speedup / threads, misses,
+				static_cast<unsigned long long>(best.hits), static_cast<unsigned long long>(best.shadowed));
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "../nuketest/nuketest/use_nuketest.h"
+
+#include "../math/broadphase.h"
+#include "../math/random.h"
+
+TEST_MODULE(BroadphaseTest)
+{
+	using namespace geom;
+
+	TEST(SweepAndPrune_MatchesBruteForceAcrossUpdates)
+	{
+		std::vector<AABB> boxes;
+		for (int i = 0; i < 2000; ++i)
+		{
+			const mpn::Point3 corner(mpn::frand(-50.0f, 50.0f), mpn::frand(-10.0f, 10.0f), mpn::frand(-10.0f, 10.0f));
+			boxes.emplace_back(corner, corner + mpn::Vector3(mpn::frand(0.1f, 2.0f), mpn::frand(0.1f, 2.0f), mpn::frand(0.1f, 2.0f)));
+		}
+
+		SweepAndPrune broadphase;
+		for (int step = 0; step < 3; ++step)
+		{
+			broadphase.update(boxes, 3);
+			ASSERT_EQUALS(broadphase.getAxis(), 0);
+
+			std::vector<SweepAndPrune::Pair> expected;
+			for (std::uint32_t a = 0; a < boxes.size(); ++a)
+				for (std::uint32_t b = a + 1; b < boxes.size(); ++b)
+					if (overlaps(boxes[a], boxes[b]))
+						expected.emplace_back(a, b);
+			std::vector<SweepAndPrune::Pair> pairs = broadphase.getPairs();
+			std::sort(pairs.begin(), pairs.end());
+			ASSERT_TRUE(pairs == expected);
+
+			for (AABB& box : boxes)
+			{
+				const mpn::Vector3 displacement(mpn::frand(-0.3f, 0.3f), mpn::frand(-0.3f, 0.3f), mpn::frand(-0.3f, 0.3f));
+				box = AABB(box.minCoords + displacement, box.maxCoords + displacement);
+			}
+		}
+	}
+}
@@ -0,0 +1,441 @@
+#pragma once
+
+#include <cfloat>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include "../nuketest/nuketest/use_nuketest.h"
+
+#include "../math/batch.h"
+#include "../math/frustum.h"
+#include "../math/instancing.h"
+#include "../math/math.h"
+#include "../math/mesh.h"
+#include "../math/meshfile.h"
+#include "../math/quantized.h"
+#include "../math/random.h"
+#include "../math/widebvh.h"
+
+#include "test_geometry.h"
+
+TEST_MODULE(BVHTest)
+{
+	using namespace geom;
+	using namespace geomTest;
+
+	TEST(BVH_Empty)
+	{
+		TriangleMesh mesh(std::vector<Triangle>{});
+
+		ASSERT_TRUE(mesh.getBVH().empty());
+		ASSERT_EQUALS(INVALID_DISTANCE, mesh.intersect(Line(mpn::Point3(0, 0, 0), mpn::Vector3(0, 0, -1))));
+	}
+
+	TEST(BVH_BoundsContainAllTriangles)
+	{
+		const std::vector<Triangle> triangles = createRandomTriangles(500);
+		TriangleMesh mesh(triangles);
+
+		for (const Triangle& triangle : triangles)
+			ASSERT_TRUE(mesh.getBounds().contains(createAABB(triangle)));
+	}
+
+	TEST(BVH_ClosestHitMatchesBruteForce)
+	{
+		const std::vector<Triangle> triangles = createRandomTriangles(2000);
+		TriangleMesh mesh(triangles);
+
+		for (int i = 0; i < 500; ++i)
+		{
+			const Line line = createRandomLine();
+			ASSERT_EQUALS(bruteForceIntersect(triangles, line), mesh.intersect(line));
+		}
+	}
+
+	TEST(BVH_OcclusionMatchesClosestHit)
+	{
+		const TriangleMesh mesh(createRandomTriangles(2000));
+
+		for (int i = 0; i < 1000; ++i)
+		{
+			const Line line = createRandomLine();
+			const float distance = mesh.intersect(line);
+			if (distance >= 0.0f)
+			{
+				ASSERT_TRUE(mesh.occludes(line, distance * 1.01f + mpn::EPSILON));
+				ASSERT_FALSE(mesh.occludes(line, distance * 0.99f - mpn::EPSILON));
+			}
+			else
+			{
+				ASSERT_FALSE(mesh.occludes(line, FLT_MAX));
+			}
+		}
+	}
+
+	TEST(WideBVH_MatchesBinaryBVH)
+	{
+		const TriangleMesh mesh(createRandomTriangles(3000));
+		const WideBVH<4> wide4(mesh.getBVH());
+		const WideBVH<8> wide8(mesh.getBVH());
+		auto intersectTriangle = [&mesh](std::uint32_t index, const Line& line) { return mesh.getTriangles()[index].intersect(line); };
+		auto occludesTriangle = [&mesh](std::uint32_t index, const Line& line, float maxDistance) { return mesh.getTriangles()[index].occludes(line, maxDistance); };
+
+		for (int i = 0; i < 1000; ++i)
+		{
+			const Line line = createRandomLine();
+			const float expected = mesh.intersect(line);
+			ASSERT_EQUALS(expected, wide4.intersect(line, intersectTriangle));
+			ASSERT_EQUALS(expected, wide8.intersect(line, intersectTriangle));
+			if (expected >= 0.0f)
+			{
+				ASSERT_TRUE(wide4.occludes(line, expected * 1.01f + mpn::EPSILON, occludesTriangle));
+				ASSERT_TRUE(wide8.occludes(line, expected * 1.01f + mpn::EPSILON, occludesTriangle));
+			}
+			else
+			{
+				ASSERT_FALSE(wide4.occludes(line, FLT_MAX, occludesTriangle));
+				ASSERT_FALSE(wide8.occludes(line, FLT_MAX, occludesTriangle));
+			}
+		}
+	}
+
+	TEST(WideBVH_ChildTestCoversBothHalvesOfEightWideNodes)
+	{
+		// Unit boxes along the x axis at x = 2i, every other one lifted off the line; the last slot is unused
+		WideBVHNode<8> node{};
+		node.childCount = 7;
+		for (int i = 0; i < 8; ++i)
+		{
+			const float lift = i % 2 == 0 ? 0.0f : 5.0f;
+			const float min[3] = { 2.0f * i, -0.5f + lift, -0.5f };
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				node.minCoords[axis][i] = min[axis];
+				node.maxCoords[axis][i] = min[axis] + 1.0f;
+			}
+		}
+		const WideLine line(Line(mpn::Point3(-1.0f, 0.0f, 0.0f), mpn::Vector3(1.0f, 0.0f, 0.0f)));
+		alignas(32) float distances[8];
+
+		ASSERT_EQUALS(intersectChildren(node, line, FLT_MAX, distances), 0x55 & 0x7F);
+		for (int i = 0; i < 8; i += 2)
+			ASSERT_EQUALS(distances[i], 2.0f * i + 1.0f);
+		// Boxes starting beyond the maximum distance are not entered
+		ASSERT_EQUALS(intersectChildren(node, line, 6.0f, distances), 0x05);
+	}
+
+	TEST(SpatialSplitBVH_MatchesBruteForceWithinBudget)
+	{
+		// Small triangles and every tenth one long, thin and diagonal, with bounds overlapping most of the scene
+		std::vector<Triangle> triangles;
+		for (int i = 0; i < 800; ++i)
+		{
+			const float length = i % 10 == 0 ? 8.0f : 0.3f;
+			const mpn::Point3 start(mpn::frand(-10.0f, 10.0f), mpn::frand(-10.0f, 10.0f), mpn::frand(-10.0f, 10.0f));
+			const mpn::Vector3 direction(mpn::frand(-length, length), mpn::frand(-length, length), mpn::frand(-length, length));
+			const mpn::Vector3 width(mpn::frand(-0.2f, 0.2f), mpn::frand(-0.2f, 0.2f), mpn::frand(-0.2f, 0.2f));
+			triangles.emplace_back(start, start + direction, start + direction + width);
+		}
+		const TriangleMesh mesh(triangles, 4, 0.5f);
+		ASSERT_TRUE(mesh.getTriangles().size() > triangles.size());
+		ASSERT_TRUE(mesh.getTriangles().size() <= triangles.size() * 3 / 2);
+		for (const BVHNode& node : mesh.getBVH().getNodes())
+			if (node.isLeaf())
+				for (std::uint32_t i = node.offset; i < node.offset + node.count; ++i)
+					ASSERT_TRUE(overlaps(mesh.getTriangles()[i], node.bounds));
+
+		for (int i = 0; i < 300; ++i)
+		{
+			const Line line = createRandomLine();
+			ASSERT_EQUALS(mesh.intersect(line), bruteForceIntersect(triangles, line));
+		}
+		ASSERT_THROWS(std::invalid_argument, [&]() { TriangleMesh(triangles, 4, -1.0f); });
+	}
+
+	TEST(Batch_SortCoherentIsPermutation)
+	{
+		std::vector<Line> lines;
+		for (int i = 0; i < 5000; ++i)
+			lines.push_back(createRandomLine());
+
+		std::vector<std::uint32_t> order = sortCoherent(lines);
+		std::sort(order.begin(), order.end());
+
+		for (std::uint32_t i = 0; i < order.size(); ++i)
+			ASSERT_EQUALS(i, order[i]);
+	}
+
+	TEST(Batch_ResultsInInputOrder)
+	{
+		const TriangleMesh mesh(createRandomTriangles(2000));
+		std::vector<Line> lines;
+		for (int i = 0; i < 5000; ++i)
+			lines.push_back(createRandomLine());
+
+		std::vector<float> distances(lines.size());
+		std::vector<std::uint8_t> occluded(lines.size());
+		intersectBatch(mesh, lines, distances, 4);
+		occludesBatch(mesh, lines, FLT_MAX, occluded, 4);
+
+		for (size_t i = 0; i < lines.size(); ++i)
+		{
+			ASSERT_EQUALS(mesh.intersect(lines[i]), distances[i]);
+			ASSERT_EQUALS(mesh.occludes(lines[i], FLT_MAX), occluded[i] != 0);
+		}
+	}
+
+	TEST(InstancedScene_MatchesFlattenedScene)
+	{
+		const TriangleMesh mesh(createRandomTriangles(200));
+
+		std::vector<Instance> instances;
+		std::vector<Triangle> flattened;
+		for (int i = 0; i < 20; ++i)
+		{
+			const mpn::Transform transform(
+				mpn::Vector3(mpn::frand(0.5f, 2.0f), mpn::frand(0.5f, 2.0f), mpn::frand(0.5f, 2.0f)),
+				Line(mpn::Point3(0, 0, 0), mpn::Vector3(mpn::frand(-1.0f, 1.0f), 1.0f, mpn::frand(-1.0f, 1.0f))),
+				mpn::frand(0.0f, 360.0f),
+				mpn::Point3(mpn::frand(-50.0f, 50.0f), mpn::frand(-50.0f, 50.0f), mpn::frand(-50.0f, 50.0f)));
+			instances.push_back({ &mesh, transform });
+			for (const Triangle& triangle : mesh.getTriangles())
+				flattened.emplace_back(
+					transform.transform(triangle.vertices[0]),
+					transform.transform(triangle.vertices[1]),
+					transform.transform(triangle.vertices[2]));
+		}
+		InstancedScene scene(instances);
+
+		for (int i = 0; i < 250; ++i)
+		{
+			const Line line(
+				mpn::Point3(mpn::frand(-60.0f, 60.0f), mpn::frand(-60.0f, 60.0f), mpn::frand(-60.0f, 60.0f)),
+				mpn::Vector3(mpn::frand(-1.0f, 1.0f), mpn::frand(-1.0f, 1.0f), mpn::frand(-1.0f, 1.0f)));
+			const float expected = bruteForceIntersect(flattened, line);
+			const InstanceHit hit = scene.intersect(line);
+			ASSERT_TRUE(abs(expected - hit.distance) <= 1e-3f * std::max(1.0f, abs(expected)));
+			if (hit.distance < 0.0f)
+				ASSERT_FALSE(scene.occludes(line, FLT_MAX));
+			else
+				ASSERT_TRUE(scene.occludes(line, hit.distance * 1.01f));
+		}
+	}
+
+	TEST(MeshFile_MappedMeshMatchesBuiltMesh)
+	{
+		const TriangleMesh mesh(createRandomTriangles(1000));
+		const std::string path = (std::filesystem::temp_directory_path() / "mpn_bvh_test.mesh").string();
+		saveMesh(mesh, path);
+		{
+			const TriangleMesh mapped = loadMesh(path);
+
+			ASSERT_EQUALS(mesh.getBVH().getNodes().size(), mapped.getBVH().getNodes().size());
+			ASSERT_EQUALS(mesh.getTriangles().size(), mapped.getTriangles().size());
+			for (int i = 0; i < 200; ++i)
+			{
+				const Line line = createRandomLine();
+				ASSERT_EQUALS(mesh.intersect(line), mapped.intersect(line));
+			}
+		}
+		std::filesystem::remove(path);
+	}
+
+	TEST(MeshFile_RejectsMalformedFiles)
+	{
+		const TriangleMesh mesh(createRandomTriangles(100));
+		const std::string path = (std::filesystem::temp_directory_path() / "mpn_bvh_malformed.mesh").string();
+		saveMesh(mesh, path);
+		std::vector<char> original(std::filesystem::file_size(path));
+		std::ifstream(path, std::ios::binary).read(original.data(), std::streamsize(original.size()));
+		MeshFileHeader header;
+		std::memcpy(&header, original.data(), sizeof(header));
+
+		const auto loadModified = [&](auto&& modify) {
+			std::vector<char> bytes = original;
+			modify(bytes);
+			std::ofstream(path, std::ios::binary | std::ios::trunc).write(bytes.data(), std::streamsize(bytes.size()));
+			loadMesh(path);
+		};
+		const auto setHeader = [](std::vector<char>& bytes, const MeshFileHeader& modified) {
+			std::memcpy(bytes.data(), &modified, sizeof(modified));
+		};
+		const auto nodeAt = [&](std::vector<char>& bytes, size_t index) {
+			return bytes.data() + header.nodeOffset + index * sizeof(BVHNode);
+		};
+
+		// Written on a machine of the other byte order, and with an unknown byte order marker
+		ASSERT_THROWS(std::runtime_error, [&]() { loadModified([&](std::vector<char>& bytes) {
+			MeshFileHeader modified = header;
+			modified.byteOrder = 0x04030201;
+			setHeader(bytes, modified);
+		}); });
+		ASSERT_THROWS(std::runtime_error, [&]() { loadModified([&](std::vector<char>& bytes) {
+			MeshFileHeader modified = header;
+			modified.byteOrder = 0;
+			setHeader(bytes, modified);
+		}); });
+		// Counts chosen so offset + count * size wraps around to a small value
+		ASSERT_THROWS(std::runtime_error, [&]() { loadModified([&](std::vector<char>& bytes) {
+			MeshFileHeader modified = header;
+			modified.triangleCount = (UINT64_MAX / sizeof(Triangle)) + 1;
+			setHeader(bytes, modified);
+		}); });
+		ASSERT_THROWS(std::runtime_error, [&]() { loadModified([&](std::vector<char>& bytes) {
+			MeshFileHeader modified = header;
+			modified.nodeOffset = UINT64_MAX - (MESH_FILE_ALIGNMENT - 1);
+			setHeader(bytes, modified);
+		}); });
+		// Second child of the root pointing back at the root
+		ASSERT_THROWS(std::runtime_error, [&]() { loadModified([&](std::vector<char>& bytes) {
+			const std::uint32_t offset = 0;
+			std::memcpy(nodeAt(bytes, 0) + offsetof(BVHNode, offset), &offset, sizeof(offset));
+		}); });
+		// Leaf addressing triangles past the end
+		ASSERT_THROWS(std::runtime_error, [&]() { loadModified([&](std::vector<char>& bytes) {
+			size_t leaf = 0;
+			BVHNode node;
+			do
+				std::memcpy(&node, nodeAt(bytes, ++leaf), sizeof(node));
+			while (!node.isLeaf());
+			node.offset = std::uint32_t(header.triangleCount);
+			std::memcpy(nodeAt(bytes, leaf), &node, sizeof(node));
+		}); });
+
+		// Well linked chain deeper than the traversal stacks
+		ASSERT_THROWS(std::runtime_error, [&]() { loadModified([&](std::vector<char>& bytes) {
+			const std::uint32_t levels = BVH::MAX_DEPTH + 1;
+			std::vector<BVHNode> chain(2 * levels + 1);
+			for (std::uint32_t i = 0; i < levels; ++i)
+			{
+				chain[2 * i].offset = 2 * i + 2;
+				chain[2 * i + 1].offset = 0;
+				chain[2 * i + 1].count = 1;
+			}
+			chain.back().count = 1;
+			MeshFileHeader modified = header;
+			modified.nodeCount = chain.size();
+			modified.triangleOffset = header.nodeOffset + (chain.size() * sizeof(BVHNode) + MESH_FILE_ALIGNMENT - 1) / MESH_FILE_ALIGNMENT * MESH_FILE_ALIGNMENT;
+			modified.triangleCount = 1;
+			bytes.assign(modified.triangleOffset + sizeof(Triangle), 0);
+			setHeader(bytes, modified);
+			std::memcpy(nodeAt(bytes, 0), chain.data(), chain.size() * sizeof(BVHNode));
+		}); });
+
+		loadModified([](std::vector<char>&) {});
+		std::filesystem::remove(path);
+	}
+
+	TEST(IndexedMesh_MatchesTriangleMesh)
+	{
+		// Randomly displaced grid, every inner vertex is shared by six triangles
+		const int size = 30;
+		std::vector<mpn::Point3> vertices;
+		for (int y = 0; y <= size; ++y)
+			for (int x = 0; x <= size; ++x)
+				vertices.emplace_back(float(x) - size / 2, float(y) - size / 2, mpn::frand(-12.0f, -8.0f));
+		std::vector<IndexedMesh::Indices> indices;
+		std::vector<Triangle> triangles;
+		for (int y = 0; y < size; ++y)
+			for (int x = 0; x < size; ++x)
+			{
+				const std::uint32_t corner = y * (size + 1) + x;
+				indices.push_back({ corner, corner + 1, corner + size + 1 });
+				indices.push_back({ corner + 1, corner + size + 2, corner + size + 1 });
+			}
+		for (const IndexedMesh::Indices& triple : indices)
+			triangles.emplace_back(vertices[triple[0]], vertices[triple[1]], vertices[triple[2]]);
+
+		const IndexedMesh indexed(vertices, indices);
+		const TriangleMesh mesh(triangles);
+
+		ASSERT_EQUALS(indices.size(), indexed.size());
+		for (int i = 0; i < 500; ++i)
+		{
+			const Line line = createRandomLine();
+			ASSERT_EQUALS(mesh.intersect(line), indexed.intersect(line));
+		}
+	}
+
+	TEST(IndexedMesh_IndexOutOfRange_Exception)
+	{
+		auto createWithInvalidIndex = []()
+		{
+			IndexedMesh mesh({ { 0, 0, 0 }, { 1, 0, 0 }, { 0, 1, 0 } }, { { 0, 1, 3 } });
+		};
+
+		ASSERT_THROWS(std::invalid_argument, createWithInvalidIndex);
+	}
+
+	TEST(QuantizedAABB_ContainsOriginal)
+	{
+		const QuantizationFrame frame(AABB({ -10.0f, -10.0f, -10.0f }, { 10.0f, 10.0f, 10.0f }));
+		for (int i = 0; i < 1000; ++i)
+		{
+			const mpn::Point3 corner(mpn::frand(-10.0f, 9.0f), mpn::frand(-10.0f, 9.0f), mpn::frand(-10.0f, 9.0f));
+			const AABB box(corner, corner + mpn::Vector3(mpn::frand(0.0f, 1.0f), mpn::frand(0.0f, 1.0f), mpn::frand(0.0f, 1.0f)));
+
+			ASSERT_TRUE(QuantizedAABB::encode(box, frame).decode(frame).contains(box));
+		}
+	}
+
+	TEST(QuantizedMesh_MatchesIndexedMeshWithinQuantizationError)
+	{
+		const int size = 20;
+		std::vector<mpn::Point3> vertices;
+		for (int y = 0; y <= size; ++y)
+			for (int x = 0; x <= size; ++x)
+				vertices.emplace_back(float(x) - size / 2, float(y) - size / 2, mpn::frand(-12.0f, -8.0f));
+		std::vector<IndexedMesh::Indices> indices;
+		for (int y = 0; y < size; ++y)
+			for (int x = 0; x < size; ++x)
+			{
+				const std::uint32_t corner = y * (size + 1) + x;
+				indices.push_back({ corner, corner + 1, corner + size + 1 });
+				indices.push_back({ corner + 1, corner + size + 2, corner + size + 1 });
+			}
+		const IndexedMesh mesh(vertices, indices);
+		const QuantizedMesh quantized(mesh);
+
+		for (int i = 0; i < 500; ++i)
+		{
+			const Line line(mpn::Point3(mpn::frand(-9.0f, 9.0f), mpn::frand(-9.0f, 9.0f), 0.0f), mpn::Vector3(0.0f, 0.0f, -1.0f));
+			const float expected = mesh.intersect(line);
+			const float distance = quantized.intersect(line);
+
+			ASSERT_TRUE(distance >= 0.0f);
+			// Vertices move by up to half a 20 / 65535 step sideways, on slopes of up to 4
+			ASSERT_TRUE(abs(expected - distance) < 3e-3f);
+		}
+	}
+
+	TEST(Frustum_CullVisitsEveryPrimitiveNotOutside)
+	{
+		const TriangleMesh mesh(createRandomTriangles(500));
+		const mpn::Matrix4 viewProjection(
+			0.2f, 0.0f, 0.0f, 0.0f,
+			0.0f, 0.2f, 0.0f, 0.0f,
+			0.0f, 0.0f, 0.2f, 0.0f,
+			-0.3f, 0.4f, 0.0f, 1.0f);
+		const Frustum frustum(viewProjection);
+
+		std::vector<int> visited(mesh.getTriangles().size(), 0);
+		frustum.cull(mesh.getBVH(), [&](std::uint32_t first, std::uint32_t count, bool fullyInside)
+		{
+			for (std::uint32_t i = first; i < first + count; ++i)
+			{
+				++visited[i];
+				if (fullyInside)
+					ASSERT_TRUE(frustum.classify(createAABB(mesh.getTriangles()[i])) == Containment::Inside);
+			}
+		});
+		for (size_t i = 0; i < visited.size(); ++i)
+		{
+			ASSERT_TRUE(visited[i] <= 1);
+			if (frustum.classify(createAABB(mesh.getTriangles()[i])) != Containment::Outside)
+				ASSERT_EQUALS(visited[i], 1);
+		}
+	}
+}
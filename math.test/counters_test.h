@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+
+#include "../nuketest/nuketest/use_nuketest.h"
+
+#include "../math/counters.h"
+#include "../math/dynamictree.h"
+#include "../math/mesh.h"
+
+TEST_MODULE(CountersTest)
+{
+	using namespace geom;
+
+	TEST(Counters_CountQueriesWhenEnabled)
+	{
+		// Counts in the Counters configuration, which defines MPN_COUNTERS, and stays zero in the others.
+		// A single leaf: every query tests the root box and the triangle once
+		const TriangleMesh mesh({ Triangle(mpn::Point3(-1.0f, -1.0f, 0.0f), mpn::Point3(1.0f, -1.0f, 0.0f), mpn::Point3(0.0f, 1.0f, 0.0f)) });
+		const Line line(mpn::Point3(0.0f, 0.0f, -5.0f), mpn::Vector3(0.0f, 0.0f, 1.0f));
+		const std::uint64_t queries = 50;
+		mpn::resetCounters();
+		for (std::uint64_t i = 0; i < queries; ++i)
+			mesh.intersect(line);
+		const mpn::CounterSnapshot snapshot = mpn::snapshotCounters();
+
+		const std::uint64_t expected = mpn::COUNTERS_ENABLED ? queries : 0;
+		ASSERT_EQUALS(snapshot[mpn::Counter::AABBTests], expected);
+		ASSERT_EQUALS(snapshot[mpn::Counter::AABBHits], expected);
+		ASSERT_EQUALS(snapshot[mpn::Counter::TriangleTests], expected);
+		ASSERT_EQUALS(snapshot[mpn::Counter::TriangleHits], expected);
+		ASSERT_EQUALS(snapshot[mpn::Counter::RandomDraws], 0u);
+		ASSERT_EQUALS(snapshot.traversalDepths[0], expected);
+	}
+
+	TEST(Counters_RecordDynamicTreeQueryDepth)
+	{
+		// Two proxies under the root, a box overlapping only the first reaches depth 1 once
+		DynamicTree tree(0.0f);
+		tree.insert(AABB(mpn::Point3(0.0f, 0.0f, 0.0f), mpn::Point3(1.0f, 1.0f, 1.0f)), 0);
+		tree.insert(AABB(mpn::Point3(5.0f, 0.0f, 0.0f), mpn::Point3(6.0f, 1.0f, 1.0f)), 1);
+		mpn::resetCounters();
+		int found = 0;
+		tree.query(AABB(mpn::Point3(0.5f, 0.5f, 0.5f), mpn::Point3(0.6f, 0.6f, 0.6f)), [&](std::uint32_t) { ++found; return true; });
+		const mpn::CounterSnapshot snapshot = mpn::snapshotCounters();
+
+		ASSERT_EQUALS(found, 1);
+		ASSERT_EQUALS(snapshot.traversalDepths[0], 0u);
+		ASSERT_EQUALS(snapshot.traversalDepths[1], mpn::COUNTERS_ENABLED ? 1u : 0u);
+	}
+}
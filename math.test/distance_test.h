@@ -0,0 +1,40 @@
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "../nuketest/nuketest/use_nuketest.h"
+
+#include "../math/distance.h"
+#include "../math/mesh.h"
+#include "../math/random.h"
+
+#include "test_geometry.h"
+
+TEST_MODULE(DistanceTest)
+{
+	using namespace geom;
+	using namespace geomTest;
+
+	TEST(MeshDistance_MatchesBruteForce)
+	{
+		const TriangleMesh mesh(createRandomTriangles(1003));
+		const MeshDistance query(mesh);
+		ASSERT_EQUALS(MeshDistance(TriangleMesh()).distance(mpn::Point3(0.0f, 0.0f, 0.0f)), INVALID_DISTANCE);
+
+		for (int i = 0; i < 200; ++i)
+		{
+			const mpn::Point3 point(mpn::frand(-15.0f, 15.0f), mpn::frand(-15.0f, 15.0f), mpn::frand(-15.0f, 15.0f));
+			float expected = FLT_MAX;
+			for (const Triangle& triangle : mesh.getTriangles())
+				expected = std::min(expected, triangle.distance(point));
+
+			const SurfacePoint closest = query.closestPoint(point);
+			ASSERT_TRUE(std::abs(closest.distance - expected) < 1e-3f);
+			ASSERT_TRUE(std::abs(mesh.getTriangles()[closest.triangle].distance(point) - expected) < 1e-3f);
+			ASSERT_TRUE(std::abs((closest.point - point).length() - expected) < 1e-3f);
+			ASSERT_EQUALS(query.closestPoint(point, expected * 0.5f).distance, INVALID_DISTANCE);
+		}
+	}
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "../nuketest/nuketest/use_nuketest.h"
+
+#include "../math/dynamictree.h"
+#include "../math/random.h"
+
+TEST_MODULE(DynamicTreeTest)
+{
+	using namespace geom;
+
+	TEST(DynamicTree_QueriesMatchBruteForceWhileMoving)
+	{
+		auto randomBox = [](const mpn::Point3& center)
+		{
+			const mpn::Vector3 half(mpn::frand(0.1f, 1.0f), mpn::frand(0.1f, 1.0f), mpn::frand(0.1f, 1.0f));
+			return AABB(center - half, center + half);
+		};
+		auto randomPoint = []() { return mpn::Point3(mpn::frand(-20.0f, 20.0f), mpn::frand(-20.0f, 20.0f), mpn::frand(-20.0f, 20.0f)); };
+
+		DynamicTree tree(0.2f);
+		std::vector<AABB> bounds;
+		std::vector<std::uint32_t> proxies;
+		for (std::uint32_t i = 0; i < 300; ++i)
+		{
+			bounds.push_back(randomBox(randomPoint()));
+			proxies.push_back(tree.insert(bounds.back(), i));
+		}
+		for (int step = 0; step < 5; ++step)
+			for (size_t i = 0; i < bounds.size(); ++i)
+			{
+				const mpn::Vector3 displacement(mpn::frand(-0.5f, 0.5f), mpn::frand(-0.5f, 0.5f), mpn::frand(-0.5f, 0.5f));
+				bounds[i] = AABB(bounds[i].minCoords + displacement, bounds[i].maxCoords + displacement);
+				tree.move(proxies[i], bounds[i], displacement);
+				ASSERT_TRUE(tree.getFatBounds(proxies[i]).contains(bounds[i]));
+			}
+		for (size_t i = 0; i < 100; ++i)
+			tree.remove(proxies[i]);
+		bounds.erase(bounds.begin(), bounds.begin() + 100);
+		proxies.erase(proxies.begin(), proxies.begin() + 100);
+		ASSERT_EQUALS(tree.size(), size_t(200));
+		ASSERT_TRUE(tree.getHeight() <= 16);
+
+		// Box query against the fat bounds
+		const AABB box = randomBox(mpn::Point3(0.0f, 0.0f, 0.0f));
+		size_t found = 0;
+		tree.query(box, [&](std::uint32_t proxy) { ASSERT_TRUE(overlaps(tree.getFatBounds(proxy), box)); ++found; return true; });
+		size_t expected = 0;
+		for (std::uint32_t proxy : proxies)
+			expected += overlaps(tree.getFatBounds(proxy), box) ? 1 : 0;
+		ASSERT_EQUALS(found, expected);
+
+		// Every overlapping pair exactly once
+		size_t pairs = 0;
+		tree.queryPairs([&](std::uint32_t a, std::uint32_t b) { ASSERT_TRUE(a < b && overlaps(tree.getFatBounds(a), tree.getFatBounds(b))); ++pairs; });
+		size_t expectedPairs = 0;
+		for (size_t a = 0; a < proxies.size(); ++a)
+			for (size_t b = a + 1; b < proxies.size(); ++b)
+				expectedPairs += overlaps(tree.getFatBounds(proxies[a]), tree.getFatBounds(proxies[b])) ? 1 : 0;
+		ASSERT_EQUALS(pairs, expectedPairs);
+
+		// Closest hit against the tight bounds of the objects
+		auto intersectProxy = [&](std::uint32_t proxy, const Line& line) { return bounds[tree.getUserData(proxy) - 100].entryDistance(line); };
+		for (int i = 0; i < 100; ++i)
+		{
+			const Line line(randomPoint(), mpn::Vector3(mpn::frand(-1.0f, 1.0f), mpn::frand(-1.0f, 1.0f), mpn::frand(-1.0f, 1.0f)));
+			float closest = INVALID_DISTANCE;
+			for (const AABB& object : bounds)
+			{
+				const float distance = object.entryDistance(line);
+				if (distance >= 0.0f && (closest < 0.0f || distance < closest))
+					closest = distance;
+			}
+			ASSERT_EQUALS(closest, tree.intersect(line, intersectProxy));
+		}
+	}
+}
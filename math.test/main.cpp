@@ -3,9 +3,18 @@
 
 #include "../nuketest/nuketest/use_nuketest.h"
 
+#include "broadphase_test.h"
+#include "bvh_test.h"
+#include "counters_test.h"
+#include "distance_test.h"
+#include "dynamictree_test.h"
 #include "matrix_test.h"
+#include "pointgrid_test.h"
+#include "pointindex_test.h"
 #include "primitives_test.h"
+#include "sdf_test.h"
 #include "transform_test.h"
+#include "voxel_test.h"
 
 int main(int, char* [])
 {
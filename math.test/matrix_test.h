@@ -1,8 +1,14 @@
 #pragma once
 
+#include <cstring>
+
 #include "../nuketest/nuketest/use_nuketest.h"
 #include "../math/vector.h"
+#include "../math/half.h"
+#include "../math/lanes.h"
 #include "../math/matrix.h"
+#include "../math/matrixx.h"
+#include "../math/views.h"
 
 #pragma warning(disable: 26496) //just pollutes these short functions
 
@@ -72,4 +78,322 @@ TEST_MODULE(Matrix)
 			179, 231, 147, 166
 		));
 	}	
+	TEST(Determinant)
+	{
+		mpn::Matrix4 m1(
+			1, 2, 3, 4,
+			5, 6, 7, 8,
+			9, 10, 11, 12,
+			13, 14, 15, 16);
+		ASSERT_EQUALS(mpn::determinant(m1), 0.0f);
+		mpn::Matrix4 m2(
+			0, 2, 0, 3,
+			2, 6, 4, 8,
+			9, 7, 5, 1,
+			1, 1, 1, 0);
+		ASSERT_EQUALS(mpn::determinant(m2), -32.0f);
+		mpn::Matrix3 m3(
+			2, 0, 1,
+			1, 3, 0,
+			0, 1, 4);
+		ASSERT_EQUALS(mpn::determinant(m3), 25.0f);
+	}
+	TEST(Determinant_OfInverseIsReciprocal)
+	{
+		mpn::Matrix4 matrix(
+			0, 2, 0, 3,
+			2, 6, 4, 8,
+			9, 7, 5, 1,
+			1, 1, 1, 0), inverted;
+		ASSERT_TRUE(mpn::inverse(matrix, inverted));
+		ASSERT_TRUE(std::abs(mpn::determinant(inverted) * mpn::determinant(matrix) - 1.0f) < 1e-5f);
+		ASSERT_EQUALS(mpn::determinant(matrix.asTransposed()), -32.0f);
+	}
+	TEST(Inverse)
+	{
+		mpn::Matrix4 matrix(
+			0, 2, 0, 3,
+			2, 6, 4, 8,
+			9, 7, 5, 1,
+			1, 1, 1, 0);
+		mpn::Matrix4 inverted, identity;
+		mpn::loadIdentity(identity);
+		ASSERT_TRUE(mpn::inverse(matrix, inverted));
+		ASSERT_EQUALS(matrix * inverted, identity);
+		ASSERT_EQUALS(inverted * matrix, identity);
+
+		mpn::Matrix3 m3(
+			2, 0, 1,
+			1, 3, 0,
+			0, 1, 4), inverted3, identity3;
+		mpn::loadIdentity(identity3);
+		ASSERT_TRUE(mpn::inverse(m3, inverted3));
+		ASSERT_EQUALS(m3 * inverted3, identity3);
+	}
+	TEST(Inverse_Singular)
+	{
+		mpn::Matrix4 matrix(
+			1, 2, 3, 4,
+			5, 6, 7, 8,
+			9, 10, 11, 12,
+			13, 14, 15, 16);
+		mpn::Matrix4 inverted;
+		ASSERT_TRUE(!mpn::inverse(matrix, inverted));
+		ASSERT_TRUE(!mpn::affineInverse(mpn::Matrix4(), inverted));
+		mpn::Matrix3 m3(
+			1, 2, 3,
+			2, 4, 6,
+			0, 1, 4), inverted3;
+		ASSERT_TRUE(!mpn::inverse(m3, inverted3));
+	}
+	TEST(AffineInverse_MatchesInverse)
+	{
+		mpn::Matrix4 matrix(
+			0, 2, 0, 0,
+			-3, 0, 0, 0,
+			0, 0, 0.5f, 0,
+			8, -4, 2, 1);
+		mpn::Matrix4 general, affine;
+		ASSERT_TRUE(mpn::inverse(matrix, general));
+		ASSERT_TRUE(mpn::affineInverse(matrix, affine));
+		ASSERT_EQUALS(affine, general);
+		ASSERT_EQUALS(mpn::Point3(1, 2, 3) * matrix * affine, mpn::Point3(1, 2, 3));
+	}
+	TEST(NormalMatrix_NonUniformScale)
+	{
+		// The normal of the plane x + y = 1 stays perpendicular to it after stretching x
+		mpn::Matrix4 matrix(
+			4, 0, 0, 0,
+			0, 1, 0, 0,
+			0, 0, 1, 0,
+			5, 6, 7, 1);
+		mpn::Matrix3 normals;
+		ASSERT_TRUE(mpn::normalMatrix(matrix, normals));
+		const mpn::Vector3 normal = mpn::Vector3(1, 1, 0) * normals;
+		const mpn::Vector3 tangent = mpn::Vector3(1, -1, 0) * matrix;
+		ASSERT_EQUALS(normal, mpn::Vector3(0.25f, 1, 0));
+		ASSERT_EQUALS(normal * tangent, 0.0f);
+	}
+	TEST(MatrixX_MatchesMatrix)
+	{
+		mpn::Matrix4 m1(
+			1, 2, 3, 4,
+			5, 6, 7, 8,
+			9, 10, 11, 12,
+			13, 14, 15, 16);
+		mpn::Matrix4 m2(
+			0, 2, 0, 3,
+			2, 6, 4, 8,
+			9, 7, 5, 1,
+			1, 1, 1, 0);
+		const mpn::MatrixX product = mpn::MatrixX(m1) * mpn::MatrixX(m2);
+		const mpn::Matrix4 fixed = product.asMatrix<4, 4>();
+		ASSERT_EQUALS(fixed, m1 * m2);
+		ASSERT_EQUALS(product.asTransposed(), mpn::MatrixX(m2.asTransposed()) * mpn::MatrixX(m1.asTransposed()));
+
+		const mpn::Vector<4, float> vector(mpn::MatrixX(m1).row<4>(1));
+		ASSERT_EQUALS((vector * mpn::MatrixX(m2)).row<4>(0), product.row<4>(1));
+		ASSERT_THROWS(std::invalid_argument, [&]() { (product.asMatrix<3, 4>()); });
+	}
+	TEST(MatrixX_BlockedMultiplication)
+	{
+		// Sizes off the block boundaries, small integers keep every sum exact
+		const int rows = 131, depth = 300, columns = 203;
+		mpn::MatrixX lhs(rows, depth), rhs(depth, columns), expected(rows, columns);
+		for (int row = 0; row < rows; ++row)
+			for (int k = 0; k < depth; ++k)
+				lhs(row, k) = float((row * 7 + k * 3) % 11 - 5);
+		for (int k = 0; k < depth; ++k)
+			for (int column = 0; column < columns; ++column)
+				rhs(k, column) = float((k * 5 + column * 2) % 7 - 3);
+		for (int row = 0; row < rows; ++row)
+			for (int column = 0; column < columns; ++column)
+				for (int k = 0; k < depth; ++k)
+					expected(row, column) += lhs(row, k) * rhs(k, column);
+
+		mpn::MatrixX product;
+		mpn::multiply(lhs, rhs, product, 1);
+		ASSERT_EQUALS(product, expected);
+		mpn::multiply(lhs, rhs, product, 4);
+		ASSERT_EQUALS(product, expected);
+		mpn::multiply(lhs, mpn::MatrixX::identity(depth), lhs);
+		ASSERT_EQUALS(lhs.getColumns(), depth);
+		ASSERT_EQUALS(lhs * rhs, expected);
+		ASSERT_THROWS(std::invalid_argument, [&]() { rhs * rhs; });
+	}
+	TEST(Lanes_VectorMathMatchesScalar)
+	{
+		mpn::Vector3 vectors[8], others[8];
+		for (int i = 0; i < 8; ++i)
+		{
+			vectors[i] = mpn::Vector3(float(i) - 3.5f, 1.0f + 0.25f * i, 2.0f - float(i % 3));
+			others[i] = mpn::Vector3(0.5f * i, -1.0f, float(i * i) * 0.1f);
+		}
+		const mpn::Vector<3, mpn::floatx8> wide = mpn::packLanes<8, 3>(vectors);
+		const mpn::Vector<3, mpn::floatx8> otherWide = mpn::packLanes<8, 3>(others);
+
+		const mpn::floatx8 dot = wide * otherWide;
+		const mpn::floatx8 length = wide.length();
+		const mpn::Vector<3, mpn::floatx8> cross = wide % otherWide;
+		const mpn::Vector<3, mpn::floatx8> combined = (wide + otherWide * 2.0f).asUnitVector() * length;
+		for (int i = 0; i < 8; ++i)
+		{
+			ASSERT_EQUALS(dot[i], vectors[i] * others[i]);
+			ASSERT_EQUALS(length[i], vectors[i].length());
+			ASSERT_EQUALS(mpn::extractLane(cross, i), vectors[i] % others[i]);
+			ASSERT_EQUALS(mpn::extractLane(combined, i), (vectors[i] + others[i] * 2.0f).asUnitVector() * vectors[i].length());
+		}
+		// Lanes past the packed vectors are zero
+		const mpn::floatx8 partial = mpn::packLanes<8, 3>(std::span<const mpn::Vector3>(vectors, 3)) * otherWide;
+		for (int i = 0; i < 8; ++i)
+			ASSERT_EQUALS(partial[i], i < 3 ? dot[i] : 0.0f);
+	}
+	TEST(Lanes_MaskedSelect)
+	{
+		const float values[16] = { -3, 2, 0, 5, -1, 7, -8, 1, 4, -4, 6, -6, 0.5f, -0.5f, 9, -9 };
+		const mpn::floatx16 x = mpn::floatx16::load(values);
+		const mpn::maskx16 positive = x > 0.0f;
+		const mpn::floatx16 clamped = select(positive, x, mpn::floatx16(0.0f));
+		for (int i = 0; i < 16; ++i)
+		{
+			ASSERT_EQUALS(positive[i], values[i] > 0.0f);
+			ASSERT_EQUALS(clamped[i], std::max(values[i], 0.0f));
+			ASSERT_EQUALS(abs(x)[i], std::abs(values[i]));
+		}
+		ASSERT_EQUALS(positive.bits(), 0x55AAu);
+		ASSERT_TRUE(any(positive) && !all(positive) && none(positive & !positive));
+		ASSERT_TRUE(all(positive | !positive));
+
+		const mpn::floatx4 y(2.0f);
+		ASSERT_TRUE(all(sqrt(y * y) == y) && all(min(y, 1.0f) < max(y, 3.0f)));
+	}
+	TEST(Lanes_MatrixTransform)
+	{
+		const mpn::Matrix4 matrix(
+			0, 2, 0, 0.25f,
+			-3, 0, 0, 0,
+			0, 0, 0.5f, 0,
+			8, -4, 2, 1);
+		mpn::Point3 points[4] = { { 1, 2, 3 }, { -1, 0, 4 }, { 0.5f, -2, 1 }, { 3, 3, -3 } };
+		const mpn::Point<3, mpn::floatx4> wide = mpn::packLanes<4, 3>(points);
+		const mpn::Point<3, mpn::floatx4> transformed = wide * matrix;
+		const mpn::Vector<3, mpn::floatx4> direction = (wide - mpn::Point<3, mpn::floatx4>()) * matrix;
+		for (int i = 0; i < 4; ++i)
+		{
+			ASSERT_EQUALS(mpn::extractLane(transformed, i), points[i] * matrix);
+			ASSERT_EQUALS(mpn::extractLane(direction, i), points[i].asVector() * matrix);
+		}
+
+		mpn::Matrix<3, 3, mpn::floatx4> identity, scaled;
+		mpn::loadIdentity(identity);
+		for (int i = 0; i < 3; ++i)
+			scaled(i, i) = mpn::floatx4(2.0f);
+		ASSERT_TRUE(scaled * identity == scaled);
+		ASSERT_TRUE(!(scaled * scaled == scaled));
+	}
+	TEST(Half_Conversions)
+	{
+		ASSERT_EQUALS(mpn::half(1.0f).bits, std::uint16_t(0x3C00));
+		ASSERT_EQUALS(mpn::half(-2.0f).bits, std::uint16_t(0xC000));
+		ASSERT_EQUALS(mpn::half(0.1f).bits, std::uint16_t(0x2E66));
+		ASSERT_EQUALS(mpn::half(65504.0f).bits, std::uint16_t(0x7BFF));
+		ASSERT_EQUALS(mpn::half(65520.0f).bits, std::uint16_t(0x7C00));
+		ASSERT_EQUALS(mpn::half(std::ldexp(1.0f, -24)).bits, std::uint16_t(0x0001));
+		ASSERT_EQUALS(mpn::half(std::ldexp(1.0f, -25)).bits, std::uint16_t(0x0000));
+		ASSERT_EQUALS(mpn::half(1.0f + std::ldexp(1.0f, -11)).bits, std::uint16_t(0x3C00));	// tie to even
+		ASSERT_EQUALS(mpn::half(1.0f + 3.0f * std::ldexp(1.0f, -11)).bits, std::uint16_t(0x3C02));
+		ASSERT_TRUE(std::isnan(float(mpn::half(std::nanf("")))));
+		ASSERT_EQUALS(float(mpn::half(std::ldexp(1.0f, -24))), std::ldexp(1.0f, -24));
+
+		ASSERT_EQUALS(mpn::bfloat16(1.0f).bits, std::uint16_t(0x3F80));
+		ASSERT_EQUALS(mpn::bfloat16(1.0f + std::ldexp(1.0f, -8)).bits, std::uint16_t(0x3F80));
+		ASSERT_EQUALS(mpn::bfloat16(1.0f + 3.0f * std::ldexp(1.0f, -8)).bits, std::uint16_t(0x3F82));
+		ASSERT_EQUALS(mpn::bfloat16(-3.0e38f).bits, std::uint16_t(0xFF62));
+		ASSERT_TRUE(std::isnan(float(mpn::bfloat16(std::nanf("")))));
+
+		// The batch conversions match the scalar ones, including the tails
+		std::vector<float> values;
+		for (int i = 0; i < 1003; ++i)
+			values.push_back(std::ldexp(float(i % 37) - 18.5f, i % 41 - 26) * (i % 5 == 0 ? -1.0f : 1.0f));
+		values.push_back(1e9f);
+		values.push_back(std::nanf(""));
+		std::vector<mpn::half> halves(values.size());
+		std::vector<mpn::bfloat16> bfloats(values.size());
+		std::vector<float> fromHalves(values.size()), fromBFloats(values.size());
+		mpn::convert(values, halves);
+		mpn::convert(values, bfloats);
+		mpn::convert(halves, fromHalves);
+		mpn::convert(bfloats, fromBFloats);
+		for (size_t i = 0; i < values.size(); ++i)
+		{
+			ASSERT_EQUALS(halves[i].bits, mpn::half(values[i]).bits);
+			ASSERT_EQUALS(bfloats[i].bits, mpn::bfloat16(values[i]).bits);
+			ASSERT_EQUALS(std::bit_cast<std::uint32_t>(fromHalves[i]), std::bit_cast<std::uint32_t>(float(halves[i])));
+			ASSERT_EQUALS(std::bit_cast<std::uint32_t>(fromBFloats[i]), std::bit_cast<std::uint32_t>(float(bfloats[i])));
+		}
+		ASSERT_THROWS(std::invalid_argument, [&]() { mpn::convert(values, std::span<mpn::half>(halves.data(), 3)); });
+	}
+	TEST(Half_PackedVectors)
+	{
+		std::vector<mpn::Vector3> normals;
+		for (int i = 0; i < 150; ++i)
+			normals.push_back(mpn::Vector3(std::cos(0.1f * i), std::sin(0.1f * i), 0.3f * std::sin(0.37f * i)).asUnitVector());
+		std::vector<mpn::HalfVector3> packed(normals.size());
+		std::vector<mpn::Vector3> unpacked(normals.size());
+		mpn::pack<mpn::half>(normals, packed);
+		mpn::unpack<mpn::half>(packed, unpacked);
+		for (size_t i = 0; i < normals.size(); ++i)
+		{
+			ASSERT_TRUE((unpacked[i] - normals[i]).length() < 1e-3f);
+			ASSERT_EQUALS(unpacked[i], packed[i].unpack());
+			ASSERT_EQUALS(mpn::HalfVector3(normals[i]).unpack(), unpacked[i]);
+		}
+
+		const mpn::BFloat16Point3 point(mpn::Point3(1000.0f, -0.5f, 3.0f));
+		ASSERT_EQUALS(point.unpack(), mpn::Point3(1000.0f, -0.5f, 3.0f));
+		static_assert(sizeof(mpn::HalfVector3) == 6 && sizeof(mpn::BFloat16Point3) == 6);
+	}
+	TEST(Half_DoubleAccumulation)
+	{
+		// Float accumulation stalls long before a million small steps, double does not
+		const std::vector<mpn::HalfVector3> steps(1000000, mpn::HalfVector3(mpn::Vector3(0.1f, 1.0f, -0.001f)));
+		const mpn::Vector3 step = steps[0].unpack();
+		const mpn::Vector<3, double> total = mpn::sum<mpn::half>(steps);
+		for (int axis = 0; axis < 3; ++axis)
+			ASSERT_TRUE(std::abs(total[axis] - 1e6 * step[axis]) < 1e-6 * std::abs(1e6 * step[axis]));
+
+		const std::vector<mpn::HalfPoint3> points = { mpn::HalfPoint3(mpn::Point3(1, 2, 3)), mpn::HalfPoint3(mpn::Point3(3, 2, 1)) };
+		ASSERT_EQUALS(mpn::centroid<mpn::half>(points), mpn::Point3(2, 2, 2));
+		ASSERT_EQUALS(mpn::centroid<mpn::half>({}), mpn::Point3());
+	}
+	TEST(Views_RawFloatBuffers)
+	{
+		static_assert(std::is_trivially_copyable_v<mpn::Vector3> && std::is_trivially_copyable_v<mpn::Point3> && std::is_trivially_copyable_v<mpn::Matrix4>);
+		static_assert(std::is_trivially_copyable_v<mpn::PolarVector<float>> && std::is_trivially_copyable_v<mpn::SphericalVector3>);
+
+		// A buffer as it would come from a file or the network
+		std::vector<float> buffer = { 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+		const std::span<mpn::Point3> points = mpn::viewAs<mpn::Point3>(buffer);
+		ASSERT_EQUALS(points.size(), size_t(3));
+		ASSERT_EQUALS(points[1], mpn::Point3(4, 5, 6));
+		points[2] += mpn::Vector3(1, 1, 1);
+		ASSERT_EQUALS(buffer[8], 10.0f);
+
+		const std::vector<float>& constant = buffer;
+		const std::span<const mpn::Vector3> vectors = mpn::viewAs<mpn::Vector3>(constant);
+		ASSERT_EQUALS(vectors[0], mpn::Vector3(1, 2, 3));
+		ASSERT_THROWS(std::invalid_argument, [&]() { mpn::viewAs<mpn::Matrix4>(buffer); });
+
+		// And back, with the matrices seen column by column
+		const std::vector<mpn::Matrix3> matrices = { mpn::Matrix3(1, 2, 3, 4, 5, 6, 7, 8, 9) };
+		const std::span<const float> floats = mpn::asFloats(matrices);
+		ASSERT_EQUALS(floats.size(), size_t(9));
+		ASSERT_EQUALS(floats[1], 4.0f);
+		ASSERT_EQUALS(mpn::asFloats(points).data(), buffer.data());
+
+		// Trivially copyable values relocate as raw bytes
+		mpn::Point3 copied[3];
+		std::memcpy(copied, points.data(), sizeof(copied));
+		ASSERT_EQUALS(copied[2], mpn::Point3(8, 9, 10));
+	}
 }
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "../nuketest/nuketest/use_nuketest.h"
+
+#include "../math/pointindex.h"
+
+#include "test_geometry.h"
+
+TEST_MODULE(PointGridTest)
+{
+	using namespace geom;
+	using namespace geomTest;
+
+	TEST(PointGrid_RadiusQueriesMatchKdTreeAndBruteForce)
+	{
+		const std::vector<mpn::Point3> points = createRandomPoints(20000);
+		const PointKdTree tree(points, 2);
+		const PointGrid grid(points, 1.5f, 2);
+		ASSERT_THROWS(std::invalid_argument, [&]() { grid.withinRadius(mpn::Point3(0.0f, 0.0f, 0.0f), 2.0f, [](std::uint32_t, float) {}); });
+
+		for (const mpn::Point3& query : createRandomPoints(100))
+		{
+			const float radius = 1.2f;
+			std::vector<std::uint32_t> expected;
+			for (std::uint32_t i = 0; i < points.size(); ++i)
+				if (squaredDistance(query, points[i]) <= radius * radius)
+					expected.push_back(i);
+
+			std::vector<std::uint32_t> fromTree, fromGrid;
+			tree.withinRadius(query, radius, [&](std::uint32_t index, float) { fromTree.push_back(index); });
+			grid.withinRadius(query, radius, [&](std::uint32_t index, float) { fromGrid.push_back(index); });
+			std::sort(fromTree.begin(), fromTree.end());
+			std::sort(fromGrid.begin(), fromGrid.end());
+			ASSERT_TRUE(fromTree == expected);
+			ASSERT_TRUE(fromGrid == expected);
+		}
+	}
+}
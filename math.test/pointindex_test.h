@@ -0,0 +1,56 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "../nuketest/nuketest/use_nuketest.h"
+
+#include "../math/pointindex.h"
+
+#include "test_geometry.h"
+
+TEST_MODULE(PointIndexTest)
+{
+	using namespace geom;
+	using namespace geomTest;
+
+	TEST(PointKdTree_NearestMatchesBruteForce)
+	{
+		const std::vector<mpn::Point3> points = createRandomPoints(4000);
+		const PointKdTree tree(points, 4);
+		const std::vector<mpn::Point3> queries = createRandomPoints(50);
+		const size_t k = 8;
+
+		std::vector<PointNeighbor> batch(queries.size() * k);
+		tree.nearestBatch(queries, k, batch, 3);
+		for (size_t q = 0; q < queries.size(); ++q)
+		{
+			std::vector<float> expected;
+			for (const mpn::Point3& point : points)
+				expected.push_back(squaredDistance(queries[q], point));
+			std::sort(expected.begin(), expected.end());
+
+			PointNeighbor neighbors[k];
+			ASSERT_EQUALS(tree.nearest(queries[q], k, neighbors), k);
+			for (size_t i = 0; i < k; ++i)
+			{
+				ASSERT_EQUALS(neighbors[i].squaredDistance, expected[i]);
+				ASSERT_EQUALS(squaredDistance(queries[q], points[neighbors[i].index]), expected[i]);
+				ASSERT_EQUALS(batch[q * k + i].squaredDistance, expected[i]);
+			}
+		}
+	}
+
+	TEST(PointKdTree_MoreNeighborsThanPoints)
+	{
+		const std::vector<mpn::Point3> points = createRandomPoints(3);
+		const PointKdTree tree(points);
+		std::vector<PointNeighbor> neighbors(5);
+		ASSERT_EQUALS(tree.nearest(mpn::Point3(0.0f, 0.0f, 0.0f), 5, neighbors), size_t(3));
+		const std::vector<mpn::Point3> queries(2, mpn::Point3(0.0f, 0.0f, 0.0f));
+		std::vector<PointNeighbor> batch(10);
+		tree.nearestBatch(queries, 5, batch);
+		ASSERT_EQUALS(batch[3].index, INVALID_POINT);
+		ASSERT_EQUALS(batch[9].index, INVALID_POINT);
+	}
+}
@@ -2,8 +2,11 @@
 
 #include "../nuketest/nuketest/use_nuketest.h"
 
+#include "../math/frustum.h"
 #include "../math/math.h"
+#include "../math/obb.h"
 #include "../math/primitives.h"
+#include "../math/random.h"
 
 TEST_MODULE(PrimitivesTest)
 {
@@ -110,6 +113,142 @@ TEST_MODULE(PrimitivesTest)
 		ASSERT_EQUALS(INVALID_DISTANCE, dist);
 	}
 
+	TEST(TriangleOcclusion_WithinAndBeyondRange)
+	{
+		geom::Triangle triangle
+		{
+			{ 0.0f,  -1.0f, -2.0f },
+			{ -1.0f, +1.0f, -2.0f },
+			{ +1.0f, +1.0f, -2.0f }
+		};
+
+		ASSERT_TRUE(triangle.occludes(ray, 3.0f));
+		ASSERT_FALSE(triangle.occludes(ray, 1.0f));
+	}
+
+	TEST(TriangleOcclusion_Behind)
+	{
+		geom::Triangle triangle
+		{
+			{ 0.0f,  -1.0f, +1.0f },
+			{ -1.0f, +1.0f, +1.0f },
+			{ +1.0f, +1.0f, +1.0f }
+		};
+
+		ASSERT_FALSE(triangle.occludes(ray, 10.0f));
+	}
+
+	TEST(PrecomputedTriangle_MatchesTriangleIntersection)
+	{
+		for (int i = 0; i < 1000; ++i)
+		{
+			const geom::Triangle triangle
+			{
+				{ mpn::frand(-1.0f, 1.0f), mpn::frand(-1.0f, 1.0f), mpn::frand(-3.0f, -1.0f) },
+				{ mpn::frand(-1.0f, 1.0f), mpn::frand(-1.0f, 1.0f), mpn::frand(-3.0f, -1.0f) },
+				{ mpn::frand(-1.0f, 1.0f), mpn::frand(-1.0f, 1.0f), mpn::frand(-3.0f, -1.0f) }
+			};
+			const geom::PrecomputedTriangle precomputed(triangle);
+			const geom::Line line(eye, mpn::Vector3(mpn::frand(-0.5f, 0.5f), mpn::frand(-0.5f, 0.5f), -1.0f));
+
+			float u, v, precomputedU, precomputedV;
+			const float distance = geom::intersectTriangle(triangle.vertices[0], triangle.vertices[1], triangle.vertices[2], line, u, v);
+			const float precomputedDistance = precomputed.intersect(line, precomputedU, precomputedV);
+
+			// Rays grazing an edge may be decided differently by the two algorithms
+			if (distance >= 0.0f && precomputedDistance >= 0.0f)
+			{
+				ASSERT_TRUE(abs(distance - precomputedDistance) < 1e-4f);
+				ASSERT_TRUE(abs(u - precomputedU) < 1e-3f);
+				ASSERT_TRUE(abs(v - precomputedV) < 1e-3f);
+			}
+			else if (distance >= 0.0f)
+			{
+				ASSERT_TRUE(u < 1e-3f || v < 1e-3f || u + v > 1.0f - 1e-3f);
+			}
+		}
+	}
+
+	TEST(PrecomputedTriangle_OccludesMatchesIntersect)
+	{
+		// Lines along -z against the plane z = -2, where the barycentrics are u = (x + 1) / 4 and v = (y + 1) / 4
+		const geom::PrecomputedTriangle triangle(geom::Triangle
+		{
+			{ -1.0f, -1.0f, -2.0f },
+			{ +3.0f, -1.0f, -2.0f },
+			{ -1.0f, +3.0f, -2.0f }
+		});
+		const mpn::Vector3 down(0.0f, 0.0f, -1.0f);
+
+		// Clear hits
+		for (const mpn::Point3& origin : { mpn::Point3(0.0f, 0.0f, 0.0f), mpn::Point3(0.5f, -0.5f, 1.0f), mpn::Point3(-0.5f, 2.0f, -1.0f) })
+		{
+			const geom::Line line(origin, down);
+			const float distance = origin[2] + 2.0f;
+			ASSERT_EQUALS(triangle.intersect(line), distance);
+			ASSERT_TRUE(triangle.occludes(line, distance + 0.5f));
+			ASSERT_FALSE(triangle.occludes(line, distance - 0.5f));
+		}
+
+		// Clear misses: beside the triangle, behind the origin and parallel to the plane
+		const geom::Line misses[] =
+		{
+			geom::Line(mpn::Point3(2.0f, 2.0f, 0.0f), down),
+			geom::Line(mpn::Point3(-1.5f, 0.0f, 0.0f), down),
+			geom::Line(mpn::Point3(0.0f, -2.0f, 0.0f), down),
+			geom::Line(mpn::Point3(0.0f, 0.0f, 0.0f), mpn::Vector3(0.0f, 0.0f, 1.0f)),
+			geom::Line(mpn::Point3(0.0f, 0.0f, -2.0f), mpn::Vector3(1.0f, 0.0f, 0.0f))
+		};
+		for (const geom::Line& line : misses)
+		{
+			ASSERT_TRUE(triangle.intersect(line) < 0.0f);
+			ASSERT_FALSE(triangle.occludes(line, 10.0f));
+		}
+	}
+
+	TEST(PrecomputedTriangle_GrazingLinesHitEdgesAndVertices)
+	{
+		// The triangle is closed: lines through an edge or a vertex hit it, as does a line ending exactly on it.
+		// Every coordinate is exact, so both tests must agree on these.
+		const geom::PrecomputedTriangle triangle(geom::Triangle
+		{
+			{ -1.0f, -1.0f, -2.0f },
+			{ +3.0f, -1.0f, -2.0f },
+			{ -1.0f, +3.0f, -2.0f }
+		});
+		const mpn::Vector3 down(0.0f, 0.0f, -1.0f);
+		const mpn::Point3 grazing[] =
+		{
+			{ 1.0f, -1.0f, 0.0f },	// edge v = 0
+			{ -1.0f, 1.0f, 0.0f },	// edge u = 0
+			{ 1.0f, 1.0f, 0.0f },	// edge u + v = 1
+			{ -1.0f, -1.0f, 0.0f },
+			{ 3.0f, -1.0f, 0.0f },
+			{ -1.0f, 3.0f, 0.0f }
+		};
+		for (const mpn::Point3& origin : grazing)
+		{
+			const geom::Line line(origin, down);
+			ASSERT_EQUALS(triangle.intersect(line), 2.0f);
+			ASSERT_TRUE(triangle.occludes(line, 2.0f));
+			ASSERT_FALSE(triangle.occludes(line, 1.5f));
+		}
+	}
+
+	TEST(PrecomputedTriangle_CenterpointPerpendicular)
+	{
+		const geom::PrecomputedTriangle triangle(geom::Triangle
+		{
+			{ 0.0f,  -1.0f, -1.0f },
+			{ -1.0f, +1.0f, -1.0f },
+			{ +1.0f, +1.0f, -1.0f }
+		});
+
+		ASSERT_EQUALS(1.0f, triangle.intersect(ray));
+		ASSERT_TRUE(triangle.occludes(ray, 1.5f));
+		ASSERT_FALSE(triangle.occludes(ray, 0.5f));
+	}
+
 	TEST(AABBIntersection_InvalidCoordinates_Exception)
 	{
 		auto aabbCreationWithNonsortedCoordinates = []()
@@ -150,6 +289,18 @@ TEST_MODULE(PrimitivesTest)
 		ASSERT_TRUE(hit);
 	}
 
+	TEST(AABBOcclusion_WithinAndBeyondRange)
+	{
+		geom::AABB aabb
+		{
+			{ -1.0f, -1.0f, -3.0f },
+			{ +1.0f, +1.0f, -2.0f }
+		};
+
+		ASSERT_TRUE(aabb.occludes(ray, 2.5f));
+		ASSERT_FALSE(aabb.occludes(ray, 1.5f));
+	}
+
 	// Corner, edge, and inside plane tests do not behave consistently (e.g. with current implementation corner is false, edge and in plane is true)
 	// therefore these tests are omitted. Should not cause artifacts in the image if object intersections are handled properly.
 
@@ -205,4 +356,207 @@ TEST_MODULE(PrimitivesTest)
 
 		ASSERT_FALSE(hit);
 	}
+
+	TEST(Frustum_ClassifiesAgainstUnitCube)
+	{
+		// The identity projection sees exactly the device cube
+		const Frustum frustum(mpn::identityMatrix);
+		ASSERT_TRUE(frustum.classify(AABB({ -0.5f, -0.5f, -0.5f }, { 0.5f, 0.5f, 0.5f })) == Containment::Inside);
+		ASSERT_TRUE(frustum.classify(AABB({ 0.5f, -0.5f, -0.5f }, { 1.5f, 0.5f, 0.5f })) == Containment::Intersecting);
+		ASSERT_TRUE(frustum.classify(AABB({ 1.5f, -0.5f, -0.5f }, { 2.5f, 0.5f, 0.5f })) == Containment::Outside);
+		ASSERT_TRUE(frustum.classify(AABB({ -0.5f, -0.5f, -3.0f }, { 0.5f, 0.5f, -2.0f })) == Containment::Outside);
+
+		std::uint8_t planeMask = Frustum::ALL_PLANES;
+		frustum.classify(AABB({ 0.5f, -0.5f, -0.5f }, { 1.5f, 0.5f, 0.5f }), planeMask);
+		ASSERT_EQUALS(planeMask, std::uint8_t(1 << 1));	// only straddles the right plane
+	}
+
+	TEST(Frustum_BatchMatchesSingleClassification)
+	{
+		const Frustum frustum(mpn::identityMatrix);
+		std::vector<AABB> boxes;
+		for (int i = 0; i < 37; ++i)
+		{
+			const mpn::Point3 corner(mpn::frand(-2.0f, 2.0f), mpn::frand(-2.0f, 2.0f), mpn::frand(-2.0f, 2.0f));
+			boxes.emplace_back(corner, corner + mpn::Vector3(mpn::frand(0.0f, 1.0f), mpn::frand(0.0f, 1.0f), mpn::frand(0.0f, 1.0f)));
+		}
+		std::vector<Containment> results(boxes.size());
+		frustum.classify(boxes, results);
+		for (size_t i = 0; i < boxes.size(); ++i)
+			ASSERT_TRUE(results[i] == frustum.classify(boxes[i]));
+		ASSERT_THROWS(std::invalid_argument, [&]() { frustum.classify(boxes, std::span<Containment>(results).first(3)); });
+	}
+
+	TEST(Frustum_BatchLanesClassifyIndependently)
+	{
+		// One box per lane of both register halves of a batch, plus a partial batch, each with a known result
+		const Frustum frustum(mpn::identityMatrix);
+		const std::vector<AABB> boxes = {
+			AABB({ -0.5f, -0.5f, -0.5f }, { 0.5f, 0.5f, 0.5f }),	// inside
+			AABB({ 1.5f, -0.5f, -0.5f }, { 2.5f, 0.5f, 0.5f }),		// right of the right plane
+			AABB({ 0.5f, -0.5f, -0.5f }, { 1.5f, 0.5f, 0.5f }),		// straddling the right plane
+			AABB({ -1.0f, -1.0f, -1.0f }, { 1.0f, 1.0f, 1.0f }),	// touching every plane from inside
+			AABB({ -0.5f, -2.5f, -0.5f }, { 0.5f, -1.5f, 0.5f }),	// below
+			AABB({ -0.5f, 0.5f, -0.5f }, { 0.5f, 1.5f, 0.5f }),		// straddling the top plane
+			AABB({ -0.5f, -0.5f, 1.0f }, { 0.5f, 0.5f, 2.0f }),		// touching the far plane from outside
+			AABB({ -3.0f, -3.0f, -3.0f }, { 3.0f, 3.0f, 3.0f }),	// enclosing the frustum
+			AABB({ -0.5f, -0.5f, -3.0f }, { 0.5f, 0.5f, -2.0f }),	// in front of the near plane
+			AABB({ -0.1f, -0.1f, -0.1f }, { 0.1f, 0.1f, 0.1f }),	// inside
+			AABB({ -1.5f, -0.5f, -0.5f }, { -0.5f, 0.5f, 0.5f })	// straddling the left plane
+		};
+		const Containment expected[] = {
+			Containment::Inside, Containment::Outside, Containment::Intersecting, Containment::Inside,
+			Containment::Outside, Containment::Intersecting, Containment::Intersecting, Containment::Intersecting,
+			Containment::Outside, Containment::Inside, Containment::Intersecting
+		};
+		std::vector<Containment> results(boxes.size());
+		frustum.classify(boxes, results);
+		for (size_t i = 0; i < boxes.size(); ++i)
+			ASSERT_TRUE(results[i] == expected[i]);
+
+		// Without the left and right planes only the vertical and depth tests remain
+		frustum.classify(boxes, results, Frustum::ALL_PLANES & ~0x3);
+		ASSERT_TRUE(results[1] == Containment::Inside);
+		ASSERT_TRUE(results[2] == Containment::Inside);
+		ASSERT_TRUE(results[4] == Containment::Outside);
+		ASSERT_TRUE(results[10] == Containment::Inside);
+	}
+
+	TEST(Triangle_ClosestPointPerRegion)
+	{
+		const Triangle triangle({ 0.0f, 0.0f, 0.0f }, { 2.0f, 0.0f, 0.0f }, { 0.0f, 2.0f, 0.0f });
+		ASSERT_EQUALS(triangle.closestPoint({ -1.0f, -1.0f, 0.0f }), mpn::Point3(0.0f, 0.0f, 0.0f));	// vertex
+		ASSERT_EQUALS(triangle.closestPoint({ 1.0f, -1.0f, 3.0f }), mpn::Point3(1.0f, 0.0f, 0.0f));	// edge
+		ASSERT_EQUALS(triangle.closestPoint({ 2.0f, 2.0f, 0.0f }), mpn::Point3(1.0f, 1.0f, 0.0f));	// hypotenuse
+		ASSERT_EQUALS(triangle.closestPoint({ 0.5f, 0.5f, -2.0f }), mpn::Point3(0.5f, 0.5f, 0.0f));	// face
+		ASSERT_EQUALS(triangle.distance({ 0.5f, 0.5f, -2.0f }), 2.0f);
+	}
+
+	TEST(AABB_ClosestPointAndDistance)
+	{
+		const AABB box({ 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f });
+		ASSERT_EQUALS(box.closestPoint({ 0.5f, 0.5f, 0.5f }), mpn::Point3(0.5f, 0.5f, 0.5f));
+		ASSERT_EQUALS(box.distance({ 0.5f, 0.5f, 0.5f }), 0.0f);
+		ASSERT_EQUALS(box.closestPoint({ 3.0f, 0.5f, -4.0f }), mpn::Point3(1.0f, 0.5f, 0.0f));
+		ASSERT_EQUALS(box.squaredDistance({ 3.0f, 0.5f, -4.0f }), 20.0f);
+	}
+
+	TEST(Triangle_AABBOverlap)
+	{
+		const AABB box({ 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f });
+		ASSERT_TRUE(overlaps(Triangle({ 0.2f, 0.2f, 0.5f }, { 0.8f, 0.2f, 0.5f }, { 0.5f, 0.8f, 0.5f }), box));	// inside
+		ASSERT_TRUE(overlaps(Triangle({ -5.0f, -5.0f, 0.5f }, { 5.0f, -5.0f, 0.5f }, { 0.0f, 5.0f, 0.5f }), box));	// vertices all outside
+		ASSERT_TRUE(overlaps(Triangle({ 1.0f, 0.0f, 0.0f }, { 2.0f, 0.0f, 0.0f }, { 2.0f, 1.0f, 0.0f }), box));	// touching a corner
+		ASSERT_FALSE(overlaps(Triangle({ 2.0f, 0.0f, 0.0f }, { 3.0f, 0.0f, 0.0f }, { 3.0f, 1.0f, 0.0f }), box));	// box axis
+		ASSERT_FALSE(overlaps(Triangle({ 2.6f, 0.0f, 0.0f }, { 0.0f, 2.6f, 0.0f }, { 0.0f, 2.6f, 1.0f }), box));	// triangle normal
+		ASSERT_FALSE(overlaps(Triangle({ 1.8f, 1.9f, 1.9f }, { -0.2f, 0.0f, 1.0f }, { 1.9f, 0.9f, 1.2f }), box));	// edge cross product
+	}
+
+	TEST(Triangle_ClipToBox)
+	{
+		// A long diagonal triangle, its bounds are the whole cube but only a thin sliver is inside the slab
+		const Triangle triangle({ 0.0f, 0.0f, 0.0f }, { 10.0f, 10.0f, 0.0f }, { 10.0f, 10.0f, 1.0f });
+		AABB clipped;
+		ASSERT_TRUE(clipTriangle(triangle, AABB({ 2.0f, 0.0f, 0.0f }, { 3.0f, 10.0f, 10.0f }), clipped));
+		ASSERT_EQUALS(clipped.minCoords, mpn::Point3(2.0f, 2.0f, 0.0f));
+		ASSERT_EQUALS(clipped.maxCoords, mpn::Point3(3.0f, 3.0f, 0.3f));
+		ASSERT_FALSE(clipTriangle(triangle, AABB({ 2.0f, 5.0f, 0.0f }, { 3.0f, 10.0f, 10.0f }), clipped));
+	}
+
+	const float SQRT1_2 = std::sqrt(0.5f);
+	// Thin box along the diagonal of the xy plane
+	const OBB diagonalBox(mpn::Point3(0.0f, 0.0f, 0.0f),
+		{ mpn::Vector3(SQRT1_2, SQRT1_2, 0.0f), mpn::Vector3(-SQRT1_2, SQRT1_2, 0.0f), mpn::Vector3(0.0f, 0.0f, 1.0f) },
+		mpn::Vector3(2.0f, 0.1f, 1.0f));
+
+	TEST(SymmetricEigen_RecoversRotatedDiagonal)
+	{
+		const mpn::Vector3 axes[3] = { mpn::Vector3(SQRT1_2, SQRT1_2, 0.0f), mpn::Vector3(-0.5f, 0.5f, SQRT1_2), mpn::Vector3(0.5f, -0.5f, SQRT1_2) };
+		const float values[3] = { 0.5f, 5.0f, 2.0f };
+		mpn::Matrix3 matrix;
+		for (int row = 0; row < 3; ++row)
+			for (int column = 0; column < 3; ++column)
+				for (int k = 0; k < 3; ++k)
+					matrix(row, column) += values[k] * axes[k][row] * axes[k][column];
+
+		mpn::Vector3 eigenvalues;
+		mpn::Matrix3 eigenvectors;
+		mpn::symmetricEigen(matrix, eigenvalues, eigenvectors);
+		ASSERT_EQUALS(eigenvalues, mpn::Vector3(5.0f, 2.0f, 0.5f));
+		for (int i = 0; i < 3; ++i)
+		{
+			const mpn::Vector3 vector(eigenvectors(0, i), eigenvectors(1, i), eigenvectors(2, i));
+			for (int row = 0; row < 3; ++row)
+			{
+				const float product = matrix(row, 0) * vector[0] + matrix(row, 1) * vector[1] + matrix(row, 2) * vector[2];
+				ASSERT_TRUE(std::abs(product - eigenvalues[i] * vector[row]) < 1e-5f);
+			}
+		}
+	}
+
+	TEST(OBB_LineIntersection)
+	{
+		const geom::Line alongY({ 0.0f, -5.0f, 0.0f }, { 0.0f, 1.0f, 0.0f });
+		ASSERT_TRUE(std::abs(diagonalBox.entryDistance(alongY) - (5.0f - 0.1f / SQRT1_2)) < 1e-5f);
+		// Inside the axis aligned bounds but beside the box
+		const geom::Line beside({ 1.2f, -1.2f, -5.0f }, { 0.0f, 0.0f, 1.0f });
+		ASSERT_TRUE(diagonalBox.getBounds().intersect(beside));
+		ASSERT_FALSE(diagonalBox.intersect(beside));
+		ASSERT_EQUALS(diagonalBox.entryDistance(geom::Line({ 0.5f, 0.5f, 0.0f }, { 0.0f, 1.0f, 0.0f })), 0.0f);
+	}
+
+	TEST(OBB_Overlap)
+	{
+		const OBB crossing(mpn::Point3(0.0f, 0.0f, 0.0f), { diagonalBox.axes[1], diagonalBox.axes[0], diagonalBox.axes[2] }, mpn::Vector3(2.0f, 0.1f, 0.5f));
+		ASSERT_TRUE(overlaps(diagonalBox, crossing));
+		ASSERT_FALSE(overlaps(diagonalBox, OBB(crossing.center + mpn::Vector3(0.0f, 0.0f, 1.6f), crossing.axes, crossing.halfExtents)));
+
+		const OBB corner(AABB({ 0.9f, -1.5f, -0.3f }, { 1.5f, -0.9f, 0.3f }));
+		ASSERT_TRUE(overlaps(diagonalBox.getBounds(), corner.getBounds()));
+		ASSERT_FALSE(overlaps(diagonalBox, corner));
+		ASSERT_TRUE(overlaps(diagonalBox, OBB(AABB({ 0.5f, 0.3f, -0.3f }, { 1.1f, 0.9f, 0.3f }))));
+	}
+
+	TEST(OBB_FitRecoversRotatedBox)
+	{
+		const mpn::Vector3 half(3.0f, 1.0f, 0.2f);
+		std::vector<mpn::Point3> corners;
+		for (int i = 0; i < 8; ++i)
+		{
+			mpn::Point3 corner(1.0f, 2.0f, 3.0f);
+			for (int axis = 0; axis < 3; ++axis)
+				corner = corner + diagonalBox.axes[axis] * ((i >> axis & 1) ? half[axis] : -half[axis]);
+			corners.push_back(corner);
+		}
+		const OBB box = createOBB(corners);
+		ASSERT_EQUALS(box.halfExtents, half);
+		ASSERT_EQUALS(box.center, mpn::Point3(1.0f, 2.0f, 3.0f));
+		for (int axis = 0; axis < 3; ++axis)
+			ASSERT_TRUE(std::abs(std::abs(box.axes[axis] * diagonalBox.axes[axis]) - 1.0f) < 1e-5f);
+		ASSERT_THROWS(std::invalid_argument, []() { createOBB(std::span<const mpn::Point3>()); });
+	}
+
+	TEST(Covariance_TrianglesIndependentOfTessellation)
+	{
+		// The same 4 x 1 rectangle as 2 and as 4 triangles
+		const mpn::Point3 a(0.0f, 0.0f, 0.0f), b(4.0f, 0.0f, 0.0f), c(4.0f, 1.0f, 0.0f), d(0.0f, 1.0f, 0.0f), m(2.0f, 0.5f, 0.0f);
+		const std::vector<Triangle> coarse{ Triangle(a, b, c), Triangle(a, c, d) };
+		const std::vector<Triangle> fine{ Triangle(a, b, m), Triangle(b, c, m), Triangle(c, d, m), Triangle(d, a, m) };
+		mpn::Point3 coarseMean, fineMean;
+		ASSERT_EQUALS(covariance(coarse, coarseMean), covariance(fine, fineMean));
+		ASSERT_EQUALS(coarseMean, m);
+		// Uniform distribution over [0, 4]: variance 16 / 12
+		ASSERT_TRUE(std::abs(covariance(coarse, coarseMean)(0, 0) - 16.0f / 12.0f) < 1e-5f);
+	}
+
+	TEST(Covariance_DegenerateTrianglesUseTheVertices)
+	{
+		// Collinear triangles have no area, their covariance is the one of their vertices
+		const mpn::Point3 a(0.0f, 0.0f, 0.0f), b(1.0f, 1.0f, 0.0f), c(3.0f, 3.0f, 0.0f);
+		const std::vector<Triangle> flat{ Triangle(a, b, c), Triangle(c, b, a) };
+		const std::vector<mpn::Point3> vertices{ a, b, c, c, b, a };
+		mpn::Point3 triangleMean, vertexMean;
+		ASSERT_EQUALS(covariance(flat, triangleMean), covariance(vertices, vertexMean));
+		ASSERT_EQUALS(triangleMean, vertexMean);
+	}
 }
\ No newline at end of file
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "../nuketest/nuketest/use_nuketest.h"
+
+#include "../math/sdf.h"
+
+TEST_MODULE(SDFTest)
+{
+	using namespace geom;
+
+	auto createCube = []()
+	{
+		// Faces of the [-1, 1] cube wound counterclockwise seen from outside
+		std::vector<Triangle> triangles;
+		for (int axis = 0; axis < 3; ++axis)
+			for (float side : { -1.0f, 1.0f })
+			{
+				mpn::Point3 corners[4];
+				for (int i = 0; i < 4; ++i)
+				{
+					corners[i][axis] = side;
+					corners[i][(axis + 1) % 3] = i == 1 || i == 2 ? 1.0f : -1.0f;
+					corners[i][(axis + 2) % 3] = i >= 2 ? 1.0f : -1.0f;
+				}
+				Triangle first(corners[0], corners[1], corners[2]);
+				Triangle second(corners[0], corners[2], corners[3]);
+				if (((corners[1] - corners[0]) % (corners[2] - corners[0]))[axis] * side < 0.0f)
+				{
+					std::swap(first.vertices[1], first.vertices[2]);
+					std::swap(second.vertices[1], second.vertices[2]);
+				}
+				triangles.push_back(first);
+				triangles.push_back(second);
+			}
+		return triangles;
+	};
+
+	auto cubeDistance = [](const mpn::Point3& point)
+	{
+		float outside = 0.0f, inside = -FLT_MAX;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const float q = std::abs(point[axis]) - 1.0f;
+			outside += std::max(q, 0.0f) * std::max(q, 0.0f);
+			inside = std::max(inside, q);
+		}
+		return std::sqrt(outside) + std::min(inside, 0.0f);
+	};
+
+	TEST(SDFBaker_DenseGridMatchesAnalyticDistance)
+	{
+		const std::vector<Triangle> cube = createCube();
+		for (SignMethod sign : { SignMethod::RayParity, SignMethod::WindingNumber })
+		{
+			SDFSettings settings;
+			settings.resolution = 13;
+			settings.sign = sign;
+			const SDFBaker baker(cube, settings);
+			const SDFGrid grid = baker.bakeDense(3);
+			ASSERT_EQUALS(grid.layout.samples[0], std::uint32_t(17));
+			for (std::uint32_t z = 0; z < grid.layout.samples[2]; ++z)
+				for (std::uint32_t y = 0; y < grid.layout.samples[1]; ++y)
+					for (std::uint32_t x = 0; x < grid.layout.samples[0]; ++x)
+						ASSERT_TRUE(std::abs(grid.at(x, y, z) - cubeDistance(grid.layout.position(x, y, z))) < 1e-4f);
+		}
+		ASSERT_THROWS(std::invalid_argument, [&]() { SDFBaker(std::vector<Triangle>(), SDFSettings()); });
+	}
+
+	TEST(SDFBaker_NarrowBandStreamsOnlyBricksNearTheSurface)
+	{
+		SDFSettings settings;
+		settings.resolution = 25;
+		settings.narrowBand = 0.1f;
+		const SDFBaker baker(createCube(), settings);
+		const SDFGrid grid = baker.bakeDense();
+		// A brick is streamed when the surface is within the narrow band of the sphere around its samples,
+		// which sticks out of the sample box by up to (sqrt(3) - 1) half box sides; a sample is then within a spacing
+		const float spacing = grid.layout.spacing;
+		const float reach = settings.narrowBand + 0.5f * (SDFBrick::SIZE - 1) * spacing * (std::sqrt(3.0f) - 1.0f) + spacing;
+
+		size_t brickCount = 0;
+		baker.bake([&](const SDFBrick& brick)
+			{
+				++brickCount;
+				float closest = FLT_MAX;
+				for (int z = 0; z < SDFBrick::SIZE; ++z)
+					for (int y = 0; y < SDFBrick::SIZE; ++y)
+						for (int x = 0; x < SDFBrick::SIZE; ++x)
+						{
+							const std::uint32_t sx = brick.brick[0] * SDFBrick::SIZE + x;
+							const std::uint32_t sy = brick.brick[1] * SDFBrick::SIZE + y;
+							const std::uint32_t sz = brick.brick[2] * SDFBrick::SIZE + z;
+							if (sx < grid.layout.samples[0] && sy < grid.layout.samples[1] && sz < grid.layout.samples[2])
+							{
+								ASSERT_EQUALS(brick.at(x, y, z), grid.at(sx, sy, sz));
+								closest = std::min(closest, std::abs(brick.at(x, y, z)));
+							}
+						}
+				ASSERT_TRUE(closest <= reach);
+			}, 2);
+		ASSERT_TRUE(brickCount > 0 && brickCount < baker.getLayout().brickCount());
+	}
+}
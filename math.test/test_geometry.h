@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+
+#include "../math/math.h"
+#include "../math/primitives.h"
+#include "../math/random.h"
+
+/*Random scenes and brute force references shared by the geometry test modules.*/
+
+namespace geomTest {
+
+	inline std::vector<geom::Triangle> createRandomTriangles(int count)
+	{
+		std::vector<geom::Triangle> triangles;
+		for (int i = 0; i < count; ++i)
+		{
+			const mpn::Point3 center(mpn::frand(-10.0f, 10.0f), mpn::frand(-10.0f, 10.0f), mpn::frand(-10.0f, 10.0f));
+			triangles.emplace_back(
+				center + mpn::Vector3(mpn::frand(-1.0f, 1.0f), mpn::frand(-1.0f, 1.0f), mpn::frand(-1.0f, 1.0f)),
+				center + mpn::Vector3(mpn::frand(-1.0f, 1.0f), mpn::frand(-1.0f, 1.0f), mpn::frand(-1.0f, 1.0f)),
+				center + mpn::Vector3(mpn::frand(-1.0f, 1.0f), mpn::frand(-1.0f, 1.0f), mpn::frand(-1.0f, 1.0f)));
+		}
+		return triangles;
+	}
+
+	inline geom::Line createRandomLine()
+	{
+		return geom::Line(
+			mpn::Point3(mpn::frand(-15.0f, 15.0f), mpn::frand(-15.0f, 15.0f), mpn::frand(-15.0f, 15.0f)),
+			mpn::Vector3(mpn::frand(-1.0f, 1.0f), mpn::frand(-1.0f, 1.0f), mpn::frand(-1.0f, 1.0f)));
+	}
+
+	inline std::vector<mpn::Point3> createRandomPoints(int count)
+	{
+		std::vector<mpn::Point3> points;
+		for (int i = 0; i < count; ++i)
+			points.emplace_back(mpn::frand(-10.0f, 10.0f), mpn::frand(-10.0f, 10.0f), mpn::frand(-10.0f, 10.0f));
+		return points;
+	}
+
+	inline float bruteForceIntersect(const std::vector<geom::Triangle>& triangles, const geom::Line& line)
+	{
+		float closest = geom::INVALID_DISTANCE;
+		for (const geom::Triangle& triangle : triangles)
+		{
+			const float distance = triangle.intersect(line);
+			if (distance >= 0.0f && (closest < 0.0f || distance < closest))
+				closest = distance;
+		}
+		return closest;
+	}
+}
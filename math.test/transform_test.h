@@ -3,6 +3,7 @@
 
 #include "../nuketest/nuketest/use_nuketest.h"
 
+#include "..\math\camera.h"
 #include "..\math\math.h"
 #include "..\math\transform.h"
 #include "..\math\point.h"
@@ -69,4 +70,70 @@ TEST_MODULE(Transform)
 		ASSERT_EQUALS(mpn::cartesianToSpherical(mpn::Vector3(sqrt2, -sqrt2, 0.0f)), mpn::SphericalVector3(1.0f, -PI_4, 0.0f));
 	}
 	
+
+	// Perspective projection for row vectors: 90 degree vertical field of view, near 1, far 100, looking down -z
+	const mpn::Matrix4 projection(
+		1.0f, 0.0f, 0.0f, 0.0f,
+		0.0f, 1.0f, 0.0f, 0.0f,
+		0.0f, 0.0f, -101.0f / 99.0f, -1.0f,
+		0.0f, 0.0f, -200.0f / 99.0f, 0.0f);
+	const mpn::Matrix4 inverseProjection(
+		1.0f, 0.0f, 0.0f, 0.0f,
+		0.0f, 1.0f, 0.0f, 0.0f,
+		0.0f, 0.0f, 0.0f, -99.0f / 200.0f,
+		0.0f, 0.0f, -1.0f, 101.0f / 200.0f);
+
+	TEST(CameraCenterLine)
+	{
+		const geom::Camera camera(projection, inverseProjection, 64, 32);
+		const geom::Line line = camera.generateLine(32.0f, 16.0f);
+		ASSERT_EQUALS(line.P, mpn::Point3(0.0f, 0.0f, -1.0f));
+		ASSERT_EQUALS(line.v.asUnitVector(), mpn::Vector3(0.0f, 0.0f, -1.0f));
+		ASSERT_TRUE(fabsf(line.v.length() - 99.0f) < 1e-3f);
+	}
+
+	TEST(CameraTileMatchesUnprojection)
+	{
+		const geom::Camera camera(projection, inverseProjection, 64, 32);
+		geom::LineBuffer lines;
+		camera.generateTile(8, 4, 16, 8, lines);
+		ASSERT_EQUALS(lines.size(), size_t(16 * 8));
+		for (int y = 0; y < 8; ++y)
+			for (int x = 0; x < 16; ++x)
+			{
+				const geom::Line expected = camera.generateLine(8 + x + 0.5f, 4 + y + 0.5f);
+				const geom::Line line = lines.line(y * 16 + x);
+				ASSERT_EQUALS(line.P, expected.P);
+				ASSERT_EQUALS(line.v.asUnitVector(), expected.v.asUnitVector());
+			}
+	}
+
+	TEST(CameraThinLensKeepsFocus)
+	{
+		geom::Camera camera(projection, inverseProjection, 64, 32);
+		const geom::Line pinhole = camera.generateLine(20.0f, 10.0f);
+		camera.setThinLens(0.5f, 0.25f);
+		for (int i = 0; i < 10; ++i)
+		{
+			const geom::Line line = camera.generateLine(20.0f, 10.0f);
+			ASSERT_TRUE(((line.P + line.v * 0.25f) - (pinhole.P + pinhole.v * 0.25f)).length() < 1e-3f);
+		}
+		ASSERT_THROWS(std::invalid_argument, [&]() { camera.setThinLens(0.5f, 0.0f); });
+	}
+
+	TEST(TransformFromMatrixInvertsIt)
+	{
+		const mpn::Transform composed = mpn::Transform(mpn::Vector3(2, 1, 0.5f), mpn::Point3(3, -1, 4))
+			* mpn::Transform(geom::Line(mpn::Point3(0, 0, 0), mpn::Vector3(0, 1, 0)), 0.7f);
+		float data[16];
+		std::copy(composed.getMatrixData(), composed.getMatrixData() + 16, data);
+		const mpn::Transform fromMatrix{ mpn::Matrix4(data) };
+		const mpn::Point3 point(1, -2, 5);
+		ASSERT_EQUALS(fromMatrix.inverseTransform(fromMatrix.transform(point)), point);
+		ASSERT_EQUALS(fromMatrix.inverseTransform(point), composed.inverseTransform(point));
+
+		const mpn::Transform perspective(projection);
+		ASSERT_EQUALS(perspective.inverseTransform(mpn::Point3(0.25f, -0.5f, 0.5f) * projection), mpn::Point3(0.25f, -0.5f, 0.5f));
+		ASSERT_THROWS(std::invalid_argument, []() { mpn::Transform(mpn::Matrix4()); });
+	}
 }
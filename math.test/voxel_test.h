@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "../nuketest/nuketest/use_nuketest.h"
+
+#include "../math/mesh.h"
+#include "../math/voxel.h"
+
+#include "test_geometry.h"
+
+TEST_MODULE(VoxelTest)
+{
+	using namespace geom;
+	using namespace geomTest;
+
+	TEST(VoxelGrid_MatchesBruteForceOverlapAndTraversal)
+	{
+		const std::vector<Triangle> triangles = createRandomTriangles(100);
+		const VoxelGrid grid(triangles, 16, 3);
+		const std::array<std::uint32_t, 3> size = grid.getSize();
+		size_t expectedCount = 0;
+		for (std::uint32_t z = 0; z < size[2]; ++z)
+			for (std::uint32_t y = 0; y < size[1]; ++y)
+				for (std::uint32_t x = 0; x < size[0]; ++x)
+				{
+					bool expected = false;
+					for (const Triangle& triangle : triangles)
+						expected = expected || overlaps(triangle, grid.getVoxelBounds(x, y, z));
+					ASSERT_EQUALS(grid.get(x, y, z), expected);
+					expectedCount += expected;
+				}
+		ASSERT_EQUALS(grid.count(), expectedCount);
+
+		const TriangleMesh mesh(triangles);
+		for (int i = 0; i < 100; ++i)
+		{
+			const Line line = createRandomLine();
+			float expected = INVALID_DISTANCE;
+			for (std::uint32_t z = 0; z < size[2]; ++z)
+				for (std::uint32_t y = 0; y < size[1]; ++y)
+					for (std::uint32_t x = 0; x < size[0]; ++x)
+					{
+						const float entry = grid.get(x, y, z) ? grid.getVoxelBounds(x, y, z).entryDistance(line) : INVALID_DISTANCE;
+						if (entry >= 0.0f && (expected < 0.0f || entry < expected))
+							expected = entry;
+					}
+
+			std::array<std::uint32_t, 3> voxel;
+			const float distance = grid.intersect(line, &voxel);
+			ASSERT_TRUE(std::abs(distance - expected) < 1e-3f);
+			if (distance >= 0.0f)
+				ASSERT_TRUE(grid.get(voxel[0], voxel[1], voxel[2]));
+			// Conservative: a surface hit is never in front of the voxel hit
+			const float hit = mesh.intersect(line);
+			if (hit >= 0.0f)
+				ASSERT_TRUE(distance >= 0.0f && distance <= hit + 1e-4f);
+		}
+	}
+}
@@ -0,0 +1,98 @@
+#include "batch.h"
+
+#include <cfloat>
+
+namespace geom {
+
+	namespace {
+
+		// Spreads the lower 10 bits of the value so there are two zero bits between each
+		std::uint32_t spreadBits(std::uint32_t value)
+		{
+			value &= 0x3FF;
+			value = (value | (value << 16)) & 0x030000FF;
+			value = (value | (value << 8)) & 0x0300F00F;
+			value = (value | (value << 4)) & 0x030C30C3;
+			value = (value | (value << 2)) & 0x09249249;
+			return value;
+		}
+
+		// 30 bit Morton codes of the positions over their bounding box, 10 bits per axis
+		template<typename Position>
+		std::vector<std::uint32_t> mortonCodes(size_t count, Position&& position)
+		{
+			::mpn::Point3 minCoords(FLT_MAX, FLT_MAX, FLT_MAX);
+			::mpn::Point3 maxCoords(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+			for (size_t i = 0; i < count; ++i)
+			{
+				const ::mpn::Point3& p = position(i);
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					minCoords[axis] = std::min(minCoords[axis], p[axis]);
+					maxCoords[axis] = std::max(maxCoords[axis], p[axis]);
+				}
+			}
+			float scale[3];
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				const float extent = maxCoords[axis] - minCoords[axis];
+				scale[axis] = extent > 0.0f ? 1023.0f / extent : 0.0f;
+			}
+
+			std::vector<std::uint32_t> codes(count);
+			for (size_t i = 0; i < count; ++i)
+			{
+				const ::mpn::Point3& p = position(i);
+				std::uint32_t morton = 0;
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					const std::uint32_t cell = static_cast<std::uint32_t>((p[axis] - minCoords[axis]) * scale[axis]);
+					morton |= spreadBits(cell) << axis;
+				}
+				codes[i] = morton;
+			}
+			return codes;
+		}
+	}
+
+	namespace detail {
+
+		std::vector<std::uint32_t> sortByKey(std::span<const std::uint32_t> keys)
+		{
+			// 8 bits per pass
+			std::vector<std::uint32_t> order(keys.size()), buffer(keys.size());
+			for (size_t i = 0; i < order.size(); ++i)
+				order[i] = static_cast<std::uint32_t>(i);
+			for (int shift = 0; shift < 32; shift += 8)
+			{
+				size_t offsets[257] = {};
+				for (std::uint32_t index : order)
+					++offsets[((keys[index] >> shift) & 0xFF) + 1];
+				for (int bucket = 0; bucket < 256; ++bucket)
+					offsets[bucket + 1] += offsets[bucket];
+				for (std::uint32_t index : order)
+					buffer[offsets[(keys[index] >> shift) & 0xFF]++] = index;
+				order.swap(buffer);
+			}
+			return order;
+		}
+	}
+
+	std::vector<std::uint32_t> sortCoherent(std::span<const Line> lines)
+	{
+		// Key: direction octant in the top 3 bits, the 29 most significant bits of the origin Morton code below
+		std::vector<std::uint32_t> keys = mortonCodes(lines.size(), [lines](size_t i) -> const ::mpn::Point3& { return lines[i].P; });
+		for (size_t i = 0; i < lines.size(); ++i)
+		{
+			const Line& line = lines[i];
+			const std::uint32_t octant = (line.v[0] < 0.0f ? 1u : 0u) | (line.v[1] < 0.0f ? 2u : 0u) | (line.v[2] < 0.0f ? 4u : 0u);
+			keys[i] = (octant << 29) | (keys[i] >> 1);
+		}
+		return detail::sortByKey(keys);
+	}
+
+	std::vector<std::uint32_t> sortCoherent(std::span<const ::mpn::Point3> points)
+	{
+		return detail::sortByKey(mortonCodes(points.size(), [points](size_t i) -> const ::mpn::Point3& { return points[i]; }));
+	}
+}
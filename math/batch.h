@@ -0,0 +1,84 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "parallel.h"
+#include "primitives.h"
+
+namespace geom {
+
+	/*Returns the order in which the lines are traversed most coherently: grouped by the octant of their
+	  direction, then sorted along a Morton curve over their origins. Lines next to each other in the
+	  result start close to each other and head the same way, so they touch the same nodes.*/
+	::std::vector<::std::uint32_t> sortCoherent(::std::span<const Line> lines);
+
+	/*Returns the order of the points along a Morton curve, so points next to each other in the result are close.*/
+	::std::vector<::std::uint32_t> sortCoherent(::std::span<const ::mpn::Point3> points);
+
+	namespace detail {
+
+		/*Indices of the keys in ascending key order, equal keys keeping their order (LSD radix sort).*/
+		::std::vector<::std::uint32_t> sortByKey(::std::span<const ::std::uint32_t> keys);
+	}
+
+	/*Runs a query for every line (or point) of a large batch.
+	  The items are reordered by sortCoherent() and processed in consecutive groups of 'groupSize'
+	  by 'threadCount' workers (mpn::defaultThreadCount() if zero). Results are written back in input order.
+	 - query: Result(const Item& item), must be thread safe and must not throw.
+	 Throws std::invalid_argument if the result span is not as long as the item span.*/
+	template<typename Item, typename Result, typename Query>
+	void queryBatch(::std::span<const Item> items, ::std::span<Result> results, Query&& query, int threadCount = 0, int groupSize = 256)
+	{
+		if (results.size() != items.size())
+			throw ::std::invalid_argument("There must be one result for each query");
+		if (items.empty())
+			return;
+
+		const ::std::vector<::std::uint32_t> order = sortCoherent(items);
+		const size_t groupCount = (items.size() + groupSize - 1) / groupSize;
+		::std::atomic<size_t> nextGroup{ 0 };
+		auto worker = [&]()
+		{
+			for (size_t group = nextGroup++; group < groupCount; group = nextGroup++)
+			{
+				const size_t end = ::std::min(items.size(), (group + 1) * groupSize);
+				for (size_t i = group * groupSize; i < end; ++i)
+					results[order[i]] = query(items[order[i]]);
+			}
+		};
+
+		if (threadCount <= 0)
+			threadCount = ::mpn::defaultThreadCount();
+		threadCount = static_cast<int>(::std::min<size_t>(threadCount, groupCount));
+		::std::vector<::std::thread> workers;
+		workers.reserve(threadCount - 1);
+		for (int i = 1; i < threadCount; ++i)
+			workers.emplace_back(worker);
+		worker();
+		for (::std::thread& thread : workers)
+			thread.join();
+	}
+
+	/*Closest hit distances of a batch of lines against any structure with intersect(const Line&).*/
+	template<typename Structure>
+	void intersectBatch(const Structure& structure, ::std::span<const Line> lines, ::std::span<float> distances, int threadCount = 0)
+	{
+		queryBatch(lines, distances, [&structure](const Line& line) { return structure.intersect(line); }, threadCount);
+	}
+
+	/*Occlusion results of a batch of lines against any structure with occludes(const Line&, float).
+	  Stored as bytes rather than bits, which workers could not write concurrently.*/
+	template<typename Structure>
+	void occludesBatch(const Structure& structure, ::std::span<const Line> lines, float maxDistance, ::std::span<::std::uint8_t> occluded, int threadCount = 0)
+	{
+		queryBatch(lines, occluded,
+			[&structure, maxDistance](const Line& line) { return static_cast<::std::uint8_t>(structure.occludes(line, maxDistance)); },
+			threadCount);
+	}
+}
@@ -0,0 +1,146 @@
+#include "broadphase.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+#include "batch.h"
+#include "parallel.h"
+
+namespace geom {
+
+	namespace {
+
+		constexpr size_t SWEEP_GROUP_SIZE = 512;
+
+		// Insertion sort gives up after this many moves per box and the boxes are sorted from scratch instead
+		constexpr size_t MAX_REPAIR_MOVES = 16;
+
+		// Maps a float to an unsigned integer with the same order
+		std::uint32_t sortKey(float value) noexcept
+		{
+			std::uint32_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			return bits & 0x80000000u ? ~bits : bits | 0x80000000u;
+		}
+
+		int highestVarianceAxis(std::span<const AABB> boxes) noexcept
+		{
+			double sum[3] = {}, sumOfSquares[3] = {};
+			for (const AABB& box : boxes)
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					const double center = 0.5 * (double(box.minCoords[axis]) + double(box.maxCoords[axis]));
+					sum[axis] += center;
+					sumOfSquares[axis] += center * center;
+				}
+			int best = 0;
+			double bestVariance = -1.0;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				const double variance = sumOfSquares[axis] - sum[axis] * sum[axis] / double(boxes.size());
+				if (variance > bestVariance)
+				{
+					bestVariance = variance;
+					best = axis;
+				}
+			}
+			return best;
+		}
+	}
+
+	void SweepAndPrune::update(std::span<const AABB> boxes, int threadCount)
+	{
+		pairs.clear();
+		if (boxes.empty())
+		{
+			order.clear();
+			sorted.clear();
+			return;
+		}
+
+		const int bestAxis = highestVarianceAxis(boxes);
+		if (bestAxis != axis || order.size() != boxes.size() || !repairOrder(boxes))
+		{
+			axis = bestAxis;
+			sortFromScratch(boxes);
+		}
+		sorted.resize(boxes.size());
+		for (size_t i = 0; i < order.size(); ++i)
+			sorted[i] = boxes[order[i]];
+
+		// Each worker sweeps groups of consecutive boxes forward, into its own pair buffer
+		if (threadCount <= 0)
+			threadCount = ::mpn::defaultThreadCount();
+		const size_t groupCount = (sorted.size() + SWEEP_GROUP_SIZE - 1) / SWEEP_GROUP_SIZE;
+		threadCount = static_cast<int>(std::min<size_t>(threadCount, groupCount));
+		threadPairs.resize(threadCount);
+		std::atomic<size_t> nextGroup{ 0 };
+		auto worker = [&](std::vector<Pair>& found)
+		{
+			found.clear();
+			for (size_t group = nextGroup++; group < groupCount; group = nextGroup++)
+			{
+				const size_t end = std::min(sorted.size(), (group + 1) * SWEEP_GROUP_SIZE);
+				for (size_t i = group * SWEEP_GROUP_SIZE; i < end; ++i)
+				{
+					const AABB& box = sorted[i];
+					const float sweepEnd = box.maxCoords[axis];
+					for (size_t j = i + 1; j < sorted.size() && sorted[j].minCoords[axis] <= sweepEnd; ++j)
+						if (overlaps(box, sorted[j]))
+							found.emplace_back(std::min(order[i], order[j]), std::max(order[i], order[j]));
+				}
+			}
+		};
+
+		std::vector<std::thread> workers;
+		workers.reserve(threadCount - 1);
+		for (int i = 1; i < threadCount; ++i)
+			workers.emplace_back(worker, std::ref(threadPairs[i]));
+		worker(threadPairs[0]);
+		for (std::thread& thread : workers)
+			thread.join();
+
+		size_t total = 0;
+		for (const std::vector<Pair>& found : threadPairs)
+			total += found.size();
+		pairs.reserve(total);
+		for (const std::vector<Pair>& found : threadPairs)
+			pairs.insert(pairs.end(), found.begin(), found.end());
+	}
+
+	void SweepAndPrune::sortFromScratch(std::span<const AABB> boxes)
+	{
+		// Radix sort of the indices by the minimum along the axis
+		std::vector<std::uint32_t> keys(boxes.size());
+		for (size_t i = 0; i < boxes.size(); ++i)
+			keys[i] = sortKey(boxes[i].minCoords[axis]);
+		order = detail::sortByKey(keys);
+	}
+
+	bool SweepAndPrune::repairOrder(std::span<const AABB> boxes)
+	{
+		// Insertion sort of the previous order by the new minimums
+		const size_t maxMoves = MAX_REPAIR_MOVES * order.size();
+		size_t moves = 0;
+		for (size_t i = 1; i < order.size(); ++i)
+		{
+			const std::uint32_t index = order[i];
+			const float key = boxes[index].minCoords[axis];
+			size_t position = i;
+			while (position > 0 && boxes[order[position - 1]].minCoords[axis] > key)
+			{
+				order[position] = order[position - 1];
+				--position;
+				if (++moves > maxMoves)
+				{
+					order[position] = index;
+					return false;
+				}
+			}
+			order[position] = index;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "primitives.h"
+
+namespace geom {
+
+	/*Sweep and prune broadphase: finds every pair of overlapping boxes of a set.
+	  The boxes are sorted by their minimum along the axis their centers vary the most, then each box
+	  only has to be compared with the boxes that start before it ends on that axis.
+	  The sorted order is kept between updates. While the number of boxes and the sweep axis stay the
+	  same it is repaired by insertion sort, which is close to linear for boxes that moved a little,
+	  otherwise the boxes are radix sorted from scratch.*/
+	class SweepAndPrune
+	{
+	public:
+		using Pair = ::std::pair<::std::uint32_t, ::std::uint32_t>;
+
+		/*Finds the overlapping pairs of the boxes, indices into 'boxes' with the smaller one first.
+		  The sweep is split between 'threadCount' workers (mpn::defaultThreadCount() if zero), each collecting
+		  its pairs separately. The pairs are in no particular order.*/
+		void update(::std::span<const AABB> boxes, int threadCount = 0);
+
+		const ::std::vector<Pair>& getPairs() const noexcept { return pairs; }
+		/*Sweep axis of the last update.*/
+		int getAxis() const noexcept { return axis; }
+
+	private:
+		void sortFromScratch(::std::span<const AABB> boxes);
+		bool repairOrder(::std::span<const AABB> boxes);
+
+		int axis = -1;
+		::std::vector<::std::uint32_t> order;	// box indices by minimum along the axis
+		::std::vector<AABB> sorted;				// the boxes in that order
+		::std::vector<::std::vector<Pair>> threadPairs;
+		::std::vector<Pair> pairs;
+	};
+}
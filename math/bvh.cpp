@@ -0,0 +1,481 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <numeric>
+#include <stdexcept>
+
+namespace geom {
+
+	namespace {
+
+		constexpr int BIN_COUNT = 16;
+
+		// Leaves never hold more than this many times the requested leaf size
+		constexpr std::uint32_t MAX_LEAF_FACTOR = 4;
+
+		// Splitting with the object median below this depth keeps the tree within BVH::MAX_DEPTH
+		constexpr int MEDIAN_SPLIT_DEPTH = BVH::MAX_DEPTH - 33;
+
+		struct Bounds
+		{
+			::mpn::Point3 minCoords{ FLT_MAX, FLT_MAX, FLT_MAX };
+			::mpn::Point3 maxCoords{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+			void grow(const ::mpn::Point3& point)
+			{
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					minCoords[axis] = std::min(minCoords[axis], point[axis]);
+					maxCoords[axis] = std::max(maxCoords[axis], point[axis]);
+				}
+			}
+
+			void grow(const AABB& box)
+			{
+				grow(box.minCoords);
+				grow(box.maxCoords);
+			}
+
+			// Empty bounds leave the box unchanged
+			void grow(const Bounds& other)
+			{
+				if (other.minCoords[0] <= other.maxCoords[0])
+				{
+					grow(other.minCoords);
+					grow(other.maxCoords);
+				}
+			}
+
+			float halfArea() const
+			{
+				if (minCoords[0] > maxCoords[0])
+					return 0.0f;
+				const ::mpn::Vector3 d = maxCoords - minCoords;
+				return d[0] * d[1] + d[1] * d[2] + d[2] * d[0];
+			}
+		};
+
+		struct Split
+		{
+			float cost = FLT_MAX;
+			int axis = 0;
+			int plane = -1;
+			float position = 0.0f;
+			Bounds left, right;
+		};
+
+		int widestAxis(const Bounds& bounds)
+		{
+			const ::mpn::Vector3 extent = bounds.maxCoords - bounds.minCoords;
+			int axis = extent[1] > extent[0] ? 1 : 0;
+			if (extent[2] > extent[axis]) axis = 2;
+			return axis;
+		}
+
+		// Whether keeping 'count' primitives in a leaf is cheaper than the split, if the leaf stays bounded
+		bool leafIsCheaper(float area, float splitCost, std::uint32_t count, std::uint32_t maxLeafSize)
+		{
+			// Traversal step is assumed to cost as much as one primitive test
+			return area + splitCost >= area * count && count <= MAX_LEAF_FACTOR * maxLeafSize;
+		}
+
+		int objectBin(float center, int axis, const Bounds& centerBounds)
+		{
+			const float scale = BIN_COUNT / (centerBounds.maxCoords[axis] - centerBounds.minCoords[axis]);
+			const int bin = static_cast<int>((center - centerBounds.minCoords[axis]) * scale);
+			return std::min(bin, BIN_COUNT - 1);
+		}
+
+		/*Chooses the cheapest plane between the bins: a plane has every reference entering a bin left of it
+		  on its left side and every reference leaving a bin right of it on its right side.
+		  Planes leaving more than 'maxReferences' references on the two sides together are skipped.*/
+		void sweep(const Bounds* binBounds, const std::uint32_t* entries, const std::uint32_t* exits, size_t maxReferences, Split& best)
+		{
+			Bounds rightBounds[BIN_COUNT];
+			std::uint32_t rightCounts[BIN_COUNT];
+			Bounds accumulated;
+			std::uint32_t accumulatedCount = 0;
+			for (int bin = BIN_COUNT - 1; bin > 0; --bin)
+			{
+				accumulated.grow(binBounds[bin]);
+				accumulatedCount += exits[bin];
+				rightBounds[bin] = accumulated;
+				rightCounts[bin] = accumulatedCount;
+			}
+
+			accumulated = Bounds();
+			accumulatedCount = 0;
+			for (int plane = 1; plane < BIN_COUNT; ++plane)
+			{
+				accumulated.grow(binBounds[plane - 1]);
+				accumulatedCount += entries[plane - 1];
+				if (accumulatedCount == 0 || rightCounts[plane] == 0 || accumulatedCount + rightCounts[plane] > maxReferences)
+					continue;
+				const float cost = accumulated.halfArea() * accumulatedCount + rightBounds[plane].halfArea() * rightCounts[plane];
+				if (cost < best.cost)
+				{
+					best.cost = cost;
+					best.plane = plane;
+					best.left = accumulated;
+					best.right = rightBounds[plane];
+				}
+			}
+		}
+
+		/*Cheapest binned SAH plane on the axis between 'count' primitives with the given centers and bounds.
+		  The split has no plane if none separates them.
+		 - center: float(size_t i), center of the primitive along the axis.
+		 - bounds: const AABB&(size_t i), bounds of the primitive.*/
+		template<typename Center, typename PrimitiveBounds>
+		Split findObjectSplit(size_t count, int axis, const Bounds& centerBounds, Center&& center, PrimitiveBounds&& bounds)
+		{
+			Split best;
+			best.axis = axis;
+			if (!(centerBounds.maxCoords[axis] - centerBounds.minCoords[axis] > 0.0f))
+				return best;
+
+			Bounds binBounds[BIN_COUNT];
+			std::uint32_t binCounts[BIN_COUNT] = {};
+			for (size_t i = 0; i < count; ++i)
+			{
+				const int bin = objectBin(center(i), axis, centerBounds);
+				++binCounts[bin];
+				binBounds[bin].grow(bounds(i));
+			}
+			sweep(binBounds, binCounts, binCounts, count, best);
+			return best;
+		}
+
+		struct Builder
+		{
+			const std::vector<AABB>& primitiveBounds;
+			std::vector<::mpn::Point3> centers;
+			std::vector<std::uint32_t>& order;
+			std::vector<BVHNode> nodes;
+			const std::uint32_t maxLeafSize;
+
+			void build(std::uint32_t nodeIndex, std::uint32_t begin, std::uint32_t end, int depth)
+			{
+				Bounds bounds, centerBounds;
+				for (std::uint32_t i = begin; i < end; ++i)
+				{
+					bounds.grow(primitiveBounds[order[i]]);
+					centerBounds.grow(centers[order[i]]);
+				}
+				nodes[nodeIndex].bounds = AABB(bounds.minCoords, bounds.maxCoords);
+
+				const std::uint32_t count = end - begin;
+				const int axis = widestAxis(centerBounds);
+				const float extent = centerBounds.maxCoords[axis] - centerBounds.minCoords[axis];
+				if (count <= maxLeafSize || (extent <= 0.0f && count <= MAX_LEAF_FACTOR * maxLeafSize))
+				{
+					makeLeaf(nodeIndex, begin, count);
+					return;
+				}
+
+				// Without a separating plane, or too deep for one, the range is split at the median
+				std::uint32_t middle = depth < MEDIAN_SPLIT_DEPTH && extent > 0.0f
+					? splitSAH(begin, end, axis, centerBounds, bounds.halfArea())
+					: begin;
+				if (middle == end)
+				{
+					makeLeaf(nodeIndex, begin, count);
+					return;
+				}
+				if (middle == begin)
+				{
+					middle = begin + count / 2;
+					std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end,
+						[this, axis](std::uint32_t a, std::uint32_t b) { return centers[a][axis] < centers[b][axis]; });
+				}
+
+				const std::uint32_t first = static_cast<std::uint32_t>(nodes.size());
+				nodes.emplace_back();
+				build(first, begin, middle, depth + 1);
+				const std::uint32_t second = static_cast<std::uint32_t>(nodes.size());
+				nodes.emplace_back();
+				build(second, middle, end, depth + 1);
+				nodes[nodeIndex].offset = second;
+				nodes[nodeIndex].count = 0;
+			}
+
+			void makeLeaf(std::uint32_t nodeIndex, std::uint32_t begin, std::uint32_t count)
+			{
+				nodes[nodeIndex].offset = begin;
+				nodes[nodeIndex].count = count;
+			}
+
+			/*Partitions the range by the cheapest binned SAH plane on the axis.
+			  Returns 'end' if keeping the range as a leaf is cheaper, 'begin' if no plane separates it.*/
+			std::uint32_t splitSAH(std::uint32_t begin, std::uint32_t end, int axis, const Bounds& centerBounds, float parentArea)
+			{
+				const Split split = findObjectSplit(end - begin, axis, centerBounds,
+					[&](size_t i) { return centers[order[begin + i]][axis]; },
+					[&](size_t i) -> const AABB& { return primitiveBounds[order[begin + i]]; });
+				if (split.plane < 0)
+					return begin;
+				if (leafIsCheaper(parentArea, split.cost, end - begin, maxLeafSize))
+					return end;
+
+				const auto middle = std::partition(order.begin() + begin, order.begin() + end,
+					[&](std::uint32_t primitive) { return objectBin(centers[primitive][axis], axis, centerBounds) < split.plane; });
+				return static_cast<std::uint32_t>(middle - order.begin());
+			}
+		};
+
+		// Spatial splits are only tried where the object split children overlap by this fraction of the root area
+		constexpr float SPATIAL_SPLIT_OVERLAP = 1e-5f;
+
+		struct Reference
+		{
+			AABB bounds;
+			std::uint32_t triangle;
+		};
+
+		Bounds intersection(const Bounds& a, const Bounds& b)
+		{
+			Bounds result;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				result.minCoords[axis] = std::max(a.minCoords[axis], b.minCoords[axis]);
+				result.maxCoords[axis] = std::min(a.maxCoords[axis], b.maxCoords[axis]);
+				if (result.minCoords[axis] > result.maxCoords[axis])
+					return Bounds();
+			}
+			return result;
+		}
+
+		/*Builds the hierarchy from lists of triangle references, which unlike primitive indices
+		  may be duplicated by spatial splits, so every node gets its own list.*/
+		struct SpatialBuilder
+		{
+			std::span<const Triangle> triangles;
+			std::vector<std::uint32_t>& order;
+			std::vector<BVHNode> nodes;
+			const std::uint32_t maxLeafSize;
+			size_t remainingReferences;
+			float minOverlap = 0.0f;
+
+			void build(std::uint32_t nodeIndex, std::vector<Reference> references, int depth)
+			{
+				Bounds bounds, centerBounds;
+				for (const Reference& reference : references)
+				{
+					bounds.grow(reference.bounds);
+					centerBounds.grow(reference.bounds.getCenter());
+				}
+				nodes[nodeIndex].bounds = AABB(bounds.minCoords, bounds.maxCoords);
+
+				const std::uint32_t count = static_cast<std::uint32_t>(references.size());
+				if (count <= maxLeafSize)
+				{
+					makeLeaf(nodeIndex, references);
+					return;
+				}
+
+				Split object;
+				if (depth < MEDIAN_SPLIT_DEPTH)
+				{
+					const int axis = widestAxis(centerBounds);
+					object = findObjectSplit(references.size(), axis, centerBounds,
+						[&](size_t i) { return references[i].bounds.getCenter()[axis]; },
+						[&](size_t i) -> const AABB& { return references[i].bounds; });
+				}
+				Split spatial;
+				if (depth < MEDIAN_SPLIT_DEPTH && remainingReferences > 0 && intersection(object.left, object.right).halfArea() > minOverlap)
+					spatial = findSpatialSplit(references, bounds);
+
+				if (leafIsCheaper(bounds.halfArea(), std::min(object.cost, spatial.cost), count, maxLeafSize))
+				{
+					makeLeaf(nodeIndex, references);
+					return;
+				}
+
+				std::vector<Reference> left, right;
+				if (spatial.cost < object.cost)
+					splitSpatially(references, spatial, left, right);
+				if (left.empty() || right.empty())
+				{
+					left.clear();
+					right.clear();
+					if (object.plane >= 0)
+						splitObjects(references, object, centerBounds, left, right);
+					else
+						splitMedian(references, centerBounds, left, right);
+				}
+				references = std::vector<Reference>();
+
+				const std::uint32_t first = static_cast<std::uint32_t>(nodes.size());
+				nodes.emplace_back();
+				build(first, std::move(left), depth + 1);
+				const std::uint32_t second = static_cast<std::uint32_t>(nodes.size());
+				nodes.emplace_back();
+				build(second, std::move(right), depth + 1);
+				nodes[nodeIndex].offset = second;
+				nodes[nodeIndex].count = 0;
+			}
+
+			void makeLeaf(std::uint32_t nodeIndex, const std::vector<Reference>& references)
+			{
+				nodes[nodeIndex].offset = static_cast<std::uint32_t>(order.size());
+				nodes[nodeIndex].count = static_cast<std::uint32_t>(references.size());
+				for (const Reference& reference : references)
+					order.push_back(reference.triangle);
+			}
+
+			// Bins of equal width over the node bounds, references are clipped into every bin they span
+			Split findSpatialSplit(const std::vector<Reference>& references, const Bounds& bounds)
+			{
+				Split best;
+				const int axis = best.axis = widestAxis(bounds);
+				const float extent = bounds.maxCoords[axis] - bounds.minCoords[axis];
+				if (!(extent > 0.0f))
+					return best;
+
+				const float binWidth = extent / BIN_COUNT;
+				auto binOf = [&](float value) { return std::clamp(static_cast<int>((value - bounds.minCoords[axis]) / binWidth), 0, BIN_COUNT - 1); };
+				Bounds binBounds[BIN_COUNT];
+				std::uint32_t entries[BIN_COUNT] = {}, exits[BIN_COUNT] = {};
+				for (const Reference& reference : references)
+				{
+					const int firstBin = binOf(reference.bounds.minCoords[axis]);
+					const int lastBin = binOf(reference.bounds.maxCoords[axis]);
+					++entries[firstBin];
+					++exits[lastBin];
+					if (firstBin == lastBin)
+					{
+						binBounds[firstBin].grow(reference.bounds);
+						continue;
+					}
+					for (int bin = firstBin; bin <= lastBin; ++bin)
+					{
+						AABB slab = reference.bounds;
+						slab.minCoords[axis] = std::max(slab.minCoords[axis], bounds.minCoords[axis] + bin * binWidth);
+						slab.maxCoords[axis] = std::min(slab.maxCoords[axis], bounds.minCoords[axis] + (bin + 1) * binWidth);
+						AABB clipped;
+						if (slab.minCoords[axis] <= slab.maxCoords[axis] && clipTriangle(triangles[reference.triangle], slab, clipped))
+							binBounds[bin].grow(clipped);
+					}
+				}
+				sweep(binBounds, entries, exits, references.size() + remainingReferences, best);
+				best.position = bounds.minCoords[axis] + best.plane * binWidth;
+				return best;
+			}
+
+			void splitSpatially(const std::vector<Reference>& references, const Split& split, std::vector<Reference>& left, std::vector<Reference>& right)
+			{
+				const int axis = split.axis;
+				for (const Reference& reference : references)
+				{
+					if (reference.bounds.maxCoords[axis] <= split.position)
+						left.push_back(reference);
+					else if (reference.bounds.minCoords[axis] >= split.position)
+						right.push_back(reference);
+					else
+					{
+						// Straddling: a part on each side, unless clipping finds one of them empty after all
+						AABB leftSlab = reference.bounds, rightSlab = reference.bounds, clipped;
+						leftSlab.maxCoords[axis] = split.position;
+						rightSlab.minCoords[axis] = split.position;
+						const size_t before = left.size() + right.size();
+						if (clipTriangle(triangles[reference.triangle], leftSlab, clipped))
+							left.push_back(Reference{ clipped, reference.triangle });
+						if (clipTriangle(triangles[reference.triangle], rightSlab, clipped))
+							right.push_back(Reference{ clipped, reference.triangle });
+						if (left.size() + right.size() == before)
+							left.push_back(reference);
+					}
+				}
+
+				// Over budget: fall back to an object split
+				const size_t added = left.size() + right.size() - references.size();
+				if (added > remainingReferences)
+				{
+					left.clear();
+					right.clear();
+					return;
+				}
+				remainingReferences -= added;
+			}
+
+			void splitObjects(const std::vector<Reference>& references, const Split& split, const Bounds& centerBounds, std::vector<Reference>& left, std::vector<Reference>& right)
+			{
+				for (const Reference& reference : references)
+				{
+					if (objectBin(reference.bounds.getCenter()[split.axis], split.axis, centerBounds) < split.plane)
+						left.push_back(reference);
+					else
+						right.push_back(reference);
+				}
+			}
+
+			// Coincident centers cannot be separated by a plane, they are halved arbitrarily to keep leaves bounded
+			void splitMedian(std::vector<Reference>& references, const Bounds& centerBounds, std::vector<Reference>& left, std::vector<Reference>& right)
+			{
+				const int axis = widestAxis(centerBounds);
+				const auto middle = references.begin() + references.size() / 2;
+				std::nth_element(references.begin(), middle, references.end(),
+					[axis](const Reference& a, const Reference& b) { return a.bounds.getCenter()[axis] < b.bounds.getCenter()[axis]; });
+				left.assign(references.begin(), middle);
+				right.assign(middle, references.end());
+			}
+		};
+	}
+
+	BVH::BVH(const std::vector<AABB>& primitiveBounds, std::vector<std::uint32_t>& order, int maxLeafSize)
+	{
+		if (maxLeafSize < 1)
+			throw std::invalid_argument("Leaves must be able to hold at least one primitive");
+
+		order.resize(primitiveBounds.size());
+		std::iota(order.begin(), order.end(), 0u);
+		if (primitiveBounds.empty())
+			return;
+
+		Builder builder{ primitiveBounds, {}, order, {}, static_cast<std::uint32_t>(maxLeafSize) };
+		builder.centers.reserve(primitiveBounds.size());
+		for (const AABB& box : primitiveBounds)
+			builder.centers.push_back(box.getCenter());
+
+		builder.nodes.reserve(2 * primitiveBounds.size() / maxLeafSize + 1);
+		builder.nodes.emplace_back();
+		builder.build(0, 0, static_cast<std::uint32_t>(primitiveBounds.size()), 0);
+
+		auto built = std::make_shared<const std::vector<BVHNode>>(std::move(builder.nodes));
+		nodes = *built;
+		storage = std::move(built);
+	}
+
+	BVH::BVH(std::span<const Triangle> triangles, std::vector<std::uint32_t>& order, int maxLeafSize, float maxGrowth)
+	{
+		if (maxLeafSize < 1)
+			throw std::invalid_argument("Leaves must be able to hold at least one primitive");
+		if (!(maxGrowth >= 0.0f))
+			throw std::invalid_argument("The reference growth must not be negative");
+
+		order.clear();
+		if (triangles.empty())
+			return;
+
+		std::vector<Reference> references;
+		references.reserve(triangles.size());
+		Bounds rootBounds;
+		for (std::uint32_t i = 0; i < triangles.size(); ++i)
+		{
+			references.push_back(Reference{ createAABB(triangles[i]), i });
+			rootBounds.grow(references.back().bounds);
+		}
+
+		SpatialBuilder builder{ triangles, order, {}, static_cast<std::uint32_t>(maxLeafSize), static_cast<size_t>(maxGrowth * triangles.size()) };
+		builder.minOverlap = SPATIAL_SPLIT_OVERLAP * rootBounds.halfArea();
+		order.reserve(triangles.size() + builder.remainingReferences);
+		builder.nodes.reserve(2 * order.capacity() / maxLeafSize + 1);
+		builder.nodes.emplace_back();
+		builder.build(0, std::move(references), 0);
+
+		auto built = std::make_shared<const std::vector<BVHNode>>(std::move(builder.nodes));
+		nodes = *built;
+		storage = std::move(built);
+	}
+}
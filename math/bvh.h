@@ -0,0 +1,222 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "counters.h"
+#include "math.h"
+#include "primitives.h"
+
+namespace geom {
+
+	/*Node of a binary bounding volume hierarchy.
+	  The first child of an inner node is stored right after it, 'offset' points to the second one.
+	  For leaves 'offset' is the index of the first primitive and 'count' is the number of primitives.*/
+	struct BVHNode
+	{
+		AABB bounds;
+		::std::uint32_t offset = 0;
+		::std::uint32_t count = 0;
+
+		constexpr bool isLeaf() const noexcept { return count != 0; }
+	};
+
+	static_assert(sizeof(BVHNode) == 32, "BVHNode should fill half a cache line");
+
+	/*Binary bounding volume hierarchy built with the binned surface area heuristic.
+	  The hierarchy only stores nodes, the primitives are owned by the caller.
+	  Building returns the order in which the caller has to rearrange its primitives,
+	  so leaves can address them as contiguous ranges without any indirection.
+	  The nodes are immutable once built, copies share them.*/
+	class BVH
+	{
+	public:
+		static constexpr int MAX_DEPTH = 64;
+
+		BVH() = default;
+
+		/*Builds the hierarchy.
+		 - primitiveBounds: bounding box of each primitive.
+		 - order: receives the permutation of the primitives, the primitive stored at position i after
+		   rearranging is primitiveBounds[order[i]].
+		 - maxLeafSize: leaves are not split below this many primitives. Leaves are allowed to grow up to four
+		   times as large if the surface area heuristic finds splitting them too expensive.*/
+		BVH(const ::std::vector<AABB>& primitiveBounds, ::std::vector<::std::uint32_t>& order, int maxLeafSize = 4);
+
+		/*Builds a spatial split hierarchy (SBVH) over triangles. Where the boxes of the two sides of the best
+		  object split overlap, splitting space at a plane is considered as well: triangles crossing the plane
+		  are referenced from both sides, each with the bounds of its part clipped to that side.
+		 - order: receives the triangle of each reference, rearranged the same way as above. A triangle split
+		   across leaves appears once for each of them.
+		 - maxGrowth: references allowed on top of one per triangle, as a fraction of the triangle count.
+		 Throws std::invalid_argument if the growth is negative.*/
+		BVH(::std::span<const Triangle> triangles, ::std::vector<::std::uint32_t>& order, int maxLeafSize, float maxGrowth);
+
+		/*Creates a view of prebuilt nodes, e.g. from a file mapping.
+		 - storage: keeps the memory of the nodes alive.*/
+		BVH(::std::span<const BVHNode> nodes, ::std::shared_ptr<const void> storage) noexcept
+			: storage(::std::move(storage)), nodes(nodes) {}
+
+		/*Finds the closest hit along the line.
+		 - intersectPrimitive: float(std::uint32_t primitiveIndex, const Line& line), returns the hit distance
+		   or a negative value on a miss.
+		 Returns the distance of the closest hit or INVALID_DISTANCE. The index of the primitive hit is
+		 written to 'hitPrimitive' if it is not null.*/
+		template<typename IntersectPrimitive>
+		float intersect(const Line& line, IntersectPrimitive&& intersectPrimitive, ::std::uint32_t* hitPrimitive = nullptr) const;
+
+		/*Occlusion query, stops at the first hit found in [0, maxDistance].
+		 - occludesPrimitive: bool(std::uint32_t primitiveIndex, const Line& line, float maxDistance).*/
+		template<typename OccludesPrimitive>
+		bool occludes(const Line& line, float maxDistance, OccludesPrimitive&& occludesPrimitive) const;
+
+		bool empty() const noexcept { return nodes.empty(); }
+		const AABB& getBounds() const { return nodes.front().bounds; }
+		::std::span<const BVHNode> getNodes() const noexcept { return nodes; }
+
+	private:
+		::std::shared_ptr<const void> storage;
+		::std::span<const BVHNode> nodes;
+	};
+
+	/*Closest hit traversal shared by the hierarchy layouts.
+	 - nodes: node array with the layout of BVHNode (offset, count and isLeaf()), the first one is the root.
+	 - entryDistance: float(const Node& node), entry distance of the line into the node bounds or a negative value on a miss.
+	 - intersectPrimitive: float(std::uint32_t primitiveIndex), hit distance or a negative value on a miss.
+	 Returns the distance of the closest hit or INVALID_DISTANCE.*/
+	template<typename Node, typename EntryDistance, typename IntersectPrimitive>
+	float traverseClosestHit(const Node* nodes, EntryDistance&& entryDistance, IntersectPrimitive&& intersectPrimitive, ::std::uint32_t* hitPrimitive)
+	{
+		float closest = INVALID_DISTANCE;
+		if (entryDistance(nodes[0]) < 0.0f)
+			return closest;
+
+		// Children are visited front to back, a subtree is skipped if it starts behind the closest hit
+		::std::uint32_t stack[BVH::MAX_DEPTH];
+		float stackDistance[BVH::MAX_DEPTH];
+		int stackSize = 0;
+		::mpn::TraversalDepth<> depth;
+		::std::uint32_t nodeIndex = 0;
+		while (true)
+		{
+			const Node& node = nodes[nodeIndex];
+			if (node.isLeaf())
+			{
+				for (::std::uint32_t i = node.offset; i < node.offset + node.count; ++i)
+				{
+					const float distance = intersectPrimitive(i);
+					if (distance >= 0.0f && (closest < 0.0f || distance < closest))
+					{
+						closest = distance;
+						if (hitPrimitive != nullptr)
+							*hitPrimitive = i;
+					}
+				}
+			}
+			else
+			{
+				::std::uint32_t first = nodeIndex + 1;
+				::std::uint32_t second = node.offset;
+				float firstDistance = entryDistance(nodes[first]);
+				float secondDistance = entryDistance(nodes[second]);
+				if (closest >= 0.0f)
+				{
+					if (firstDistance > closest) firstDistance = INVALID_DISTANCE;
+					if (secondDistance > closest) secondDistance = INVALID_DISTANCE;
+				}
+				if (firstDistance >= 0.0f && secondDistance >= 0.0f)
+				{
+					if (secondDistance < firstDistance)
+						::std::swap(first, second);
+					depth.descend();
+					depth.push(stackSize);
+					stack[stackSize] = second;
+					stackDistance[stackSize++] = ::std::max(firstDistance, secondDistance);
+					nodeIndex = first;
+					continue;
+				}
+				if (firstDistance >= 0.0f) { depth.descend(); nodeIndex = first; continue; }
+				if (secondDistance >= 0.0f) { depth.descend(); nodeIndex = second; continue; }
+			}
+
+			do
+			{
+				if (stackSize == 0)
+					return closest;
+				--stackSize;
+			} while (closest >= 0.0f && stackDistance[stackSize] > closest);
+			depth.pop(stackSize);
+			nodeIndex = stack[stackSize];
+		}
+	}
+
+	/*Any hit traversal shared by the hierarchy layouts.
+	 - nodes: node array with the layout of BVHNode, the first one is the root.
+	 - intersectsNode: bool(const Node& node), whether the node bounds are hit within the query range.
+	 - occludesPrimitive: bool(std::uint32_t primitiveIndex), whether the primitive is hit within the query range.
+	 Children are visited in storage order, no distances are tracked.*/
+	template<typename Node, typename IntersectsNode, typename OccludesPrimitive>
+	bool traverseAnyHit(const Node* nodes, IntersectsNode&& intersectsNode, OccludesPrimitive&& occludesPrimitive)
+	{
+		if (!intersectsNode(nodes[0]))
+			return false;
+
+		::std::uint32_t stack[BVH::MAX_DEPTH];
+		int stackSize = 0;
+		::mpn::TraversalDepth<> depth;
+		::std::uint32_t nodeIndex = 0;
+		while (true)
+		{
+			const Node& node = nodes[nodeIndex];
+			if (node.isLeaf())
+			{
+				for (::std::uint32_t i = node.offset; i < node.offset + node.count; ++i)
+					if (occludesPrimitive(i))
+						return true;
+			}
+			else
+			{
+				const bool first = intersectsNode(nodes[nodeIndex + 1]);
+				const bool second = intersectsNode(nodes[node.offset]);
+				if (first || second)
+					depth.descend();
+				if (first && second)
+				{
+					depth.push(stackSize);
+					stack[stackSize++] = node.offset;
+				}
+				if (first) { ++nodeIndex; continue; }
+				if (second) { nodeIndex = node.offset; continue; }
+			}
+
+			if (stackSize == 0)
+				return false;
+			depth.pop(--stackSize);
+			nodeIndex = stack[stackSize];
+		}
+	}
+
+	template<typename IntersectPrimitive>
+	float BVH::intersect(const Line& line, IntersectPrimitive&& intersectPrimitive, ::std::uint32_t* hitPrimitive) const
+	{
+		if (nodes.empty())
+			return INVALID_DISTANCE;
+		return traverseClosestHit(nodes.data(),
+			[&line](const BVHNode& node) { return node.bounds.entryDistance(line); },
+			[&](::std::uint32_t index) { return intersectPrimitive(index, line); },
+			hitPrimitive);
+	}
+
+	template<typename OccludesPrimitive>
+	bool BVH::occludes(const Line& line, float maxDistance, OccludesPrimitive&& occludesPrimitive) const
+	{
+		if (nodes.empty())
+			return false;
+		return traverseAnyHit(nodes.data(),
+			[&line, maxDistance](const BVHNode& node) { return node.bounds.occludes(line, maxDistance); },
+			[&](::std::uint32_t index) { return occludesPrimitive(index, line, maxDistance); });
+	}
+}
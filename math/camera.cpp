@@ -0,0 +1,122 @@
+#include "camera.h"
+
+#include <cmath>
+#include <stdexcept>
+
+#include "math.h"
+#include "random.h"
+
+namespace geom {
+
+	void LineBuffer::resize(size_t size)
+	{
+		originX.resize(size);
+		originY.resize(size);
+		originZ.resize(size);
+		directionX.resize(size);
+		directionY.resize(size);
+		directionZ.resize(size);
+	}
+
+	Line LineBuffer::line(size_t index) const noexcept
+	{
+		return Line(::mpn::Point3(originX[index], originY[index], originZ[index]),
+			::mpn::Vector3(directionX[index], directionY[index], directionZ[index]));
+	}
+
+	Camera::Camera(const ::mpn::Matrix4& viewProjection, const ::mpn::Matrix4& inverseViewProjection, int width, int height)
+		: viewProjection(viewProjection), inverseViewProjection(inverseViewProjection), width(width), height(height)
+	{
+		if (width <= 0 || height <= 0)
+			throw std::invalid_argument("The image must not be empty");
+
+		// Row vector of device (x, y, z, 1) times the inverse is x*row0 + y*row1 + z*row2 + row3
+		Vector4 rows[4];
+		for (int row = 0; row < 4; ++row)
+			for (int column = 0; column < 4; ++column)
+				rows[row][column] = inverseViewProjection(row, column);
+
+		stepX = rows[0] * (2.0f / float(width));
+		stepY = rows[1] * (2.0f / float(height));
+		const Vector4 corner = rows[3] - rows[0] - rows[1];
+		nearOrigin = corner - rows[2];
+		farOrigin = corner + rows[2];
+
+		const ::mpn::Point3 center = ::mpn::Point3(0.0f, 0.0f, -1.0f) * inverseViewProjection;
+		lensX = (::mpn::Point3(1.0f, 0.0f, -1.0f) * inverseViewProjection - center).asUnitVector();
+		lensY = (::mpn::Point3(0.0f, 1.0f, -1.0f) * inverseViewProjection - center).asUnitVector();
+	}
+
+	void Camera::setThinLens(float lensRadius, float focusDistance)
+	{
+		if (lensRadius > 0.0f && focusDistance <= 0.0f)
+			throw std::invalid_argument("The focus distance must be positive");
+		this->lensRadius = lensRadius;
+		this->focusDistance = focusDistance;
+	}
+
+	Line Camera::generateLine(float x, float y) const noexcept
+	{
+		const float deviceX = 2.0f * x / float(width) - 1.0f;
+		const float deviceY = 2.0f * y / float(height) - 1.0f;
+		const ::mpn::Point3 nearPoint = ::mpn::Point3(deviceX, deviceY, -1.0f) * inverseViewProjection;
+		const ::mpn::Point3 farPoint = ::mpn::Point3(deviceX, deviceY, 1.0f) * inverseViewProjection;
+		Line line(nearPoint, farPoint - nearPoint);
+		if (lensRadius > 0.0f)
+			line = applyLens(line);
+		return line;
+	}
+
+	void Camera::generateTile(int x0, int y0, int tileWidth, int tileHeight, LineBuffer& lines, bool jitter) const
+	{
+		lines.resize(size_t(tileWidth) * size_t(tileHeight));
+		size_t index = 0;
+		for (int y = 0; y < tileHeight; ++y)
+		{
+			const Vector4 rowOffset = stepX * (float(x0) + 0.5f) + stepY * (float(y0 + y) + 0.5f);
+			Vector4 nearPoint = nearOrigin + rowOffset;
+			Vector4 farPoint = farOrigin + rowOffset;
+			for (int x = 0; x < tileWidth; ++x, ++index)
+			{
+				if (jitter)
+				{
+					const Vector4 offset = stepX * (::mpn::frand() - 0.5f) + stepY * (::mpn::frand() - 0.5f);
+					writeLine(nearPoint + offset, farPoint + offset, lines, index);
+				}
+				else
+				{
+					writeLine(nearPoint, farPoint, lines, index);
+				}
+				nearPoint = nearPoint + stepX;
+				farPoint = farPoint + stepX;
+			}
+		}
+	}
+
+	void Camera::writeLine(const Vector4& nearPoint, const Vector4& farPoint, LineBuffer& lines, size_t index) const
+	{
+		const float nearScale = 1.0f / nearPoint[3];
+		const float farScale = 1.0f / farPoint[3];
+		const ::mpn::Point3 origin(nearPoint[0] * nearScale, nearPoint[1] * nearScale, nearPoint[2] * nearScale);
+		const ::mpn::Vector3 direction(
+			farPoint[0] * farScale - origin[0],
+			farPoint[1] * farScale - origin[1],
+			farPoint[2] * farScale - origin[2]);
+		const Line line = lensRadius > 0.0f ? applyLens(Line(origin, direction)) : Line(origin, direction);
+		lines.originX[index] = line.P[0];
+		lines.originY[index] = line.P[1];
+		lines.originZ[index] = line.P[2];
+		lines.directionX[index] = line.v[0];
+		lines.directionY[index] = line.v[1];
+		lines.directionZ[index] = line.v[2];
+	}
+
+	Line Camera::applyLens(const Line& line) const noexcept
+	{
+		// Uniform sample of the lens disk; the shifted line still passes the focus point at the same parameter
+		const float radius = lensRadius * std::sqrt(::mpn::frand());
+		const float angle = 2.0f * PI * ::mpn::frand();
+		const ::mpn::Vector3 offset = lensX * (radius * std::cos(angle)) + lensY * (radius * std::sin(angle));
+		return Line(line.P + offset, line.v - offset * (1.0f / focusDistance));
+	}
+}
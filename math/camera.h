@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "matrix.h"
+#include "primitives.h"
+#include "vector.h"
+
+namespace geom {
+
+	/*Lines stored as structure of arrays, one array per coordinate, so they can be consumed
+	  by wide kernels without gathering.*/
+	struct LineBuffer
+	{
+		::std::vector<float> originX, originY, originZ;
+		::std::vector<float> directionX, directionY, directionZ;
+
+		void resize(size_t size);
+		size_t size() const noexcept { return originX.size(); }
+		Line line(size_t index) const noexcept;
+	};
+
+	/*Generates primary lines through the pixels of an image from a view-projection matrix.
+	  Matrices are applied to row vectors (point * matrix), device coordinates follow OpenGL:
+	  the visible volume is [-1,1] on every axis, with the near plane at z=-1. Pixel coordinates
+	  map to device coordinates the same way as coords2device(), so row 0 is at device y=-1.
+	  Lines start on the near plane and end on the far plane at distance 1.*/
+	class Camera
+	{
+	public:
+		/*Throws std::invalid_argument if the image is empty.*/
+		Camera(const ::mpn::Matrix4& viewProjection, const ::mpn::Matrix4& inverseViewProjection, int width, int height);
+
+		/*Turns the pinhole into a thin lens of the given world space radius, spanned by the device x and y axes
+		  on the near plane and focused at 'focusDistance' (in line parameter units, 1 being the far plane).
+		  Lens positions are sampled with mpn::frand(). A radius of 0 restores the pinhole.
+		  Throws std::invalid_argument if the lens has a radius but no positive focus distance.*/
+		void setThinLens(float lensRadius, float focusDistance);
+
+		/*Line through the point (x, y) of the image, in pixels. Unprojects the two end points with full
+		  matrix products, generateTile() gives the same lines for a fraction of the cost.*/
+		Line generateLine(float x, float y) const noexcept;
+
+		/*Lines through the pixels of the tile [x0, x0 + tileWidth) x [y0, y0 + tileHeight), in row-major order.
+		  The tile is not clipped to the image. The homogeneous end points are linear in the pixel coordinates,
+		  so they are stepped incrementally and only divided per pixel.
+		 - jitter: sample a random position in each pixel instead of its center (uses mpn::frand()).*/
+		void generateTile(int x0, int y0, int tileWidth, int tileHeight, LineBuffer& lines, bool jitter = false) const;
+
+		int getWidth() const noexcept { return width; }
+		int getHeight() const noexcept { return height; }
+		const ::mpn::Matrix4& getViewProjection() const noexcept { return viewProjection; }
+		const ::mpn::Matrix4& getInverseViewProjection() const noexcept { return inverseViewProjection; }
+
+	private:
+		using Vector4 = ::mpn::Vector<4, float>;
+
+		Line applyLens(const Line& line) const noexcept;
+		void writeLine(const Vector4& nearPoint, const Vector4& farPoint, LineBuffer& lines, size_t index) const;
+
+		::mpn::Matrix4 viewProjection;
+		::mpn::Matrix4 inverseViewProjection;
+		int width;
+		int height;
+		float lensRadius = 0.0f;
+		float focusDistance = 1.0f;
+		// Homogeneous near and far plane points at device (0, 0), and their change per pixel
+		Vector4 nearOrigin, farOrigin;
+		Vector4 stepX, stepY;
+		// Lens axes in world space, per unit of lens radius
+		::mpn::Vector3 lensX, lensY;
+	};
+}
@@ -0,0 +1,115 @@
+#include "counters.h"
+
+#ifdef MPN_COUNTERS
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace mpn {
+
+	namespace {
+
+		// Only the owner thread writes its counters, so a relaxed load and store is enough
+		// and no read-modify-write is needed on the hot path.
+		struct ThreadCounters
+		{
+			std::atomic<std::uint64_t> counts[COUNTER_COUNT] = {};
+			std::atomic<std::uint64_t> traversalDepths[TRAVERSAL_DEPTH_BINS] = {};
+
+			ThreadCounters();
+			~ThreadCounters();
+
+			void addTo(CounterSnapshot& snapshot) const noexcept
+			{
+				for (int i = 0; i < COUNTER_COUNT; ++i)
+					snapshot.counts[i] += counts[i].load(std::memory_order_relaxed);
+				for (int i = 0; i < TRAVERSAL_DEPTH_BINS; ++i)
+					snapshot.traversalDepths[i] += traversalDepths[i].load(std::memory_order_relaxed);
+			}
+		};
+
+		struct Registry
+		{
+			std::mutex mutex;
+			std::vector<const ThreadCounters*> threads;
+			CounterSnapshot finished;	// counts of the threads that have exited
+			CounterSnapshot baseline;	// totals at the last reset
+		};
+
+		// Constructed on first use by a thread's counters, so it outlives all of them
+		Registry& registry()
+		{
+			static Registry instance;
+			return instance;
+		}
+
+		ThreadCounters::ThreadCounters()
+		{
+			Registry& r = registry();
+			std::lock_guard<std::mutex> lock(r.mutex);
+			r.threads.push_back(this);
+		}
+
+		ThreadCounters::~ThreadCounters()
+		{
+			Registry& r = registry();
+			std::lock_guard<std::mutex> lock(r.mutex);
+			addTo(r.finished);
+			r.threads.erase(std::find(r.threads.begin(), r.threads.end(), this));
+		}
+
+		ThreadCounters& localCounters()
+		{
+			thread_local ThreadCounters counters;
+			return counters;
+		}
+
+		void increment(std::atomic<std::uint64_t>& counter, std::uint64_t amount) noexcept
+		{
+			counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+		}
+
+		CounterSnapshot totals(const Registry& r)
+		{
+			CounterSnapshot result = r.finished;
+			for (const ThreadCounters* thread : r.threads)
+				thread->addTo(result);
+			return result;
+		}
+	}
+
+	namespace detail {
+
+		void addCount(Counter counter, std::uint64_t amount) noexcept
+		{
+			increment(localCounters().counts[static_cast<int>(counter)], amount);
+		}
+
+		void addTraversalDepth(int depth) noexcept
+		{
+			increment(localCounters().traversalDepths[std::min(depth, TRAVERSAL_DEPTH_BINS - 1)], 1);
+		}
+	}
+
+	CounterSnapshot snapshotCounters()
+	{
+		Registry& r = registry();
+		std::lock_guard<std::mutex> lock(r.mutex);
+		CounterSnapshot result = totals(r);
+		for (int i = 0; i < COUNTER_COUNT; ++i)
+			result.counts[i] -= r.baseline.counts[i];
+		for (int i = 0; i < TRAVERSAL_DEPTH_BINS; ++i)
+			result.traversalDepths[i] -= r.baseline.traversalDepths[i];
+		return result;
+	}
+
+	void resetCounters()
+	{
+		Registry& r = registry();
+		std::lock_guard<std::mutex> lock(r.mutex);
+		r.baseline = totals(r);
+	}
+}
+
+#endif
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+
+/*Hot path instrumentation. Define MPN_COUNTERS in the preprocessor definitions of every project
+  using the library to count work done inside it, as the Counters configuration of the library and
+  its tests does; without it counting compiles to nothing.
+  Each thread counts into its own counters, snapshotCounters() sums them up.*/
+
+namespace mpn {
+
+#ifdef MPN_COUNTERS
+	constexpr bool COUNTERS_ENABLED = true;
+#else
+	constexpr bool COUNTERS_ENABLED = false;
+#endif
+
+	enum class Counter
+	{
+		AABBTests,			// line-box slab tests of every layout (AABB, QuantizedAABB, wide nodes)
+		AABBHits,
+		TriangleTests,		// line-triangle tests of every representation
+		TriangleHits,
+		MatrixMultiplies,	// matrix-matrix products
+		TransformApplications,	// Transform::transform, inverseTransform and inverseTransformLine
+		RandomDraws,		// frand() and dice()
+		COUNT
+	};
+
+	constexpr int COUNTER_COUNT = static_cast<int>(Counter::COUNT);
+
+	/*Traversal depths above the last bin are counted in the last bin.*/
+	constexpr int TRAVERSAL_DEPTH_BINS = 65;
+
+	/*Sum of the counters of all threads, including finished ones, since the last resetCounters().*/
+	struct CounterSnapshot
+	{
+		::std::uint64_t counts[COUNTER_COUNT] = {};
+		/*Number of hierarchy queries (BVH, WideBVH and DynamicTree traversals, Frustum::cull) by the depth
+		  of the deepest node they visited, the root being at depth 0.*/
+		::std::uint64_t traversalDepths[TRAVERSAL_DEPTH_BINS] = {};
+
+		::std::uint64_t operator[](Counter counter) const noexcept { return counts[static_cast<int>(counter)]; }
+	};
+
+#ifdef MPN_COUNTERS
+	namespace detail {
+		void addCount(Counter counter, ::std::uint64_t amount) noexcept;
+		void addTraversalDepth(int depth) noexcept;
+	}
+
+	constexpr void count(Counter counter, ::std::uint64_t amount = 1) noexcept
+	{
+		if (!::std::is_constant_evaluated())
+			detail::addCount(counter, amount);
+	}
+
+	inline void recordTraversalDepth(int depth) noexcept
+	{
+		detail::addTraversalDepth(depth);
+	}
+
+	CounterSnapshot snapshotCounters();
+	void resetCounters();
+#else
+	constexpr void count(Counter, ::std::uint64_t = 1) noexcept {}
+	inline void recordTraversalDepth(int) noexcept {}
+	inline CounterSnapshot snapshotCounters() { return CounterSnapshot{}; }
+	inline void resetCounters() {}
+#endif
+
+	/*Tracks the depth of a stack based hierarchy traversal and records the deepest level reached when
+	  the query ends. Empty unless counting. SLOTS is the size of the traversal stack.
+	  Call descend() when moving to a child, push(slot) right after it for a sibling of that child
+	  put on the stack and pop(slot) when it is taken off again.
+	  Traversals that put every child on the stack instead call pushChild(slot) for each child they
+	  push and visit(slot) for each entry they take off and process; the root is in slot 0.*/
+	template<int SLOTS = TRAVERSAL_DEPTH_BINS>
+	class TraversalDepth
+	{
+	public:
+#ifdef MPN_COUNTERS
+		~TraversalDepth() { recordTraversalDepth(deepest); }
+
+		void descend() noexcept { deepest = ::std::max(deepest, ++depth); }
+		void push(int slot) noexcept { stackDepth[slot] = depth; }
+		void pop(int slot) noexcept { depth = stackDepth[slot]; }
+		void pushChild(int slot) noexcept { stackDepth[slot] = depth + 1; }
+		void visit(int slot) noexcept { depth = stackDepth[slot]; deepest = ::std::max(deepest, depth); }
+
+	private:
+		int depth = 0;
+		int deepest = 0;
+		int stackDepth[SLOTS] = {};
+#else
+		void descend() noexcept {}
+		void push(int) noexcept {}
+		void pop(int) noexcept {}
+		void pushChild(int) noexcept {}
+		void visit(int) noexcept {}
+#endif
+	};
+}
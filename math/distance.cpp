@@ -0,0 +1,227 @@
+#include "distance.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "lanes.h"
+#include "simd.h"
+
+namespace geom {
+
+	std::vector<TriangleBlock> TriangleBlock::pack(std::span<const Triangle> triangles)
+	{
+		std::vector<TriangleBlock> blocks((triangles.size() + SIZE - 1) / SIZE);
+		for (size_t i = 0; i < blocks.size() * SIZE; ++i)
+		{
+			const Triangle& triangle = triangles[std::min(i, triangles.size() - 1)];
+			TriangleBlock& block = blocks[i / SIZE];
+			const size_t lane = i % SIZE;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				block.a[axis][lane] = triangle.vertices[0][axis];
+				block.ab[axis][lane] = triangle.vertices[1][axis] - triangle.vertices[0][axis];
+				block.ac[axis][lane] = triangle.vertices[2][axis] - triangle.vertices[0][axis];
+			}
+		}
+		return blocks;
+	}
+
+#if defined(MPN_AVX) || defined(MPN_SSE2)
+	namespace {
+
+		// One AVX register covers a block, SSE2 takes two
+#ifdef MPN_AVX
+		using R = ::mpn::lanes::Register<8>;
+		constexpr int REGISTER_WIDTH = 8;
+#else
+		using R = ::mpn::lanes::Register<4>;
+		constexpr int REGISTER_WIDTH = 4;
+#endif
+		static_assert(TriangleBlock::SIZE % REGISTER_WIDTH == 0, "A block must fill whole registers");
+
+		R::Type dot(const R::Type x[3], const R::Type y[3]) noexcept
+		{
+			return R::add(R::add(R::multiply(x[0], y[0]), R::multiply(x[1], y[1])), R::multiply(x[2], y[2]));
+		}
+
+		// Squared distance of the point at 'offset' from the start of the segment 'edge'
+		R::Type segmentDistance(const R::Type offset[3], const R::Type edge[3]) noexcept
+		{
+			const R::Type length = R::maximum(dot(edge, edge), R::broadcast(FLT_MIN));
+			const R::Type t = R::minimum(R::maximum(R::divide(dot(offset, edge), length), R::broadcast(0.0f)), R::broadcast(1.0f));
+			R::Type rest[3];
+			for (int axis = 0; axis < 3; ++axis)
+				rest[axis] = R::subtract(offset[axis], R::multiply(t, edge[axis]));
+			return dot(rest, rest);
+		}
+	}
+
+	void squaredDistances(const TriangleBlock& block, const ::mpn::Point3& point, float* distances) noexcept
+	{
+		for (int lane = 0; lane < TriangleBlock::SIZE; lane += REGISTER_WIDTH)
+		{
+			R::Type ab[3], ac[3], bc[3], ap[3], bp[3];
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				ab[axis] = R::load(block.ab[axis] + lane);
+				ac[axis] = R::load(block.ac[axis] + lane);
+				bc[axis] = R::subtract(ac[axis], ab[axis]);
+				ap[axis] = R::subtract(R::broadcast(point[axis]), R::load(block.a[axis] + lane));
+				bp[axis] = R::subtract(ap[axis], ab[axis]);
+			}
+
+			// Barycentrics of the projection onto the plane
+			const R::Type d00 = dot(ab, ab), d01 = dot(ab, ac), d11 = dot(ac, ac);
+			const R::Type d20 = dot(ap, ab), d21 = dot(ap, ac);
+			const R::Type denominator = R::subtract(R::multiply(d00, d11), R::multiply(d01, d01));
+			const R::Type inverse = R::divide(R::broadcast(1.0f), denominator);
+			const R::Type v = R::multiply(R::subtract(R::multiply(d11, d20), R::multiply(d01, d21)), inverse);
+			const R::Type w = R::multiply(R::subtract(R::multiply(d00, d21), R::multiply(d01, d20)), inverse);
+			const R::Type zero = R::broadcast(0.0f);
+			const R::Type inside = R::bitAnd(
+				R::bitAnd(R::lessEqual(zero, v), R::lessEqual(zero, w)),
+				R::bitAnd(R::lessEqual(R::add(v, w), R::broadcast(1.0f)), R::less(zero, denominator)));
+
+			R::Type rest[3];
+			for (int axis = 0; axis < 3; ++axis)
+				rest[axis] = R::subtract(ap[axis], R::add(R::multiply(v, ab[axis]), R::multiply(w, ac[axis])));
+			const R::Type face = dot(rest, rest);
+			const R::Type edges = R::minimum(R::minimum(segmentDistance(ap, ab), segmentDistance(ap, ac)), segmentDistance(bp, bc));
+			R::store(distances + lane, R::select(inside, face, edges));
+		}
+	}
+#else
+	namespace {
+
+		float dot(const float x[3], const float y[3]) noexcept
+		{
+			return x[0] * y[0] + x[1] * y[1] + x[2] * y[2];
+		}
+
+		float segmentDistance(const float offset[3], const float edge[3]) noexcept
+		{
+			const float t = std::clamp(dot(offset, edge) / std::max(dot(edge, edge), FLT_MIN), 0.0f, 1.0f);
+			const float rest[3] = { offset[0] - t * edge[0], offset[1] - t * edge[1], offset[2] - t * edge[2] };
+			return dot(rest, rest);
+		}
+	}
+
+	void squaredDistances(const TriangleBlock& block, const ::mpn::Point3& point, float* distances) noexcept
+	{
+		for (int lane = 0; lane < TriangleBlock::SIZE; ++lane)
+		{
+			float ab[3], ac[3], bc[3], ap[3], bp[3];
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				ab[axis] = block.ab[axis][lane];
+				ac[axis] = block.ac[axis][lane];
+				bc[axis] = ac[axis] - ab[axis];
+				ap[axis] = point[axis] - block.a[axis][lane];
+				bp[axis] = ap[axis] - ab[axis];
+			}
+
+			const float d00 = dot(ab, ab), d01 = dot(ab, ac), d11 = dot(ac, ac);
+			const float d20 = dot(ap, ab), d21 = dot(ap, ac);
+			const float denominator = d00 * d11 - d01 * d01;
+			if (denominator > 0.0f)
+			{
+				const float v = (d11 * d20 - d01 * d21) / denominator;
+				const float w = (d00 * d21 - d01 * d20) / denominator;
+				if (v >= 0.0f && w >= 0.0f && v + w <= 1.0f)
+				{
+					const float rest[3] = { ap[0] - v * ab[0] - w * ac[0], ap[1] - v * ab[1] - w * ac[1], ap[2] - v * ab[2] - w * ac[2] };
+					distances[lane] = dot(rest, rest);
+					continue;
+				}
+			}
+			distances[lane] = std::min(std::min(segmentDistance(ap, ab), segmentDistance(ap, ac)), segmentDistance(bp, bc));
+		}
+	}
+#endif
+
+	MeshDistance::MeshDistance(const TriangleMesh& mesh)
+		: mesh(&mesh)
+	{
+		const std::span<const BVHNode> nodes = mesh.getBVH().getNodes();
+		const std::span<const Triangle> triangles = mesh.getTriangles();
+		leafBlocks.resize(nodes.size());
+		for (size_t i = 0; i < nodes.size(); ++i)
+		{
+			if (!nodes[i].isLeaf())
+				continue;
+			leafBlocks[i] = static_cast<std::uint32_t>(blocks.size());
+			const std::vector<TriangleBlock> leaf = TriangleBlock::pack(triangles.subspan(nodes[i].offset, nodes[i].count));
+			blocks.insert(blocks.end(), leaf.begin(), leaf.end());
+		}
+	}
+
+	SurfacePoint MeshDistance::closestPoint(const ::mpn::Point3& point, float maxDistance) const noexcept
+	{
+		SurfacePoint result;
+		const std::span<const BVHNode> nodes = mesh->getBVH().getNodes();
+		if (nodes.empty())
+			return result;
+
+		float closest = maxDistance < FLT_MAX ? maxDistance * maxDistance : FLT_MAX;	// squared
+		bool found = false;
+		std::uint32_t closestTriangle = 0;
+
+		// Nearest child first; a subtree is skipped once it is farther than the closest triangle
+		std::uint32_t stack[BVH::MAX_DEPTH];
+		float stackDistance[BVH::MAX_DEPTH];
+		int stackSize = 0;
+		stack[stackSize] = 0;
+		stackDistance[stackSize++] = nodes[0].bounds.squaredDistance(point);
+		while (stackSize > 0)
+		{
+			--stackSize;
+			if (stackDistance[stackSize] > closest)
+				continue;
+			const BVHNode& node = nodes[stack[stackSize]];
+			if (node.isLeaf())
+			{
+				// The padding lanes of the last block of the leaf are ignored
+				const TriangleBlock* block = &blocks[leafBlocks[stack[stackSize]]];
+				for (std::uint32_t first = 0; first < node.count; first += TriangleBlock::SIZE, ++block)
+				{
+					alignas(32) float distances[TriangleBlock::SIZE];
+					squaredDistances(*block, point, distances);
+					const std::uint32_t count = std::min<std::uint32_t>(TriangleBlock::SIZE, node.count - first);
+					for (std::uint32_t lane = 0; lane < count; ++lane)
+					{
+						if (distances[lane] <= closest)
+						{
+							closest = distances[lane];
+							closestTriangle = node.offset + first + lane;
+							found = true;
+						}
+					}
+				}
+				continue;
+			}
+
+			std::uint32_t nearChild = stack[stackSize] + 1;
+			std::uint32_t farChild = node.offset;
+			float nearDistance = nodes[nearChild].bounds.squaredDistance(point);
+			float farDistance = nodes[farChild].bounds.squaredDistance(point);
+			if (farDistance < nearDistance)
+			{
+				std::swap(nearChild, farChild);
+				std::swap(nearDistance, farDistance);
+			}
+			stack[stackSize] = farChild;
+			stackDistance[stackSize++] = farDistance;
+			stack[stackSize] = nearChild;
+			stackDistance[stackSize++] = nearDistance;
+		}
+
+		if (found)
+		{
+			// The exact point comes from the scalar region test of the winning triangle
+			result.triangle = closestTriangle;
+			result.point = mesh->getTriangles()[closestTriangle].closestPoint(point);
+			result.distance = (point - result.point).length();
+		}
+		return result;
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cfloat>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "mesh.h"
+#include "primitives.h"
+
+namespace geom {
+
+	/*Eight triangles stored as structure of arrays (first vertex and the two edges from it),
+	  so the distance of a point from all of them is computed at once.
+	  Unused lanes of the last block of a set repeat its last triangle.*/
+	struct alignas(32) TriangleBlock
+	{
+		static constexpr int SIZE = 8;
+
+		float a[3][SIZE];
+		float ab[3][SIZE];
+		float ac[3][SIZE];
+
+		/*Packs the triangles into ceil(size / SIZE) blocks, triangle i going to lane i % SIZE of block i / SIZE.*/
+		static ::std::vector<TriangleBlock> pack(::std::span<const Triangle> triangles);
+	};
+
+	/*Squared distances of the point from the eight triangles of the block, written to 'distances' which
+	  is aligned like the block. The point is projected onto the plane if that falls inside the triangle, otherwise the closest of the
+	  three edges is taken, which is branch free. Matches Triangle::distance up to rounding.*/
+	void squaredDistances(const TriangleBlock& block, const ::mpn::Point3& point, float* distances) noexcept;
+
+	/*Closest point query result.*/
+	struct SurfacePoint
+	{
+		::mpn::Point3 point;
+		float distance = INVALID_DISTANCE;
+		::std::uint32_t triangle = 0;	// index into the mesh triangles
+	};
+
+	/*Nearest surface queries against a triangle mesh. Traverses the mesh hierarchy nearest box first,
+	  skips every box farther than the closest triangle found so far, and tests the triangles of the
+	  leaves block by block. Each leaf has blocks of its own, so a leaf of up to eight triangles is one
+	  block test. The mesh is not copied and has to outlive the query object.*/
+	class MeshDistance
+	{
+	public:
+		explicit MeshDistance(const TriangleMesh& mesh);
+
+		/*Closest point of the mesh surface, or a result with distance INVALID_DISTANCE if nothing is within 'maxDistance'.*/
+		SurfacePoint closestPoint(const ::mpn::Point3& point, float maxDistance = FLT_MAX) const noexcept;
+
+		/*Unsigned distance of the point from the mesh surface, INVALID_DISTANCE for empty meshes.*/
+		float distance(const ::mpn::Point3& point) const noexcept { return closestPoint(point).distance; }
+
+	private:
+		const TriangleMesh* mesh;
+		::std::vector<TriangleBlock> blocks;
+		::std::vector<::std::uint32_t> leafBlocks;	// first block of each leaf, by node index
+	};
+}
@@ -0,0 +1,244 @@
+#include "dynamictree.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace geom {
+
+	namespace {
+
+		float surfaceArea(const AABB& box) noexcept
+		{
+			const ::mpn::Vector3 d = box.maxCoords - box.minCoords;
+			return 2.0f * (d[0] * d[1] + d[1] * d[2] + d[2] * d[0]);
+		}
+	}
+
+	DynamicTree::DynamicTree(float margin)
+		: margin(margin)
+	{
+		if (!(margin >= 0.0f))
+			throw std::invalid_argument("The margin must not be negative");
+	}
+
+	std::uint32_t DynamicTree::insert(const AABB& bounds, std::uint32_t userData)
+	{
+		const std::uint32_t proxy = allocateNode();
+		nodes[proxy].bounds = fatten(bounds, ::mpn::Vector3());
+		nodes[proxy].userData = userData;
+		insertLeaf(proxy);
+		++proxyCount;
+		return proxy;
+	}
+
+	void DynamicTree::remove(std::uint32_t proxy)
+	{
+		if (proxy >= nodes.size() || nodes[proxy].height != 0)
+			throw std::invalid_argument("Not a proxy of the tree");
+		removeLeaf(proxy);
+		freeNode(proxy);
+		--proxyCount;
+	}
+
+	bool DynamicTree::move(std::uint32_t proxy, const AABB& bounds, const ::mpn::Vector3& displacement)
+	{
+		if (proxy >= nodes.size() || nodes[proxy].height != 0)
+			throw std::invalid_argument("Not a proxy of the tree");
+		if (nodes[proxy].bounds.contains(bounds))
+			return false;
+
+		removeLeaf(proxy);
+		nodes[proxy].bounds = fatten(bounds, displacement);
+		insertLeaf(proxy);
+		return true;
+	}
+
+	AABB DynamicTree::fatten(const AABB& bounds, const ::mpn::Vector3& displacement) const noexcept
+	{
+		// Grow by the margin all around and by twice the displacement in the direction of motion
+		AABB result = bounds;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			result.minCoords[axis] -= margin;
+			result.maxCoords[axis] += margin;
+			const float predicted = 2.0f * displacement[axis];
+			if (predicted < 0.0f)
+				result.minCoords[axis] += predicted;
+			else
+				result.maxCoords[axis] += predicted;
+		}
+		return result;
+	}
+
+	std::uint32_t DynamicTree::allocateNode()
+	{
+		std::uint32_t index;
+		if (freeList != NULL_NODE)
+		{
+			index = freeList;
+			freeList = nodes[index].parent;
+		}
+		else
+		{
+			if (nodes.size() >= NULL_NODE)
+				throw std::length_error("Too many nodes");
+			index = static_cast<std::uint32_t>(nodes.size());
+			nodes.emplace_back();
+		}
+		nodes[index] = Node{};
+		return index;
+	}
+
+	void DynamicTree::freeNode(std::uint32_t node) noexcept
+	{
+		nodes[node].parent = freeList;
+		nodes[node].height = -1;
+		freeList = node;
+	}
+
+	void DynamicTree::insertLeaf(std::uint32_t leaf)
+	{
+		if (root == NULL_NODE)
+		{
+			root = leaf;
+			nodes[root].parent = NULL_NODE;
+			return;
+		}
+
+		// Find the sibling that minimizes the surface area added to the tree, including the growth of its ancestors
+		const AABB& leafBounds = nodes[leaf].bounds;
+		std::uint32_t index = root;
+		while (!nodes[index].isLeaf())
+		{
+			const Node& node = nodes[index];
+			const float area = surfaceArea(node.bounds);
+			const float combinedArea = surfaceArea(AABB::_union(node.bounds, leafBounds));
+			// Cost of pairing with this node, and the cost pushed down to its children by growing it
+			const float cost = 2.0f * combinedArea;
+			const float inheritanceCost = 2.0f * (combinedArea - area);
+
+			auto descendCost = [&](std::uint32_t child)
+			{
+				const Node& childNode = nodes[child];
+				const float grown = surfaceArea(AABB::_union(childNode.bounds, leafBounds));
+				return (childNode.isLeaf() ? grown : grown - surfaceArea(childNode.bounds)) + inheritanceCost;
+			};
+			const float cost1 = descendCost(node.child1);
+			const float cost2 = descendCost(node.child2);
+			if (cost < cost1 && cost < cost2)
+				break;
+			index = cost1 < cost2 ? node.child1 : node.child2;
+		}
+		const std::uint32_t sibling = index;
+
+		// New parent of the sibling and the leaf; may reallocate the nodes
+		const std::uint32_t oldParent = nodes[sibling].parent;
+		const std::uint32_t newParent = allocateNode();
+		nodes[newParent].parent = oldParent;
+		nodes[newParent].bounds = AABB::_union(nodes[sibling].bounds, nodes[leaf].bounds);
+		nodes[newParent].height = nodes[sibling].height + 1;
+		nodes[newParent].child1 = sibling;
+		nodes[newParent].child2 = leaf;
+		nodes[sibling].parent = newParent;
+		nodes[leaf].parent = newParent;
+		if (oldParent == NULL_NODE)
+			root = newParent;
+		else if (nodes[oldParent].child1 == sibling)
+			nodes[oldParent].child1 = newParent;
+		else
+			nodes[oldParent].child2 = newParent;
+
+		refitAncestors(nodes[leaf].parent);
+	}
+
+	void DynamicTree::removeLeaf(std::uint32_t leaf) noexcept
+	{
+		if (leaf == root)
+		{
+			root = NULL_NODE;
+			return;
+		}
+
+		// The sibling takes the place of the parent
+		const std::uint32_t parent = nodes[leaf].parent;
+		const std::uint32_t grandParent = nodes[parent].parent;
+		const std::uint32_t sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+		nodes[sibling].parent = grandParent;
+		freeNode(parent);
+		if (grandParent == NULL_NODE)
+		{
+			root = sibling;
+			return;
+		}
+		if (nodes[grandParent].child1 == parent)
+			nodes[grandParent].child1 = sibling;
+		else
+			nodes[grandParent].child2 = sibling;
+		refitAncestors(grandParent);
+	}
+
+	void DynamicTree::refitAncestors(std::uint32_t node) noexcept
+	{
+		while (node != NULL_NODE)
+		{
+			node = balance(node);
+			Node& current = nodes[node];
+			const Node& child1 = nodes[current.child1];
+			const Node& child2 = nodes[current.child2];
+			current.height = 1 + std::max(child1.height, child2.height);
+			current.bounds = AABB::_union(child1.bounds, child2.bounds);
+			node = current.parent;
+		}
+	}
+
+	std::uint32_t DynamicTree::balance(std::uint32_t indexA) noexcept
+	{
+		// Rotates the higher child up if the children differ in height by more than one, returns the new subtree root
+		Node& a = nodes[indexA];
+		if (a.isLeaf() || a.height < 2)
+			return indexA;
+
+		const std::uint32_t indexB = a.child1;
+		const std::uint32_t indexC = a.child2;
+		const int difference = nodes[indexC].height - nodes[indexB].height;
+		if (difference >= -1 && difference <= 1)
+			return indexA;
+
+		// Rotate the higher child up: it replaces A, A takes its place, and its lower child moves under A
+		const bool rotateC = difference > 1;
+		const std::uint32_t up = rotateC ? indexC : indexB;
+		const std::uint32_t stay = rotateC ? indexB : indexC;
+		Node& upper = nodes[up];
+		const std::uint32_t indexF = upper.child1;
+		const std::uint32_t indexG = upper.child2;
+		Node& f = nodes[indexF];
+		Node& g = nodes[indexG];
+
+		upper.child1 = indexA;
+		upper.parent = a.parent;
+		a.parent = up;
+		if (upper.parent == NULL_NODE)
+			root = up;
+		else if (nodes[upper.parent].child1 == indexA)
+			nodes[upper.parent].child1 = up;
+		else
+			nodes[upper.parent].child2 = up;
+
+		// The higher grandchild stays under the rotated node, the lower one replaces it under A
+		const bool keepF = f.height > g.height;
+		const std::uint32_t kept = keepF ? indexF : indexG;
+		const std::uint32_t moved = keepF ? indexG : indexF;
+		upper.child2 = kept;
+		if (rotateC)
+			a.child2 = moved;
+		else
+			a.child1 = moved;
+		nodes[moved].parent = indexA;
+
+		a.bounds = AABB::_union(nodes[stay].bounds, nodes[moved].bounds);
+		a.height = 1 + std::max(nodes[stay].height, nodes[moved].height);
+		upper.bounds = AABB::_union(a.bounds, nodes[kept].bounds);
+		upper.height = 1 + std::max(a.height, nodes[kept].height);
+		return up;
+	}
+}
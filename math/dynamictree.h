@@ -0,0 +1,184 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "counters.h"
+#include "primitives.h"
+
+namespace geom {
+
+	/*Bounding volume hierarchy over moving objects, updated incrementally instead of rebuilt.
+	  Every object (proxy) is stored in a leaf with a fat box: its bounds enlarged by a margin and by
+	  the predicted displacement. Moving an object within its fat box does not touch the tree at all.
+	  Leaves are inserted next to the sibling that grows the surface area the least, and the tree is
+	  kept balanced by rotations, so insert, remove and move take logarithmic time.
+	  Proxy ids stay valid until the proxy is removed, then they are reused.*/
+	class DynamicTree
+	{
+	public:
+		static constexpr ::std::uint32_t NULL_NODE = UINT32_MAX;
+
+		/*Throws std::invalid_argument if the margin is negative.*/
+		explicit DynamicTree(float margin = 0.1f);
+
+		/*Adds an object with the given tight bounds and returns its proxy id.*/
+		::std::uint32_t insert(const AABB& bounds, ::std::uint32_t userData);
+
+		void remove(::std::uint32_t proxy);
+
+		/*Updates the bounds of an object that moved by 'displacement' since the last update.
+		  Returns whether its leaf had to be reinserted, which is not the case while its fat box still contains 'bounds'.*/
+		bool move(::std::uint32_t proxy, const AABB& bounds, const ::mpn::Vector3& displacement = ::mpn::Vector3());
+
+		/*Calls callback(proxy) for every fat box overlapping the box. The query stops if the callback returns false.*/
+		template<typename Callback>
+		void query(const AABB& box, Callback&& callback) const;
+
+		/*Calls callback(proxyA, proxyB) once for every pair of overlapping fat boxes.*/
+		template<typename Callback>
+		void queryPairs(Callback&& callback) const;
+
+		/*Closest hit along the line, same contract as BVH::intersect with proxy ids as primitive indices.*/
+		template<typename IntersectProxy>
+		float intersect(const Line& line, IntersectProxy&& intersectProxy, ::std::uint32_t* hitProxy = nullptr) const;
+
+		const AABB& getFatBounds(::std::uint32_t proxy) const { return nodes[proxy].bounds; }
+		::std::uint32_t getUserData(::std::uint32_t proxy) const { return nodes[proxy].userData; }
+		size_t size() const noexcept { return proxyCount; }
+		/*Number of levels below the root, -1 if the tree is empty.*/
+		int getHeight() const noexcept { return root == NULL_NODE ? -1 : nodes[root].height; }
+
+	private:
+		static constexpr int STACK_SIZE = 128;
+
+		struct Node
+		{
+			AABB bounds;
+			::std::uint32_t parent = NULL_NODE;	// next free node while on the free list
+			::std::uint32_t child1 = NULL_NODE;
+			::std::uint32_t child2 = NULL_NODE;
+			::std::uint32_t userData = 0;
+			int height = 0;	// -1 for free nodes
+
+			bool isLeaf() const noexcept { return child1 == NULL_NODE; }
+		};
+
+		::std::uint32_t allocateNode();
+		void freeNode(::std::uint32_t node) noexcept;
+		void insertLeaf(::std::uint32_t leaf);
+		void removeLeaf(::std::uint32_t leaf) noexcept;
+		void refitAncestors(::std::uint32_t node) noexcept;
+		::std::uint32_t balance(::std::uint32_t node) noexcept;
+		AABB fatten(const AABB& bounds, const ::mpn::Vector3& displacement) const noexcept;
+
+		::std::vector<Node> nodes;
+		::std::uint32_t root = NULL_NODE;
+		::std::uint32_t freeList = NULL_NODE;
+		size_t proxyCount = 0;
+		float margin;
+	};
+
+	template<typename Callback>
+	void DynamicTree::query(const AABB& box, Callback&& callback) const
+	{
+		if (root == NULL_NODE)
+			return;
+		::std::uint32_t stack[STACK_SIZE];
+		int stackSize = 0;
+		::mpn::TraversalDepth<STACK_SIZE> depth;
+		stack[stackSize++] = root;
+		while (stackSize > 0)
+		{
+			const ::std::uint32_t index = stack[--stackSize];
+			const Node& node = nodes[index];
+			if (!overlaps(node.bounds, box))
+				continue;
+			depth.visit(stackSize);
+			if (node.isLeaf())
+			{
+				if (!callback(index))
+					return;
+			}
+			else
+			{
+				depth.pushChild(stackSize);
+				stack[stackSize++] = node.child2;
+				depth.pushChild(stackSize);
+				stack[stackSize++] = node.child1;
+			}
+		}
+	}
+
+	template<typename Callback>
+	void DynamicTree::queryPairs(Callback&& callback) const
+	{
+		for (::std::uint32_t proxy = 0; proxy < nodes.size(); ++proxy)
+		{
+			if (nodes[proxy].height != 0)
+				continue;
+			// Every pair is seen from both proxies, only report it from the smaller id
+			query(nodes[proxy].bounds, [&](::std::uint32_t other)
+			{
+				if (other > proxy)
+					callback(proxy, other);
+				return true;
+			});
+		}
+	}
+
+	template<typename IntersectProxy>
+	float DynamicTree::intersect(const Line& line, IntersectProxy&& intersectProxy, ::std::uint32_t* hitProxy) const
+	{
+		float closest = INVALID_DISTANCE;
+		if (root == NULL_NODE)
+			return closest;
+
+		::std::uint32_t stack[STACK_SIZE];
+		float stackDistance[STACK_SIZE];
+		int stackSize = 0;
+		::mpn::TraversalDepth<STACK_SIZE> depth;
+		stack[stackSize] = root;
+		stackDistance[stackSize++] = nodes[root].bounds.entryDistance(line);
+		while (stackSize > 0)
+		{
+			--stackSize;
+			const float entry = stackDistance[stackSize];
+			if (entry < 0.0f || (closest >= 0.0f && entry > closest))
+				continue;
+			depth.visit(stackSize);
+			const ::std::uint32_t index = stack[stackSize];
+			const Node& node = nodes[index];
+			if (node.isLeaf())
+			{
+				const float distance = intersectProxy(index, line);
+				if (distance >= 0.0f && (closest < 0.0f || distance < closest))
+				{
+					closest = distance;
+					if (hitProxy != nullptr)
+						*hitProxy = index;
+				}
+				continue;
+			}
+
+			// Push the farther child first, so the nearer one is visited first
+			float distance1 = nodes[node.child1].bounds.entryDistance(line);
+			float distance2 = nodes[node.child2].bounds.entryDistance(line);
+			::std::uint32_t child1 = node.child1;
+			::std::uint32_t child2 = node.child2;
+			if (distance2 >= 0.0f && (distance1 < 0.0f || distance2 < distance1))
+			{
+				::std::swap(child1, child2);
+				::std::swap(distance1, distance2);
+			}
+			depth.pushChild(stackSize);
+			stack[stackSize] = child2;
+			stackDistance[stackSize++] = distance2;
+			depth.pushChild(stackSize);
+			stack[stackSize] = child1;
+			stackDistance[stackSize++] = distance1;
+		}
+		return closest;
+	}
+}
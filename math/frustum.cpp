@@ -0,0 +1,140 @@
+#include "frustum.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <stdexcept>
+
+#include "lanes.h"
+#include "simd.h"
+
+namespace geom {
+
+	namespace {
+
+		// Boxes transposed together by the batch classification, tested a register at a time
+		constexpr size_t BATCH_SIZE = 8;
+#if defined(MPN_AVX)
+		constexpr int REGISTER_WIDTH = 8;
+#elif defined(MPN_SSE2)
+		constexpr int REGISTER_WIDTH = 4;
+#endif
+	}
+
+	Frustum::Frustum(const ::mpn::Matrix4& viewProjection) noexcept
+	{
+		// Clip coordinates are dot products with the matrix columns, a point is visible if -w <= x, y, z <= w.
+		// Each plane is the w column plus or minus the x, y or z column.
+		for (int plane = 0; plane < PLANE_COUNT; ++plane)
+		{
+			const int column = plane / 2;
+			const float sign = plane % 2 == 0 ? 1.0f : -1.0f;
+			float coefficients[4];
+			for (int row = 0; row < 4; ++row)
+				coefficients[row] = viewProjection(row, 3) + sign * viewProjection(row, column);
+			const float length = std::sqrt(coefficients[0] * coefficients[0] + coefficients[1] * coefficients[1] + coefficients[2] * coefficients[2]);
+			const float scale = length > 0.0f ? 1.0f / length : 1.0f;
+			normalX[plane] = coefficients[0] * scale;
+			normalY[plane] = coefficients[1] * scale;
+			normalZ[plane] = coefficients[2] * scale;
+			offset[plane] = coefficients[3] * scale;
+		}
+	}
+
+	Containment Frustum::classify(const AABB& box) const noexcept
+	{
+		std::uint8_t planeMask = ALL_PLANES;
+		return classify(box, planeMask);
+	}
+
+	Containment Frustum::classify(const AABB& box, std::uint8_t& planeMask) const noexcept
+	{
+		for (unsigned mask = planeMask; mask != 0; mask &= mask - 1)
+		{
+			const int plane = std::countr_zero(mask);
+			// The corner furthest along the normal decides whether the box is outside, the opposite one whether it is inside
+			const bool positiveX = normalX[plane] >= 0.0f;
+			const bool positiveY = normalY[plane] >= 0.0f;
+			const bool positiveZ = normalZ[plane] >= 0.0f;
+			const ::mpn::Point3 farthest(
+				positiveX ? box.maxCoords[0] : box.minCoords[0],
+				positiveY ? box.maxCoords[1] : box.minCoords[1],
+				positiveZ ? box.maxCoords[2] : box.minCoords[2]);
+			if (distance(plane, farthest) < 0.0f)
+				return Containment::Outside;
+			const ::mpn::Point3 nearest(
+				positiveX ? box.minCoords[0] : box.maxCoords[0],
+				positiveY ? box.minCoords[1] : box.maxCoords[1],
+				positiveZ ? box.minCoords[2] : box.maxCoords[2]);
+			if (distance(plane, nearest) >= 0.0f)
+				planeMask &= ~(1u << plane);
+		}
+		return planeMask == 0 ? Containment::Inside : Containment::Intersecting;
+	}
+
+	void Frustum::classify(std::span<const AABB> boxes, std::span<Containment> results, std::uint8_t planeMask) const
+	{
+		if (results.size() != boxes.size())
+			throw std::invalid_argument("There must be one result for each box");
+
+#if defined(MPN_AVX) || defined(MPN_SSE2)
+		using R = ::mpn::lanes::Register<REGISTER_WIDTH>;
+		for (size_t base = 0; base < boxes.size(); base += BATCH_SIZE)
+		{
+			// Transpose a batch of boxes into lanes, the last one is repeated to fill a partial batch
+			const size_t count = std::min(BATCH_SIZE, boxes.size() - base);
+			alignas(32) float minCoords[3][BATCH_SIZE];
+			alignas(32) float maxCoords[3][BATCH_SIZE];
+			for (size_t i = 0; i < BATCH_SIZE; ++i)
+			{
+				const AABB& box = boxes[base + std::min(i, count - 1)];
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					minCoords[axis][i] = box.minCoords[axis];
+					maxCoords[axis][i] = box.maxCoords[axis];
+				}
+			}
+
+			// One register of boxes at a time: the whole batch with AVX, two halves with SSE2
+			unsigned outsideBits = 0, straddlingBits = 0;
+			for (size_t lane = 0; lane < BATCH_SIZE; lane += REGISTER_WIDTH)
+			{
+				const R::Type zero = R::broadcast(0.0f);
+				R::Type outside = zero;
+				R::Type straddling = zero;
+				for (unsigned mask = planeMask; mask != 0; mask &= mask - 1)
+				{
+					const int plane = std::countr_zero(mask);
+					const float normal[3] = { normalX[plane], normalY[plane], normalZ[plane] };
+					R::Type farthest = R::broadcast(offset[plane]);
+					R::Type nearest = farthest;
+					for (int axis = 0; axis < 3; ++axis)
+					{
+						const bool positive = normal[axis] >= 0.0f;
+						const R::Type n = R::broadcast(normal[axis]);
+						const R::Type high = R::load((positive ? maxCoords[axis] : minCoords[axis]) + lane);
+						const R::Type low = R::load((positive ? minCoords[axis] : maxCoords[axis]) + lane);
+						farthest = R::add(farthest, R::multiply(n, high));
+						nearest = R::add(nearest, R::multiply(n, low));
+					}
+					outside = R::bitOr(outside, R::less(farthest, zero));
+					straddling = R::bitOr(straddling, R::less(nearest, zero));
+				}
+				outsideBits |= static_cast<unsigned>(R::bits(outside)) << lane;
+				straddlingBits |= static_cast<unsigned>(R::bits(straddling)) << lane;
+			}
+
+			for (size_t i = 0; i < count; ++i)
+				results[base + i] = (outsideBits >> i) & 1 ? Containment::Outside
+					: (straddlingBits >> i) & 1 ? Containment::Intersecting
+					: Containment::Inside;
+		}
+#else
+		for (size_t i = 0; i < boxes.size(); ++i)
+		{
+			std::uint8_t mask = planeMask;
+			results[i] = classify(boxes[i], mask);
+		}
+#endif
+	}
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+#include "bvh.h"
+#include "counters.h"
+#include "matrix.h"
+#include "primitives.h"
+
+namespace geom {
+
+	enum class Containment : ::std::uint8_t
+	{
+		Outside,
+		Intersecting,
+		Inside
+	};
+
+	/*Volume visible through a view-projection matrix, bounded by six planes.
+	  Matrices are applied to row vectors (point * matrix) and the visible device volume is [-1,1] on every axis,
+	  as for Camera. The planes are stored as structure of arrays and point inwards.
+
+	  Plane masks select the planes still worth testing, bit i standing for plane i. A box fully inside
+	  some planes is fully inside them for all of its children too, so hierarchical culling passes the
+	  mask returned for a parent on to its children and fully inside subtrees are not tested at all.*/
+	class Frustum
+	{
+	public:
+		static constexpr int PLANE_COUNT = 6;
+		static constexpr ::std::uint8_t ALL_PLANES = 0x3F;
+
+		explicit Frustum(const ::mpn::Matrix4& viewProjection) noexcept;
+
+		Containment classify(const AABB& box) const noexcept;
+
+		/*Classifies the box against the planes in 'planeMask' only, and clears the bits of the planes the
+		  box is fully inside of. Outside boxes leave the mask undefined.*/
+		Containment classify(const AABB& box, ::std::uint8_t& planeMask) const noexcept;
+
+		/*Classifies the boxes eight at a time against the planes in 'planeMask', in one AVX or two SSE2 registers.
+		 Throws std::invalid_argument if the result span is not as long as the box span.*/
+		void classify(::std::span<const AABB> boxes, ::std::span<Containment> results, ::std::uint8_t planeMask = ALL_PLANES) const;
+
+		/*Culls the hierarchy and calls visit(firstPrimitive, primitiveCount, fullyInside) for every leaf not outside.
+		  Subtrees found fully inside are enumerated without further tests, with fullyInside set.*/
+		template<typename Visit>
+		void cull(const BVH& bvh, Visit&& visit) const;
+
+		/*Signed distance of the point from the plane, positive inside.*/
+		float distance(int plane, const ::mpn::Point3& point) const noexcept
+		{
+			return normalX[plane] * point[0] + normalY[plane] * point[1] + normalZ[plane] * point[2] + offset[plane];
+		}
+
+	private:
+		// Slots for the cull stack and, above the entries still on it, the stack of a fully inside subtree
+		using CullDepth = ::mpn::TraversalDepth<2 * BVH::MAX_DEPTH + 1>;
+
+		template<typename Visit>
+		static void visitSubtree(::std::span<const BVHNode> nodes, ::std::uint32_t nodeIndex, Visit& visit, CullDepth& depth, int firstSlot);
+
+		// Left, right, bottom, top, near, far
+		alignas(32) float normalX[PLANE_COUNT];
+		alignas(32) float normalY[PLANE_COUNT];
+		alignas(32) float normalZ[PLANE_COUNT];
+		alignas(32) float offset[PLANE_COUNT];
+	};
+
+	template<typename Visit>
+	void Frustum::cull(const BVH& bvh, Visit&& visit) const
+	{
+		if (bvh.empty())
+			return;
+		const ::std::span<const BVHNode> nodes = bvh.getNodes();
+
+		struct Entry
+		{
+			::std::uint32_t node;
+			::std::uint8_t planeMask;
+		};
+		Entry stack[BVH::MAX_DEPTH + 1];
+		int stackSize = 0;
+		CullDepth depth;
+		stack[stackSize++] = Entry{ 0, ALL_PLANES };
+		while (stackSize > 0)
+		{
+			Entry entry = stack[--stackSize];
+			const BVHNode& node = nodes[entry.node];
+			if (classify(node.bounds, entry.planeMask) == Containment::Outside)
+				continue;
+			depth.visit(stackSize);
+			if (entry.planeMask == 0)
+				visitSubtree(nodes, entry.node, visit, depth, stackSize);
+			else if (node.isLeaf())
+				visit(node.offset, node.count, false);
+			else
+			{
+				depth.pushChild(stackSize);
+				stack[stackSize++] = Entry{ node.offset, entry.planeMask };
+				depth.pushChild(stackSize);
+				stack[stackSize++] = Entry{ entry.node + 1, entry.planeMask };
+			}
+		}
+	}
+
+	template<typename Visit>
+	void Frustum::visitSubtree(::std::span<const BVHNode> nodes, ::std::uint32_t nodeIndex, Visit& visit, CullDepth& depth, int firstSlot)
+	{
+		::std::uint32_t stack[BVH::MAX_DEPTH];
+		int stackSize = 0;
+		while (true)
+		{
+			const BVHNode& node = nodes[nodeIndex];
+			if (node.isLeaf())
+			{
+				visit(node.offset, node.count, true);
+				if (stackSize == 0)
+					return;
+				depth.pop(firstSlot + --stackSize);
+				nodeIndex = stack[stackSize];
+			}
+			else
+			{
+				depth.descend();
+				depth.push(firstSlot + stackSize);
+				stack[stackSize++] = node.offset;
+				++nodeIndex;
+			}
+		}
+	}
+}
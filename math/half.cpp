@@ -0,0 +1,161 @@
+#include "half.h"
+
+#include <bit>
+
+#include "simd.h"
+
+namespace mpn {
+
+	namespace {
+
+		// Float bit patterns of the half precision limits
+		constexpr std::uint32_t FLOAT_INFINITY = 0x7F800000;
+		constexpr std::uint32_t HALF_OVERFLOW = (127 + 16) << 23;	// 2^16, everything from 65520 up rounds to infinity
+		constexpr std::uint32_t HALF_MIN_NORMAL = (127 - 14) << 23;	// 2^-14
+
+		std::uint16_t floatToHalf(float value) noexcept
+		{
+			std::uint32_t bits = std::bit_cast<std::uint32_t>(value);
+			const std::uint32_t sign = (bits >> 16) & 0x8000;
+			bits &= 0x7FFFFFFF;
+
+			std::uint32_t result;
+			if (bits >= HALF_OVERFLOW)
+				result = bits > FLOAT_INFINITY ? 0x7E00 : 0x7C00;	// quiet NaN or infinity
+			else if (bits < HALF_MIN_NORMAL)
+			{
+				// Subnormal: adding 0.5 lines the half mantissa up with the low float mantissa bits,
+				// and the float addition does the rounding
+				constexpr std::uint32_t magic = ((127 - 15) + (23 - 10) + 1) << 23;
+				result = std::bit_cast<std::uint32_t>(std::bit_cast<float>(bits) + std::bit_cast<float>(magic)) - magic;
+			}
+			else
+			{
+				// Rebias the exponent and round the 13 dropped mantissa bits to nearest even
+				const std::uint32_t odd = (bits >> 13) & 1;
+				bits += (static_cast<std::uint32_t>(15 - 127) << 23) + 0xFFF + odd;
+				result = bits >> 13;
+			}
+			return static_cast<std::uint16_t>(result | sign);
+		}
+
+		float halfToFloat(std::uint16_t value) noexcept
+		{
+			constexpr std::uint32_t exponentMask = 0x7C00 << 13;
+			std::uint32_t bits = static_cast<std::uint32_t>(value & 0x7FFF) << 13;
+			const std::uint32_t exponent = bits & exponentMask;
+			bits += (127 - 15) << 23;
+			if (exponent == exponentMask)
+				bits += (128 - 16) << 23;	// infinity or NaN
+			else if (exponent == 0)
+			{
+				// Subnormal: renormalize through a float subtraction
+				constexpr std::uint32_t magic = 113 << 23;
+				bits += 1 << 23;
+				bits = std::bit_cast<std::uint32_t>(std::bit_cast<float>(bits) - std::bit_cast<float>(magic));
+			}
+			return std::bit_cast<float>(bits | static_cast<std::uint32_t>(value & 0x8000) << 16);
+		}
+
+		std::uint16_t floatToBFloat16(float value) noexcept
+		{
+			const std::uint32_t bits = std::bit_cast<std::uint32_t>(value);
+			if ((bits & 0x7FFFFFFF) > FLOAT_INFINITY)
+				return static_cast<std::uint16_t>((bits >> 16) | 0x40);	// keep NaNs quiet
+			return static_cast<std::uint16_t>((bits + 0x7FFF + ((bits >> 16) & 1)) >> 16);
+		}
+
+		float bfloat16ToFloat(std::uint16_t value) noexcept
+		{
+			return std::bit_cast<float>(static_cast<std::uint32_t>(value) << 16);
+		}
+
+		void checkSizes(size_t values, size_t results)
+		{
+			if (values != results)
+				throw std::invalid_argument("There must be one result for each value");
+		}
+	}
+
+	half::half(float value) noexcept
+		: bits(floatToHalf(value))
+	{
+	}
+
+	half::operator float() const noexcept
+	{
+		return halfToFloat(bits);
+	}
+
+	bfloat16::bfloat16(float value) noexcept
+		: bits(floatToBFloat16(value))
+	{
+	}
+
+	bfloat16::operator float() const noexcept
+	{
+		return bfloat16ToFloat(bits);
+	}
+
+	void convert(std::span<const float> values, std::span<half> result)
+	{
+		checkSizes(values.size(), result.size());
+		size_t i = 0;
+#ifdef MPN_F16C
+		for (; i + 8 <= values.size(); i += 8)
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&result[i]), _mm256_cvtps_ph(_mm256_loadu_ps(&values[i]), _MM_FROUND_TO_NEAREST_INT));
+#endif
+		for (; i < values.size(); ++i)
+			result[i] = half(values[i]);
+	}
+
+	void convert(std::span<const half> values, std::span<float> result)
+	{
+		checkSizes(values.size(), result.size());
+		size_t i = 0;
+#ifdef MPN_F16C
+		for (; i + 8 <= values.size(); i += 8)
+			_mm256_storeu_ps(&result[i], _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&values[i]))));
+#endif
+		for (; i < values.size(); ++i)
+			result[i] = float(values[i]);
+	}
+
+	void convert(std::span<const float> values, std::span<bfloat16> result)
+	{
+		checkSizes(values.size(), result.size());
+		size_t i = 0;
+#ifdef MPN_SSE2
+		const __m128i roundingBias = _mm_set1_epi32(0x7FFF), one = _mm_set1_epi32(1), quietBit = _mm_set1_epi32(0x400000);
+		for (; i + 4 <= values.size(); i += 4)
+		{
+			const __m128 floats = _mm_loadu_ps(&values[i]);
+			const __m128i bits = _mm_castps_si128(floats);
+			const __m128i odd = _mm_and_si128(_mm_srli_epi32(bits, 16), one);
+			const __m128i rounded = _mm_add_epi32(_mm_add_epi32(bits, roundingBias), odd);
+			const __m128i nan = _mm_castps_si128(_mm_cmpunord_ps(floats, floats));
+			const __m128i selected = _mm_or_si128(_mm_and_si128(nan, _mm_or_si128(bits, quietBit)), _mm_andnot_si128(nan, rounded));
+			// The arithmetic shift keeps the signed saturation of the pack from touching the upper halves
+			const __m128i upper = _mm_srai_epi32(selected, 16);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(&result[i]), _mm_packs_epi32(upper, upper));
+		}
+#endif
+		for (; i < values.size(); ++i)
+			result[i] = bfloat16(values[i]);
+	}
+
+	void convert(std::span<const bfloat16> values, std::span<float> result)
+	{
+		checkSizes(values.size(), result.size());
+		size_t i = 0;
+#ifdef MPN_SSE2
+		for (; i + 4 <= values.size(); i += 4)
+		{
+			const __m128i bits = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(&values[i]));
+			_mm_storeu_ps(&result[i], _mm_castsi128_ps(_mm_unpacklo_epi16(_mm_setzero_si128(), bits)));
+		}
+#endif
+		for (; i < values.size(); ++i)
+			result[i] = float(values[i]);
+	}
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+
+#include "point.h"
+#include "vector.h"
+
+namespace mpn {
+
+	/*IEEE 754 binary16 storage: 11 significant bits, finite up to 65504. Only for storage, convert to float
+	  for any math. Conversions round to nearest even, like the hardware ones.*/
+	struct half
+	{
+		std::uint16_t bits = 0;
+
+		half() = default;
+		explicit half(float value) noexcept;
+		explicit operator float() const noexcept;
+	};
+
+	/*The upper 16 bits of a float: the full float range with 8 significant bits.*/
+	struct bfloat16
+	{
+		std::uint16_t bits = 0;
+
+		bfloat16() = default;
+		explicit bfloat16(float value) noexcept;
+		explicit operator float() const noexcept;
+	};
+
+	/*Batch conversions, vectorized with F16C (half) or SSE2 (bfloat16) where available.
+	 Throws std::invalid_argument if the spans differ in length.*/
+	void convert(std::span<const float> values, std::span<half> result);
+	void convert(std::span<const half> values, std::span<float> result);
+	void convert(std::span<const float> values, std::span<bfloat16> result);
+	void convert(std::span<const bfloat16> values, std::span<float> result);
+
+	/*Vector3 stored in a 16 bit format (half or bfloat16), for normals, directions and other attributes
+	  where storage and bandwidth matter more than precision.*/
+	template<typename S>
+	struct PackedVector3
+	{
+		S v[3];
+
+		PackedVector3() = default;
+		explicit PackedVector3(const Vector3& vector) noexcept
+			: v{ S(vector[0]), S(vector[1]), S(vector[2]) }
+		{}
+
+		Vector3 unpack() const noexcept {
+			return Vector3(float(v[0]), float(v[1]), float(v[2]));
+		}
+	};
+
+	/*Point3 stored in a 16 bit format. Half precision keeps positions to about 1/2048 of their magnitude.*/
+	template<typename S>
+	struct PackedPoint3
+	{
+		S p[3];
+
+		PackedPoint3() = default;
+		explicit PackedPoint3(const Point3& point) noexcept
+			: p{ S(point[0]), S(point[1]), S(point[2]) }
+		{}
+
+		Point3 unpack() const noexcept {
+			return Point3(float(p[0]), float(p[1]), float(p[2]));
+		}
+	};
+
+	using HalfVector3 = PackedVector3<half>;
+	using HalfPoint3 = PackedPoint3<half>;
+	using BFloat16Vector3 = PackedVector3<bfloat16>;
+	using BFloat16Point3 = PackedPoint3<bfloat16>;
+
+	namespace packing {
+
+		constexpr size_t CHUNK = 64;	// items converted through a stack buffer at a time
+
+		inline float component(const Vector3& vector, int axis) noexcept { return vector[axis]; }
+		inline float component(const Point3& point, int axis) noexcept { return point[axis]; }
+		template<typename S>
+		S component(const PackedVector3<S>& vector, int axis) noexcept { return vector.v[axis]; }
+		template<typename S>
+		S component(const PackedPoint3<S>& point, int axis) noexcept { return point.p[axis]; }
+
+		inline void setComponent(Vector3& vector, int axis, float value) noexcept { vector[axis] = value; }
+		inline void setComponent(Point3& point, int axis, float value) noexcept { point[axis] = value; }
+		template<typename S>
+		void setComponent(PackedVector3<S>& vector, int axis, S value) noexcept { vector.v[axis] = value; }
+		template<typename S>
+		void setComponent(PackedPoint3<S>& point, int axis, S value) noexcept { point.p[axis] = value; }
+
+		// Batch converts the components of consecutive items from Source to Target, CHUNK items at a time
+		template<typename Source, typename Target, typename From, typename To>
+		void convertItems(std::span<const From> items, std::span<To> result)
+		{
+			if (items.size() != result.size())
+				throw std::invalid_argument("There must be one result for each item");
+			Source source[3 * CHUNK];
+			Target target[3 * CHUNK];
+			for (size_t first = 0; first < items.size(); first += CHUNK)
+			{
+				const size_t count = std::min(CHUNK, items.size() - first);
+				for (size_t i = 0; i < count; ++i)
+					for (int axis = 0; axis < 3; ++axis)
+						source[3 * i + axis] = component(items[first + i], axis);
+				convert(std::span<const Source>(source, 3 * count), std::span<Target>(target, 3 * count));
+				for (size_t i = 0; i < count; ++i)
+					for (int axis = 0; axis < 3; ++axis)
+						setComponent(result[first + i], axis, target[3 * i + axis]);
+			}
+		}
+	}
+
+	/*Batch packing and unpacking of vectors and points.
+	 Throws std::invalid_argument if the spans differ in length.*/
+	template<typename S>
+	void pack(std::span<const Vector3> vectors, std::span<PackedVector3<S>> result)
+	{
+		packing::convertItems<float, S>(vectors, result);
+	}
+
+	template<typename S>
+	void pack(std::span<const Point3> points, std::span<PackedPoint3<S>> result)
+	{
+		packing::convertItems<float, S>(points, result);
+	}
+
+	template<typename S>
+	void unpack(std::span<const PackedVector3<S>> vectors, std::span<Vector3> result)
+	{
+		packing::convertItems<S, float>(vectors, result);
+	}
+
+	template<typename S>
+	void unpack(std::span<const PackedPoint3<S>> points, std::span<Point3> result)
+	{
+		packing::convertItems<S, float>(points, result);
+	}
+
+	/*Sum of packed vectors, accumulated in double so long runs of small values are not lost to rounding.*/
+	template<typename S>
+	Vector<3, double> sum(std::span<const PackedVector3<S>> vectors)
+	{
+		Vector<3, double> result;
+		Vector3 unpacked[packing::CHUNK];
+		for (size_t first = 0; first < vectors.size(); first += packing::CHUNK)
+		{
+			const size_t count = std::min(packing::CHUNK, vectors.size() - first);
+			unpack(vectors.subspan(first, count), std::span<Vector3>(unpacked, count));
+			for (size_t i = 0; i < count; ++i)
+				for (int axis = 0; axis < 3; ++axis)
+					result[axis] += unpacked[i][axis];
+		}
+		return result;
+	}
+
+	/*Mean of packed points, accumulated in double. The origin if there are no points.*/
+	template<typename S>
+	Point3 centroid(std::span<const PackedPoint3<S>> points)
+	{
+		double total[3] = {};
+		Point3 unpacked[packing::CHUNK];
+		for (size_t first = 0; first < points.size(); first += packing::CHUNK)
+		{
+			const size_t count = std::min(packing::CHUNK, points.size() - first);
+			unpack(points.subspan(first, count), std::span<Point3>(unpacked, count));
+			for (size_t i = 0; i < count; ++i)
+				for (int axis = 0; axis < 3; ++axis)
+					total[axis] += unpacked[i][axis];
+		}
+		if (points.empty())
+			return Point3();
+		const double scale = 1.0 / double(points.size());
+		return Point3(float(total[0] * scale), float(total[1] * scale), float(total[2] * scale));
+	}
+}
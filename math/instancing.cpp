@@ -0,0 +1,56 @@
+#include "instancing.h"
+
+#include <stdexcept>
+
+namespace geom {
+
+	InstancedScene::InstancedScene(std::vector<Instance> _instances, int maxLeafSize)
+	{
+		std::vector<AABB> bounds;
+		bounds.reserve(_instances.size());
+		for (const Instance& instance : _instances)
+		{
+			if (instance.mesh == nullptr || instance.mesh->getBVH().empty())
+				throw std::invalid_argument("Instances must refer to a non-empty mesh");
+			bounds.push_back(instance.transform.transform(instance.mesh->getBounds()));
+		}
+
+		std::vector<std::uint32_t> order;
+		bvh = BVH(bounds, order, maxLeafSize);
+
+		instances.reserve(_instances.size());
+		for (std::uint32_t index : order)
+			instances.push_back(_instances[index]);
+	}
+
+	InstanceHit InstancedScene::intersect(const Line& line) const noexcept
+	{
+		InstanceHit hit;
+		hit.distance = bvh.intersect(line,
+			[this, &hit](std::uint32_t index, const Line& worldLine)
+			{
+				const Instance& instance = instances[index];
+				std::uint32_t triangle = 0;
+				const float distance = instance.mesh->intersect(instance.transform.inverseTransformLine(worldLine), &triangle);
+				// The hierarchy only reports the closest instance, the triangle has to be tracked here
+				if (distance >= 0.0f && (hit.distance < 0.0f || distance < hit.distance))
+				{
+					hit.distance = distance;
+					hit.triangle = triangle;
+				}
+				return distance;
+			},
+			&hit.instance);
+		return hit;
+	}
+
+	bool InstancedScene::occludes(const Line& line, float maxDistance) const noexcept
+	{
+		return bvh.occludes(line, maxDistance,
+			[this](std::uint32_t index, const Line& worldLine, float d)
+			{
+				const Instance& instance = instances[index];
+				return instance.mesh->occludes(instance.transform.inverseTransformLine(worldLine), d);
+			});
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "bvh.h"
+#include "mesh.h"
+#include "primitives.h"
+#include "transform.h"
+
+namespace geom {
+
+	/*Placement of a shared mesh in the world. The mesh is not owned and has to outlive the instance.*/
+	struct Instance
+	{
+		const TriangleMesh* mesh;
+		::mpn::Transform transform;
+	};
+
+	/*Hit record of an instanced scene query.*/
+	struct InstanceHit
+	{
+		float distance = INVALID_DISTANCE;
+		::std::uint32_t instance = 0;	// index into InstancedScene::getInstances()
+		::std::uint32_t triangle = 0;	// index into the mesh triangles of the instance
+	};
+
+	/*Two-level acceleration structure: a top-level hierarchy over transformed instances of
+	  bottom-level meshes. Lines are mapped into object space per instance, so a mesh is stored
+	  only once no matter how many times it is placed in the scene.
+	  Distances are measured in the parameter of the world space line, as the object space line
+	  is not renormalized.*/
+	class InstancedScene
+	{
+	public:
+		InstancedScene() = default;
+		explicit InstancedScene(::std::vector<Instance> instances, int maxLeafSize = 1);
+
+		/*Returns the closest hit, with distance INVALID_DISTANCE if nothing is hit.*/
+		InstanceHit intersect(const Line& line) const noexcept;
+
+		/*Occlusion query: checks whether anything is hit at a distance in [0, maxDistance].*/
+		bool occludes(const Line& line, float maxDistance) const noexcept;
+
+		const AABB& getBounds() const { return bvh.getBounds(); }
+		const BVH& getBVH() const noexcept { return bvh; }
+		const ::std::vector<Instance>& getInstances() const noexcept { return instances; }
+
+	private:
+		::std::vector<Instance> instances;
+		BVH bvh;
+	};
+}
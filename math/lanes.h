@@ -0,0 +1,422 @@
+#pragma once
+
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <ostream>
+#include <span>
+
+#include "matrix.h"
+#include "point.h"
+#include "simd.h"
+#include "vector.h"
+
+namespace mpn {
+
+	namespace lanes {
+
+		/*Operations on one hardware register of 'Width' floats. Masks are kept in float registers with
+		  every bit of a lane set or cleared, the way the SSE/AVX comparisons produce them.*/
+		template<int Width>
+		struct Register;
+
+		template<>
+		struct Register<1>
+		{
+			using Type = float;
+			static Type load(const float* values) noexcept { return *values; }
+			static void store(float* values, Type value) noexcept { *values = value; }
+			static Type broadcast(float value) noexcept { return value; }
+
+			static Type add(Type a, Type b) noexcept { return a + b; }
+			static Type subtract(Type a, Type b) noexcept { return a - b; }
+			static Type multiply(Type a, Type b) noexcept { return a * b; }
+			static Type divide(Type a, Type b) noexcept { return a / b; }
+			static Type minimum(Type a, Type b) noexcept { return b < a ? b : a; }
+			static Type maximum(Type a, Type b) noexcept { return a < b ? b : a; }
+			static Type sqrt(Type a) noexcept { return std::sqrt(a); }
+			static Type abs(Type a) noexcept { return std::abs(a); }
+
+			static Type mask(bool value) noexcept { return std::bit_cast<float>(value ? 0xFFFFFFFFu : 0u); }
+			static Type less(Type a, Type b) noexcept { return mask(a < b); }
+			static Type lessEqual(Type a, Type b) noexcept { return mask(a <= b); }
+			static Type equal(Type a, Type b) noexcept { return mask(a == b); }
+			static Type notEqual(Type a, Type b) noexcept { return mask(a != b); }
+
+			static Type bitAnd(Type a, Type b) noexcept { return std::bit_cast<float>(std::bit_cast<std::uint32_t>(a) & std::bit_cast<std::uint32_t>(b)); }
+			static Type bitOr(Type a, Type b) noexcept { return std::bit_cast<float>(std::bit_cast<std::uint32_t>(a) | std::bit_cast<std::uint32_t>(b)); }
+			static Type bitXor(Type a, Type b) noexcept { return std::bit_cast<float>(std::bit_cast<std::uint32_t>(a) ^ std::bit_cast<std::uint32_t>(b)); }
+			static Type select(Type mask, Type a, Type b) noexcept { return std::bit_cast<std::uint32_t>(mask) ? a : b; }
+			static int bits(Type mask) noexcept { return static_cast<int>(std::bit_cast<std::uint32_t>(mask) >> 31); }
+		};
+
+#ifdef MPN_SSE2
+		template<>
+		struct Register<4>
+		{
+			using Type = __m128;
+			static Type load(const float* values) noexcept { return _mm_load_ps(values); }
+			static void store(float* values, Type value) noexcept { _mm_store_ps(values, value); }
+			static Type broadcast(float value) noexcept { return _mm_set1_ps(value); }
+
+			static Type add(Type a, Type b) noexcept { return _mm_add_ps(a, b); }
+			static Type subtract(Type a, Type b) noexcept { return _mm_sub_ps(a, b); }
+			static Type multiply(Type a, Type b) noexcept { return _mm_mul_ps(a, b); }
+			static Type divide(Type a, Type b) noexcept { return _mm_div_ps(a, b); }
+			static Type minimum(Type a, Type b) noexcept { return _mm_min_ps(a, b); }
+			static Type maximum(Type a, Type b) noexcept { return _mm_max_ps(a, b); }
+			static Type sqrt(Type a) noexcept { return _mm_sqrt_ps(a); }
+			static Type abs(Type a) noexcept { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+
+			static Type less(Type a, Type b) noexcept { return _mm_cmplt_ps(a, b); }
+			static Type lessEqual(Type a, Type b) noexcept { return _mm_cmple_ps(a, b); }
+			static Type equal(Type a, Type b) noexcept { return _mm_cmpeq_ps(a, b); }
+			static Type notEqual(Type a, Type b) noexcept { return _mm_cmpneq_ps(a, b); }
+
+			static Type bitAnd(Type a, Type b) noexcept { return _mm_and_ps(a, b); }
+			static Type bitOr(Type a, Type b) noexcept { return _mm_or_ps(a, b); }
+			static Type bitXor(Type a, Type b) noexcept { return _mm_xor_ps(a, b); }
+			static Type select(Type mask, Type a, Type b) noexcept { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+			static int bits(Type mask) noexcept { return _mm_movemask_ps(mask); }
+		};
+#endif
+
+#ifdef MPN_AVX
+		template<>
+		struct Register<8>
+		{
+			using Type = __m256;
+			static Type load(const float* values) noexcept { return _mm256_load_ps(values); }
+			static void store(float* values, Type value) noexcept { _mm256_store_ps(values, value); }
+			static Type broadcast(float value) noexcept { return _mm256_set1_ps(value); }
+
+			static Type add(Type a, Type b) noexcept { return _mm256_add_ps(a, b); }
+			static Type subtract(Type a, Type b) noexcept { return _mm256_sub_ps(a, b); }
+			static Type multiply(Type a, Type b) noexcept { return _mm256_mul_ps(a, b); }
+			static Type divide(Type a, Type b) noexcept { return _mm256_div_ps(a, b); }
+			static Type minimum(Type a, Type b) noexcept { return _mm256_min_ps(a, b); }
+			static Type maximum(Type a, Type b) noexcept { return _mm256_max_ps(a, b); }
+			static Type sqrt(Type a) noexcept { return _mm256_sqrt_ps(a); }
+			static Type abs(Type a) noexcept { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+
+			static Type less(Type a, Type b) noexcept { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+			static Type lessEqual(Type a, Type b) noexcept { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+			static Type equal(Type a, Type b) noexcept { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+			static Type notEqual(Type a, Type b) noexcept { return _mm256_cmp_ps(a, b, _CMP_NEQ_UQ); }
+
+			static Type bitAnd(Type a, Type b) noexcept { return _mm256_and_ps(a, b); }
+			static Type bitOr(Type a, Type b) noexcept { return _mm256_or_ps(a, b); }
+			static Type bitXor(Type a, Type b) noexcept { return _mm256_xor_ps(a, b); }
+			static Type select(Type mask, Type a, Type b) noexcept { return _mm256_blendv_ps(b, a, mask); }
+			static int bits(Type mask) noexcept { return _mm256_movemask_ps(mask); }
+		};
+#endif
+
+		/*Widest register the lanes can be split into evenly.*/
+		template<int L>
+		constexpr int registerWidth() noexcept
+		{
+#ifdef MPN_AVX
+			if (L % 8 == 0)
+				return 8;
+#endif
+#ifdef MPN_SSE2
+			if (L % 4 == 0)
+				return 4;
+#endif
+			return 1;
+		}
+
+		/*Lanes of floats processed a register at a time, shared by floatN and maskN.*/
+		template<int L>
+		class Storage
+		{
+			static_assert(L > 0 && L <= 32, "The lane count must fit the mask bits");
+		protected:
+			static constexpr int WIDTH = registerWidth<L>();
+			using R = Register<WIDTH>;
+
+			template<typename Result, typename Operation>
+			static Result apply(const Storage& a, Operation&& operation) noexcept
+			{
+				Result result;
+				for (int i = 0; i < L; i += WIDTH)
+					R::store(result.v + i, operation(R::load(a.v + i)));
+				return result;
+			}
+
+			template<typename Result, typename Operation>
+			static Result apply(const Storage& a, const Storage& b, Operation&& operation) noexcept
+			{
+				Result result;
+				for (int i = 0; i < L; i += WIDTH)
+					R::store(result.v + i, operation(R::load(a.v + i), R::load(b.v + i)));
+				return result;
+			}
+
+			alignas(sizeof(float) * WIDTH) float v[L];
+		};
+	}
+
+	template<int L>
+	class floatN;
+
+	/*Result of comparing floatN lanes, one flag per lane.*/
+	template<int L>
+	class maskN : private lanes::Storage<L> {
+		using Base = lanes::Storage<L>;
+		using typename Base::R;
+		using Base::v;
+		friend Base;
+		friend class floatN<L>;
+	public:
+		maskN() = default;
+		explicit maskN(bool value) noexcept {
+			for (int i = 0; i < L; ++i)
+				v[i] = lanes::Register<1>::mask(value);
+		}
+
+		bool operator[](int lane) const noexcept {
+			assert(lane >= 0 && lane < L);
+			return lanes::Register<1>::bits(v[lane]) != 0;
+		}
+
+		/*Lane i in bit i.*/
+		std::uint32_t bits() const noexcept {
+			std::uint32_t result = 0;
+			for (int i = 0; i < L; i += Base::WIDTH)
+				result |= static_cast<std::uint32_t>(R::bits(R::load(v + i))) << i;
+			return result;
+		}
+
+		friend maskN operator&(const maskN& a, const maskN& b) noexcept { return Base::template apply<maskN>(a, b, R::bitAnd); }
+		friend maskN operator|(const maskN& a, const maskN& b) noexcept { return Base::template apply<maskN>(a, b, R::bitOr); }
+		friend maskN operator^(const maskN& a, const maskN& b) noexcept { return Base::template apply<maskN>(a, b, R::bitXor); }
+		friend maskN operator!(const maskN& a) noexcept { return a ^ maskN(true); }
+
+		friend bool any(const maskN& mask) noexcept { return mask.bits() != 0; }
+		friend bool all(const maskN& mask) noexcept { return mask.bits() == (L == 32 ? 0xFFFFFFFFu : (1u << L) - 1); }
+		friend bool none(const maskN& mask) noexcept { return mask.bits() == 0; }
+	};
+
+	/*L floats processed together with SIMD instructions, usable as the T of Vector, Point and Matrix:
+	  Vector<3, floatx8> holds eight vectors with their components in separate registers, so every
+	  operator on it handles all eight at once. Comparisons give a maskN, branches become select().*/
+	template<int L>
+	class floatN : private lanes::Storage<L> {
+		using Base = lanes::Storage<L>;
+		using typename Base::R;
+		using Base::v;
+		friend Base;
+	public:
+		static constexpr int LANES = L;
+
+		floatN() = default;
+		/*Same value in every lane.*/
+		floatN(float value) noexcept {
+			for (int i = 0; i < L; i += Base::WIDTH)
+				R::store(v + i, R::broadcast(value));
+		}
+
+		/*Lanes from L consecutive floats.*/
+		static floatN load(const float* values) noexcept {
+			floatN result;
+			for (int i = 0; i < L; ++i)
+				result.v[i] = values[i];
+			return result;
+		}
+		void store(float* values) const noexcept {
+			for (int i = 0; i < L; ++i)
+				values[i] = v[i];
+		}
+
+		float operator[](int lane) const noexcept {
+			assert(lane >= 0 && lane < L);
+			return v[lane];
+		}
+		float& operator[](int lane) noexcept {
+			assert(lane >= 0 && lane < L);
+			return v[lane];
+		}
+
+		floatN& operator+=(const floatN& rhs) noexcept { return *this = *this + rhs; }
+		floatN& operator-=(const floatN& rhs) noexcept { return *this = *this - rhs; }
+		floatN& operator*=(const floatN& rhs) noexcept { return *this = *this * rhs; }
+		floatN& operator/=(const floatN& rhs) noexcept { return *this = *this / rhs; }
+
+		friend floatN operator+(const floatN& a, const floatN& b) noexcept { return Base::template apply<floatN>(a, b, R::add); }
+		friend floatN operator-(const floatN& a, const floatN& b) noexcept { return Base::template apply<floatN>(a, b, R::subtract); }
+		friend floatN operator*(const floatN& a, const floatN& b) noexcept { return Base::template apply<floatN>(a, b, R::multiply); }
+		friend floatN operator/(const floatN& a, const floatN& b) noexcept { return Base::template apply<floatN>(a, b, R::divide); }
+		friend floatN operator-(const floatN& a) noexcept { return floatN(0.0f) - a; }
+
+		friend maskN<L> operator<(const floatN& a, const floatN& b) noexcept { return Base::template apply<maskN<L>>(a, b, R::less); }
+		friend maskN<L> operator<=(const floatN& a, const floatN& b) noexcept { return Base::template apply<maskN<L>>(a, b, R::lessEqual); }
+		friend maskN<L> operator>(const floatN& a, const floatN& b) noexcept { return b < a; }
+		friend maskN<L> operator>=(const floatN& a, const floatN& b) noexcept { return b <= a; }
+		friend maskN<L> operator==(const floatN& a, const floatN& b) noexcept { return Base::template apply<maskN<L>>(a, b, R::equal); }
+		friend maskN<L> operator!=(const floatN& a, const floatN& b) noexcept { return Base::template apply<maskN<L>>(a, b, R::notEqual); }
+
+		friend floatN sqrt(const floatN& a) noexcept { return Base::template apply<floatN>(a, R::sqrt); }
+		friend floatN abs(const floatN& a) noexcept { return Base::template apply<floatN>(a, R::abs); }
+		friend floatN min(const floatN& a, const floatN& b) noexcept { return Base::template apply<floatN>(a, b, R::minimum); }
+		friend floatN max(const floatN& a, const floatN& b) noexcept { return Base::template apply<floatN>(a, b, R::maximum); }
+
+		/*Lanes of 'a' where the mask is set, of 'b' elsewhere.*/
+		friend floatN select(const maskN<L>& mask, const floatN& a, const floatN& b) noexcept { return blend(mask, a, b); }
+
+		friend std::ostream& operator<<(std::ostream& out, const floatN& value) {
+			out << '[';
+			for (int i = 0; i < L; ++i)
+				out << (i > 0 ? "," : "") << value.v[i];
+			out << ']';
+			return out;
+		}
+
+	private:
+		static floatN blend(const maskN<L>& mask, const floatN& a, const floatN& b) noexcept {
+			floatN result;
+			for (int i = 0; i < L; i += Base::WIDTH)
+				R::store(result.v + i, R::select(R::load(mask.v + i), R::load(a.v + i), R::load(b.v + i)));
+			return result;
+		}
+	};
+
+	// Named by lane count with an x, floatx16 is sixteen floats and not a 16 bit float like half
+	using floatx4 = floatN<4>;
+	using floatx8 = floatN<8>;
+	using floatx16 = floatN<16>;
+	using maskx4 = maskN<4>;
+	using maskx8 = maskN<8>;
+	using maskx16 = maskN<16>;
+
+	/*Packs up to L vectors into the lanes, the missing lanes are zero.*/
+	template<int L, int N>
+	Vector<N, floatN<L>> packLanes(std::span<const Vector<N, float>> vectors) noexcept
+	{
+		assert(vectors.size() <= L);
+		Vector<N, floatN<L>> result;
+		for (size_t lane = 0; lane < vectors.size(); ++lane)
+			for (int i = 0; i < N; ++i)
+				result[i][static_cast<int>(lane)] = vectors[lane][i];
+		return result;
+	}
+
+	template<int L, int N>
+	Point<N, floatN<L>> packLanes(std::span<const Point<N, float>> points) noexcept
+	{
+		assert(points.size() <= L);
+		Point<N, floatN<L>> result;
+		for (size_t lane = 0; lane < points.size(); ++lane)
+			for (int i = 0; i < N; ++i)
+				result[i][static_cast<int>(lane)] = points[lane][i];
+		return result;
+	}
+
+	template<int L, int N>
+	Vector<N, float> extractLane(const Vector<N, floatN<L>>& vector, int lane) noexcept
+	{
+		Vector<N, float> result;
+		for (int i = 0; i < N; ++i)
+			result[i] = vector[i][lane];
+		return result;
+	}
+
+	template<int L, int N>
+	Point<N, float> extractLane(const Point<N, floatN<L>>& point, int lane) noexcept
+	{
+		Point<N, float> result;
+		for (int i = 0; i < N; ++i)
+			result[i] = point[i][lane];
+		return result;
+	}
+
+	/*Lanewise select of whole vectors and points.*/
+	template<int L, int N>
+	Vector<N, floatN<L>> select(const maskN<L>& mask, const Vector<N, floatN<L>>& a, const Vector<N, floatN<L>>& b) noexcept
+	{
+		Vector<N, floatN<L>> result;
+		for (int i = 0; i < N; ++i)
+			result[i] = select(mask, a[i], b[i]);
+		return result;
+	}
+
+	template<int L, int N>
+	Point<N, floatN<L>> select(const maskN<L>& mask, const Point<N, floatN<L>>& a, const Point<N, floatN<L>>& b) noexcept
+	{
+		Point<N, floatN<L>> result;
+		for (int i = 0; i < N; ++i)
+			result[i] = select(mask, a[i], b[i]);
+		return result;
+	}
+
+	/*Per lane scaling, the scalar overloads take a single float for every lane.*/
+	template<int L, int N>
+	Vector<N, floatN<L>> operator*(const Vector<N, floatN<L>>& lhs, const floatN<L>& rhs) noexcept
+	{
+		Vector<N, floatN<L>> result;
+		for (int i = 0; i < N; ++i)
+			result[i] = lhs[i] * rhs;
+		return result;
+	}
+
+	template<int L, int N>
+	Vector<N, floatN<L>> operator/(const Vector<N, floatN<L>>& lhs, const floatN<L>& rhs) noexcept
+	{
+		Vector<N, floatN<L>> result;
+		for (int i = 0; i < N; ++i)
+			result[i] = lhs[i] / rhs;
+		return result;
+	}
+
+	/*The same matrix applied to every lane, with the conventions of the scalar Point3/Vector3 products.*/
+	template<int L>
+	Point<3, floatN<L>> operator*(const Point<3, floatN<L>>& p, const Matrix4& m) noexcept
+	{
+		const floatN<L> multiplier = floatN<L>(1.0f) / (p[0] * m(0, 3) + p[1] * m(1, 3) + p[2] * m(2, 3) + m(3, 3));
+		return Point<3, floatN<L>>(
+			(p[0] * m(0, 0) + p[1] * m(1, 0) + p[2] * m(2, 0) + m(3, 0)) * multiplier,
+			(p[0] * m(0, 1) + p[1] * m(1, 1) + p[2] * m(2, 1) + m(3, 1)) * multiplier,
+			(p[0] * m(0, 2) + p[1] * m(1, 2) + p[2] * m(2, 2) + m(3, 2)) * multiplier);
+	}
+
+	template<int L>
+	Vector<3, floatN<L>> operator*(const Vector<3, floatN<L>>& p, const Matrix4& m) noexcept
+	{
+		const floatN<L> h = p[0] * m(0, 3) + p[1] * m(1, 3) + p[2] * m(2, 3);
+		const floatN<L> multiplier = select(h == 0.0f, floatN<L>(1.0f), floatN<L>(1.0f) / h);
+		return Vector<3, floatN<L>>(
+			(p[0] * m(0, 0) + p[1] * m(1, 0) + p[2] * m(2, 0)) * multiplier,
+			(p[0] * m(0, 1) + p[1] * m(1, 1) + p[2] * m(2, 1)) * multiplier,
+			(p[0] * m(0, 2) + p[1] * m(1, 2) + p[2] * m(2, 2)) * multiplier);
+	}
+
+	/*Comparisons with the tolerance of the scalar ones, true if every lane matches.*/
+	template<int L, int N>
+	bool operator==(const Vector<N, floatN<L>>& lhs, const Vector<N, floatN<L>>& rhs) noexcept
+	{
+		for (int i = 0; i < N; ++i)
+			if (any(abs(lhs[i] - rhs[i]) > 1e-5f))
+				return false;
+		return true;
+	}
+
+	template<int L, int N>
+	bool operator==(const Point<N, floatN<L>>& lhs, const Point<N, floatN<L>>& rhs) noexcept
+	{
+		for (int i = 0; i < N; ++i)
+			if (any(abs(lhs[i] - rhs[i]) > 1e-5f))
+				return false;
+		return true;
+	}
+
+	template<int L, int W, int H>
+	bool operator==(const Matrix<W, H, floatN<L>>& left, const Matrix<W, H, floatN<L>>& right) noexcept
+	{
+		for (int row = 0; row < H; ++row)
+			for (int column = 0; column < W; ++column)
+				if (any(abs(left(row, column) - right(row, column)) > 1e-5f))
+					return false;
+		return true;
+	}
+}
@@ -0,0 +1,305 @@
+#include "matrix.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "simd.h"
+
+namespace mpn {
+
+	void symmetricEigen(const Matrix3& matrix, Vector3& eigenvalues, Matrix3& eigenvectors) noexcept
+	{
+		double a[3][3], v[3][3];
+		for (int row = 0; row < 3; ++row)
+			for (int column = 0; column < 3; ++column)
+			{
+				a[row][column] = row <= column ? matrix(row, column) : matrix(column, row);
+				v[row][column] = row == column ? 1.0 : 0.0;
+			}
+
+		// Each rotation zeroes one off-diagonal element; a few sweeps bring all of them below rounding
+		for (int sweep = 0; sweep < 16; ++sweep)
+		{
+			const double off = a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2];
+			const double diagonal = a[0][0] * a[0][0] + a[1][1] * a[1][1] + a[2][2] * a[2][2];
+			if (off <= 1e-30 * diagonal || off == 0.0)
+				break;
+			for (int p = 0; p < 2; ++p)
+				for (int q = p + 1; q < 3; ++q)
+				{
+					if (a[p][q] == 0.0)
+						continue;
+					const double theta = (a[q][q] - a[p][p]) / (2.0 * a[p][q]);
+					const double t = (theta >= 0.0 ? 1.0 : -1.0) / (std::abs(theta) + std::sqrt(theta * theta + 1.0));
+					const double c = 1.0 / std::sqrt(t * t + 1.0);
+					const double s = t * c;
+					for (int k = 0; k < 3; ++k)
+					{
+						const double kp = a[k][p], kq = a[k][q];
+						a[k][p] = c * kp - s * kq;
+						a[k][q] = s * kp + c * kq;
+					}
+					for (int k = 0; k < 3; ++k)
+					{
+						const double pk = a[p][k], qk = a[q][k];
+						a[p][k] = c * pk - s * qk;
+						a[q][k] = s * pk + c * qk;
+					}
+					for (int k = 0; k < 3; ++k)
+					{
+						const double kp = v[k][p], kq = v[k][q];
+						v[k][p] = c * kp - s * kq;
+						v[k][q] = s * kp + c * kq;
+					}
+				}
+		}
+
+		int order[3] = { 0, 1, 2 };
+		std::sort(order, order + 3, [&a](int i, int j) { return a[i][i] > a[j][j]; });
+		for (int i = 0; i < 3; ++i)
+		{
+			eigenvalues[i] = static_cast<float>(a[order[i]][order[i]]);
+			for (int k = 0; k < 3; ++k)
+				eigenvectors(k, i) = static_cast<float>(v[k][order[i]]);
+		}
+		// Reordering may have mirrored the basis
+		const Vector3 first(eigenvectors(0, 0), eigenvectors(1, 0), eigenvectors(2, 0));
+		const Vector3 second(eigenvectors(0, 1), eigenvectors(1, 1), eigenvectors(2, 1));
+		const Vector3 third = first % second;
+		for (int k = 0; k < 3; ++k)
+			eigenvectors(k, 2) = third[k];
+	}
+
+	float determinant(const Matrix3& m) noexcept
+	{
+		return m(0, 0) * (m(1, 1) * m(2, 2) - m(2, 1) * m(1, 2))
+			- m(0, 1) * (m(1, 0) * m(2, 2) - m(2, 0) * m(1, 2))
+			+ m(0, 2) * (m(1, 0) * m(2, 1) - m(2, 0) * m(1, 1));
+	}
+
+	bool isSingular(float determinant) noexcept
+	{
+		return determinant == 0.0f || !std::isfinite(determinant) || !std::isfinite(1.0f / determinant);
+	}
+
+#ifdef MPN_SSE2
+	namespace {
+
+		template<int X, int Y, int Z, int W>
+		__m128 swizzle(__m128 v) noexcept
+		{
+			return _mm_shuffle_ps(v, v, _MM_SHUFFLE(W, Z, Y, X));
+		}
+
+		template<int X, int Y, int Z, int W>
+		__m128 shuffle(__m128 a, __m128 b) noexcept
+		{
+			return _mm_shuffle_ps(a, b, _MM_SHUFFLE(W, Z, Y, X));
+		}
+
+		// Products of 2x2 matrices stored row by row in a register; # is the adjugate
+		__m128 multiply2(__m128 a, __m128 b) noexcept	// A * B
+		{
+			return _mm_add_ps(_mm_mul_ps(a, swizzle<0, 3, 0, 3>(b)), _mm_mul_ps(swizzle<1, 0, 3, 2>(a), swizzle<2, 1, 2, 1>(b)));
+		}
+
+		__m128 adjugateMultiply2(__m128 a, __m128 b) noexcept	// A# * B
+		{
+			return _mm_sub_ps(_mm_mul_ps(swizzle<3, 3, 0, 0>(a), b), _mm_mul_ps(swizzle<1, 1, 2, 2>(a), swizzle<2, 3, 0, 1>(b)));
+		}
+
+		__m128 multiplyAdjugate2(__m128 a, __m128 b) noexcept	// A * B#
+		{
+			return _mm_sub_ps(_mm_mul_ps(a, swizzle<3, 0, 3, 0>(b)), _mm_mul_ps(swizzle<1, 0, 3, 2>(a), swizzle<2, 1, 2, 1>(b)));
+		}
+
+		// 2x2 block terms of a matrix, shared by the determinant and the inverse.
+		// The columns are loaded as rows, which works on the transpose: same determinant, transposed inverse.
+		// Blocks of the matrix: | A B |
+		//                       | C D |
+		struct BlockTerms
+		{
+			__m128 a, b, c, d;
+			__m128 detA, detB, detC, detD;	// broadcast block determinants
+			__m128 ab, dc;					// A# B and D# C
+			__m128 det;						// broadcast determinant of the matrix
+		};
+
+		BlockTerms blockTerms(const Matrix4& matrix) noexcept
+		{
+			BlockTerms terms;
+			const float* data = matrix.data();
+			const __m128 row0 = _mm_loadu_ps(data), row1 = _mm_loadu_ps(data + 4), row2 = _mm_loadu_ps(data + 8), row3 = _mm_loadu_ps(data + 12);
+			terms.a = _mm_movelh_ps(row0, row1);
+			terms.b = _mm_movehl_ps(row1, row0);
+			terms.c = _mm_movelh_ps(row2, row3);
+			terms.d = _mm_movehl_ps(row3, row2);
+
+			// Determinants of the blocks as (|A| |B| |C| |D|)
+			const __m128 blockDeterminants = _mm_sub_ps(
+				_mm_mul_ps(shuffle<0, 2, 0, 2>(row0, row2), shuffle<1, 3, 1, 3>(row1, row3)),
+				_mm_mul_ps(shuffle<1, 3, 1, 3>(row0, row2), shuffle<0, 2, 0, 2>(row1, row3)));
+			terms.detA = swizzle<0, 0, 0, 0>(blockDeterminants);
+			terms.detB = swizzle<1, 1, 1, 1>(blockDeterminants);
+			terms.detC = swizzle<2, 2, 2, 2>(blockDeterminants);
+			terms.detD = swizzle<3, 3, 3, 3>(blockDeterminants);
+
+			terms.dc = adjugateMultiply2(terms.d, terms.c);
+			terms.ab = adjugateMultiply2(terms.a, terms.b);
+
+			// |M| = |A| |D| + |B| |C| - tr((A# B) (D# C))
+			__m128 trace = _mm_mul_ps(terms.ab, swizzle<0, 2, 1, 3>(terms.dc));
+			trace = _mm_add_ps(trace, swizzle<2, 3, 0, 1>(trace));
+			trace = _mm_add_ps(trace, swizzle<1, 0, 3, 2>(trace));
+			terms.det = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(terms.detA, terms.detD), _mm_mul_ps(terms.detB, terms.detC)), trace);
+			return terms;
+		}
+	}
+
+	float determinant(const Matrix4& matrix) noexcept
+	{
+		return _mm_cvtss_f32(blockTerms(matrix).det);
+	}
+
+	bool inverse(const Matrix4& matrix, Matrix4& result) noexcept
+	{
+		const BlockTerms t = blockTerms(matrix);
+		if (isSingular(_mm_cvtss_f32(t.det)))
+			return false;
+
+		// Adjugates of the blocks of the inverse times |M|
+		__m128 x = _mm_sub_ps(_mm_mul_ps(t.detD, t.a), multiply2(t.b, t.dc));
+		__m128 w = _mm_sub_ps(_mm_mul_ps(t.detA, t.d), multiply2(t.c, t.ab));
+		__m128 y = _mm_sub_ps(_mm_mul_ps(t.detB, t.c), multiplyAdjugate2(t.d, t.ab));
+		__m128 z = _mm_sub_ps(_mm_mul_ps(t.detC, t.b), multiplyAdjugate2(t.a, t.dc));
+
+		const __m128 reciprocal = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), t.det);
+		x = _mm_mul_ps(x, reciprocal);
+		y = _mm_mul_ps(y, reciprocal);
+		z = _mm_mul_ps(z, reciprocal);
+		w = _mm_mul_ps(w, reciprocal);
+
+		// Undo the adjugates while storing
+		float inverted[16];
+		_mm_storeu_ps(inverted, shuffle<3, 1, 3, 1>(x, y));
+		_mm_storeu_ps(inverted + 4, shuffle<2, 0, 2, 0>(x, y));
+		_mm_storeu_ps(inverted + 8, shuffle<3, 1, 3, 1>(z, w));
+		_mm_storeu_ps(inverted + 12, shuffle<2, 0, 2, 0>(z, w));
+		result = Matrix4(inverted);
+		return true;
+	}
+#else
+	float determinant(const Matrix4& m) noexcept
+	{
+		// Laplace expansion along the 2x2 minors of the first two rows and their complements
+		const float s0 = m(0, 0) * m(1, 1) - m(1, 0) * m(0, 1);
+		const float s1 = m(0, 0) * m(1, 2) - m(1, 0) * m(0, 2);
+		const float s2 = m(0, 0) * m(1, 3) - m(1, 0) * m(0, 3);
+		const float s3 = m(0, 1) * m(1, 2) - m(1, 1) * m(0, 2);
+		const float s4 = m(0, 1) * m(1, 3) - m(1, 1) * m(0, 3);
+		const float s5 = m(0, 2) * m(1, 3) - m(1, 2) * m(0, 3);
+		const float c0 = m(2, 0) * m(3, 1) - m(3, 0) * m(2, 1);
+		const float c1 = m(2, 0) * m(3, 2) - m(3, 0) * m(2, 2);
+		const float c2 = m(2, 0) * m(3, 3) - m(3, 0) * m(2, 3);
+		const float c3 = m(2, 1) * m(3, 2) - m(3, 1) * m(2, 2);
+		const float c4 = m(2, 1) * m(3, 3) - m(3, 1) * m(2, 3);
+		const float c5 = m(2, 2) * m(3, 3) - m(3, 2) * m(2, 3);
+		return s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+	}
+
+	bool inverse(const Matrix4& m, Matrix4& result) noexcept
+	{
+		// Cofactors from the same 2x2 minors as determinant()
+		const float s0 = m(0, 0) * m(1, 1) - m(1, 0) * m(0, 1);
+		const float s1 = m(0, 0) * m(1, 2) - m(1, 0) * m(0, 2);
+		const float s2 = m(0, 0) * m(1, 3) - m(1, 0) * m(0, 3);
+		const float s3 = m(0, 1) * m(1, 2) - m(1, 1) * m(0, 2);
+		const float s4 = m(0, 1) * m(1, 3) - m(1, 1) * m(0, 3);
+		const float s5 = m(0, 2) * m(1, 3) - m(1, 2) * m(0, 3);
+		const float c0 = m(2, 0) * m(3, 1) - m(3, 0) * m(2, 1);
+		const float c1 = m(2, 0) * m(3, 2) - m(3, 0) * m(2, 2);
+		const float c2 = m(2, 0) * m(3, 3) - m(3, 0) * m(2, 3);
+		const float c3 = m(2, 1) * m(3, 2) - m(3, 1) * m(2, 2);
+		const float c4 = m(2, 1) * m(3, 3) - m(3, 1) * m(2, 3);
+		const float c5 = m(2, 2) * m(3, 3) - m(3, 2) * m(2, 3);
+		const float det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+		if (isSingular(det))
+			return false;
+		const float r = 1.0f / det;
+
+		result = Matrix4(
+			(m(1, 1) * c5 - m(1, 2) * c4 + m(1, 3) * c3) * r, (-m(0, 1) * c5 + m(0, 2) * c4 - m(0, 3) * c3) * r,
+			(m(3, 1) * s5 - m(3, 2) * s4 + m(3, 3) * s3) * r, (-m(2, 1) * s5 + m(2, 2) * s4 - m(2, 3) * s3) * r,
+			(-m(1, 0) * c5 + m(1, 2) * c2 - m(1, 3) * c1) * r, (m(0, 0) * c5 - m(0, 2) * c2 + m(0, 3) * c1) * r,
+			(-m(3, 0) * s5 + m(3, 2) * s2 - m(3, 3) * s1) * r, (m(2, 0) * s5 - m(2, 2) * s2 + m(2, 3) * s1) * r,
+			(m(1, 0) * c4 - m(1, 1) * c2 + m(1, 3) * c0) * r, (-m(0, 0) * c4 + m(0, 1) * c2 - m(0, 3) * c0) * r,
+			(m(3, 0) * s4 - m(3, 1) * s2 + m(3, 3) * s0) * r, (-m(2, 0) * s4 + m(2, 1) * s2 - m(2, 3) * s0) * r,
+			(-m(1, 0) * c3 + m(1, 1) * c1 - m(1, 2) * c0) * r, (m(0, 0) * c3 - m(0, 1) * c1 + m(0, 2) * c0) * r,
+			(-m(3, 0) * s3 + m(3, 1) * s1 - m(3, 2) * s0) * r, (m(2, 0) * s3 - m(2, 1) * s1 + m(2, 2) * s0) * r);
+		return true;
+	}
+#endif
+
+	bool inverse(const Matrix3& m, Matrix3& result) noexcept
+	{
+		// Adjugate over the determinant
+		const float cofactor00 = m(1, 1) * m(2, 2) - m(2, 1) * m(1, 2);
+		const float cofactor01 = m(1, 2) * m(2, 0) - m(1, 0) * m(2, 2);
+		const float cofactor02 = m(1, 0) * m(2, 1) - m(2, 0) * m(1, 1);
+		const float det = m(0, 0) * cofactor00 + m(0, 1) * cofactor01 + m(0, 2) * cofactor02;
+		if (isSingular(det))
+			return false;
+		const float r = 1.0f / det;
+
+		result(0, 0) = cofactor00 * r;
+		result(0, 1) = (m(0, 2) * m(2, 1) - m(0, 1) * m(2, 2)) * r;
+		result(0, 2) = (m(0, 1) * m(1, 2) - m(0, 2) * m(1, 1)) * r;
+		result(1, 0) = cofactor01 * r;
+		result(1, 1) = (m(0, 0) * m(2, 2) - m(0, 2) * m(2, 0)) * r;
+		result(1, 2) = (m(1, 0) * m(0, 2) - m(0, 0) * m(1, 2)) * r;
+		result(2, 0) = cofactor02 * r;
+		result(2, 1) = (m(2, 0) * m(0, 1) - m(0, 0) * m(2, 1)) * r;
+		result(2, 2) = (m(0, 0) * m(1, 1) - m(1, 0) * m(0, 1)) * r;
+		return true;
+	}
+
+	namespace {
+
+		Matrix3 linearPart(const Matrix4& matrix) noexcept
+		{
+			Matrix3 result;
+			for (int row = 0; row < 3; ++row)
+				for (int column = 0; column < 3; ++column)
+					result(row, column) = matrix(row, column);
+			return result;
+		}
+	}
+
+	bool affineInverse(const Matrix4& matrix, Matrix4& result) noexcept
+	{
+		// | L 0 |^-1   |  L^-1     0 |
+		// | t 1 |    = | -t L^-1   1 |
+		Matrix3 linear;
+		if (!inverse(linearPart(matrix), linear))
+			return false;
+
+		Matrix4 inverted;
+		for (int row = 0; row < 3; ++row)
+			for (int column = 0; column < 3; ++column)
+				inverted(row, column) = linear(row, column);
+		for (int column = 0; column < 3; ++column)
+			inverted(3, column) = -(matrix(3, 0) * linear(0, column) + matrix(3, 1) * linear(1, column) + matrix(3, 2) * linear(2, column));
+		inverted(3, 3) = 1.0f;
+		result = inverted;
+		return true;
+	}
+
+	bool normalMatrix(const Matrix4& matrix, Matrix3& result) noexcept
+	{
+		Matrix3 linear;
+		if (!inverse(linearPart(matrix), linear))
+			return false;
+		result = linear.asTransposed();
+		return true;
+	}
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 
+#include "counters.h"
 #include "vector.h"
 #include "point.h"
 
@@ -19,20 +20,21 @@ namespace mpn {
 			for (int i = 0; i < _arraySize; ++i)
 				this->m[i] = T(0);
 		}
-		constexpr Matrix(const Matrix<W, H, T>& m) {
-			for (int i = 0; i < _arraySize; ++i)
-				this->m[i] = m.m[i];
-		}
-		constexpr explicit Matrix(T _m[_arraySize]) {
+		constexpr explicit Matrix(const T _m[_arraySize]) {
 			for (int i = 0; i < _arraySize; ++i)
 				this->m[i] = _m[i];
 		}
 
-		template<typename std::enable_if<_arraySize == 16>::type * = nullptr>
+		template<int S = _arraySize, typename std::enable_if<S == 16>::type * = nullptr>
 		constexpr Matrix(T m00, T m01, T m02, T m03, T m10, T m11, T m12, T m13, T m20, T m21, T m22, T m23, T m30, T m31, T m32, T m33)
 			: m{ m00, m10, m20, m30, m01, m11, m21, m31, m02, m12, m22, m32, m03, m13, m23, m33 }
 		{}
 
+		template<int S = _arraySize, typename std::enable_if<S == 9>::type * = nullptr>
+		constexpr Matrix(T m00, T m01, T m02, T m10, T m11, T m12, T m20, T m21, T m22)
+			: m{ m00, m10, m20, m01, m11, m21, m02, m12, m22 }
+		{}
+
 
 		constexpr T operator()(int row, int column) const {
 			assert(row >= 0 && row < H && column >= 0 && column < W);
@@ -62,6 +64,9 @@ namespace mpn {
 	using Matrix4 = Matrix<4, 4, float>;
 	using Matrix3 = Matrix<3, 3, float>;
 
+	static_assert(std::is_trivially_copyable_v<Matrix4> && std::is_standard_layout_v<Matrix4>, "Matrices must be copyable as raw memory");
+	static_assert(sizeof(Matrix4) == 16 * sizeof(float) && sizeof(Matrix3) == 9 * sizeof(float), "Matrices must be laid out as plain float arrays");
+
 	constexpr const Matrix4 identityMatrix(1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f);
 
 	template<int W, int H, typename T>
@@ -104,19 +109,20 @@ namespace mpn {
 
 	template<int W, int H, typename T>
 	constexpr Matrix<W, H, T> operator*(const Matrix<W, H, T>& lhs, const Matrix<W, H, T>& rhs) {
+		count(Counter::MatrixMultiplies);
 		T res[W*H];
-		for (int r = 0; r < 4; ++r)
-			for (int c = 0; c < 4; ++c) {
-				res[r + c*W] = T(0);
-				for (int k = 0; k < 4; ++k)
-					res[r + c*W] += lhs(r, k)*rhs(k, c);
+		for (int r = 0; r < H; ++r)
+			for (int c = 0; c < W; ++c) {
+				res[r + c*H] = T(0);
+				for (int k = 0; k < W; ++k)
+					res[r + c*H] += lhs(r, k)*rhs(k, c);
 			}
 		return Matrix<W, H, T>(res);
 	}
 
 	template<int W, int H, typename T>
 	constexpr Vector<H, T> operator*(const Vector<H, T>& v, const Matrix<W, H, T>& m) {
-		T result[H];
+		T result[H] = {};
 		for (int i = 0; i < H; ++i)
 			for (int j = 0; j < W; ++j)
 				result[i] += v[j] * m(j, i);
@@ -126,7 +132,7 @@ namespace mpn {
 
 	template<int W, int H, typename T>
 	constexpr Point<H, T> operator*(const Point<H, T>& p, const Matrix<W, H, T>& m) {
-		T result[H];
+		T result[H] = {};
 		for (int i = 0; i < H; ++i)
 			for (int j = 0; j < W; ++j)
 				result[i] += p[j] * m(j, i);
@@ -170,6 +176,36 @@ namespace mpn {
 				matrix(row, col) = row == col ? T(1) : T(0);
 	}
 
+	/*Eigen decomposition of a symmetric matrix by cyclic Jacobi rotations, which converge quadratically
+	  and are accurate for the small eigenvalues as well. Only the upper triangle is read.
+	 - eigenvalues: in decreasing order.
+	 - eigenvectors: unit eigenvectors in the matching columns, forming a rotation (right-handed).*/
+	void symmetricEigen(const Matrix3& matrix, Vector3& eigenvalues, Matrix3& eigenvectors) noexcept;
+
+	/*Determinants, by 2x2 minors.*/
+	float determinant(const Matrix4& matrix) noexcept;
+	float determinant(const Matrix3& matrix) noexcept;
+
+	/*Checks whether a matrix with the given determinant is treated as singular: the determinant is zero,
+	  not finite, or its reciprocal is not finite.*/
+	bool isSingular(float determinant) noexcept;
+
+	/*Inverts the matrix by the block (2x2 adjugate) method, vectorized with SSE.
+	  Returns false and leaves 'result' untouched if the matrix is singular.*/
+	bool inverse(const Matrix4& matrix, Matrix4& result) noexcept;
+	bool inverse(const Matrix3& matrix, Matrix3& result) noexcept;
+
+	/*Inverts an affine matrix: a linear part in the upper 3x3 and a translation in the last row, which the
+	  row vectors it is applied to take on last. The last column is taken to be (0, 0, 0, 1) and not read.
+	  Only the 3x3 part is inverted, several times cheaper than inverse().
+	  Returns false and leaves 'result' untouched if the linear part is singular.*/
+	bool affineInverse(const Matrix4& matrix, Matrix4& result) noexcept;
+
+	/*Matrix transforming the normals of surfaces transformed by 'matrix': the inverse transpose of its
+	  upper 3x3, so normals stay perpendicular under non-uniform scaling. Not normalized.
+	  Returns false and leaves 'result' untouched if the 3x3 part is singular.*/
+	bool normalMatrix(const Matrix4& matrix, Matrix3& result) noexcept;
+
 	template<int W, int H, typename T>
 	std::ostream& operator<<(std::ostream& out, const Matrix<W, H, T>& matrix) {
 		out << '(';
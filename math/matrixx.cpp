@@ -0,0 +1,316 @@
+#include "matrixx.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "parallel.h"
+#include "simd.h"
+
+namespace mpn {
+
+	MatrixX::MatrixX(int rows, int columns)
+		: rows(rows), columns(columns)
+	{
+		if (rows < 0 || columns < 0)
+			throw std::invalid_argument("The matrix size cannot be negative");
+		m.assign(static_cast<std::size_t>(rows) * columns, 0.0f);
+	}
+
+	MatrixX MatrixX::identity(int size)
+	{
+		MatrixX result(size, size);
+		for (int i = 0; i < size; ++i)
+			result(i, i) = 1.0f;
+		return result;
+	}
+
+	MatrixX MatrixX::asTransposed() const
+	{
+		MatrixX result(columns, rows);
+		for (int column = 0; column < columns; ++column)
+			for (int row = 0; row < rows; ++row)
+				result(column, row) = (*this)(row, column);
+		return result;
+	}
+
+	namespace {
+
+		// Register block of the kernel: MR rows (whole SIMD registers) by NR columns of accumulators
+#if defined(MPN_AVX)
+		constexpr int MR = 16, NR = 6;
+#elif defined(MPN_SSE2)
+		constexpr int MR = 8, NR = 4;
+#else
+		constexpr int MR = 4, NR = 4;
+#endif
+		// Cache blocks: a packed MC x KC panel of lhs stays in L2, a KC x NR sliver of rhs in L1
+		constexpr int MC = 96, KC = 256, NC = 192;
+		static_assert(MC % MR == 0 && NC % NR == 0, "The cache blocks must hold whole register blocks");
+
+		using PackBuffer = std::vector<float, AlignedAllocator<float, MatrixX::ALIGNMENT>>;
+
+		// Rows [row, row + rowCount) of columns [depth, depth + depthCount), as MR row slivers stored
+		// depth after depth, zero padded to whole slivers
+		void packLeft(const MatrixX& matrix, int row, int rowCount, int depth, int depthCount, float* packed) noexcept
+		{
+			const float* source = matrix.data();
+			const std::size_t stride = matrix.getRows();
+			for (int sliver = 0; sliver < rowCount; sliver += MR)
+			{
+				const int count = std::min(MR, rowCount - sliver);
+				for (int k = 0; k < depthCount; ++k)
+				{
+					const float* column = source + (depth + k) * stride + row + sliver;
+					int i = 0;
+					for (; i < count; ++i)
+						packed[i] = column[i];
+					for (; i < MR; ++i)
+						packed[i] = 0.0f;
+					packed += MR;
+				}
+			}
+		}
+
+		// Rows [depth, depth + depthCount) of columns [column, column + columnCount), as NR column slivers
+		// stored depth after depth, zero padded to whole slivers
+		void packRight(const MatrixX& matrix, int depth, int depthCount, int column, int columnCount, float* packed) noexcept
+		{
+			const float* source = matrix.data();
+			const std::size_t stride = matrix.getRows();
+			for (int sliver = 0; sliver < columnCount; sliver += NR)
+			{
+				const int count = std::min(NR, columnCount - sliver);
+				for (int k = 0; k < depthCount; ++k)
+				{
+					int j = 0;
+					for (; j < count; ++j)
+						packed[j] = source[(column + sliver + j) * stride + depth + k];
+					for (; j < NR; ++j)
+						packed[j] = 0.0f;
+					packed += NR;
+				}
+			}
+		}
+
+		// Adds the MR x NR block (column-major) to the 'rows' x 'columns' corner of the result
+		void accumulateEdge(const float* block, float* result, std::size_t stride, int rows, int columns) noexcept
+		{
+			for (int j = 0; j < columns; ++j)
+				for (int i = 0; i < rows; ++i)
+					result[i + j * stride] += block[i + j * MR];
+		}
+
+		// result += packed left sliver * packed right sliver
+#if defined(MPN_AVX)
+		inline __m256 multiplyAdd(__m256 a, __m256 b, __m256 c) noexcept
+		{
+#ifdef MPN_FMA
+			return _mm256_fmadd_ps(a, b, c);
+#else
+			return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+		}
+
+		// The accumulators are spelled out, compilers do not reliably unroll a loop over them into registers
+		void kernel(int depth, const float* left, const float* right, float* result, std::size_t stride, int rows, int columns) noexcept
+		{
+			static_assert(MR == 16 && NR == 6, "The kernel holds a 16 x 6 block");
+			__m256 c00 = _mm256_setzero_ps(), c01 = c00, c02 = c00, c03 = c00, c04 = c00, c05 = c00;
+			__m256 c10 = c00, c11 = c00, c12 = c00, c13 = c00, c14 = c00, c15 = c00;
+			for (int k = 0; k < depth; ++k)
+			{
+				const __m256 a0 = _mm256_load_ps(left);
+				const __m256 a1 = _mm256_load_ps(left + 8);
+				__m256 b = _mm256_broadcast_ss(right);
+				c00 = multiplyAdd(a0, b, c00);
+				c10 = multiplyAdd(a1, b, c10);
+				b = _mm256_broadcast_ss(right + 1);
+				c01 = multiplyAdd(a0, b, c01);
+				c11 = multiplyAdd(a1, b, c11);
+				b = _mm256_broadcast_ss(right + 2);
+				c02 = multiplyAdd(a0, b, c02);
+				c12 = multiplyAdd(a1, b, c12);
+				b = _mm256_broadcast_ss(right + 3);
+				c03 = multiplyAdd(a0, b, c03);
+				c13 = multiplyAdd(a1, b, c13);
+				b = _mm256_broadcast_ss(right + 4);
+				c04 = multiplyAdd(a0, b, c04);
+				c14 = multiplyAdd(a1, b, c14);
+				b = _mm256_broadcast_ss(right + 5);
+				c05 = multiplyAdd(a0, b, c05);
+				c15 = multiplyAdd(a1, b, c15);
+				left += MR;
+				right += NR;
+			}
+
+			const __m256 upper[NR] = { c00, c01, c02, c03, c04, c05 };
+			const __m256 lower[NR] = { c10, c11, c12, c13, c14, c15 };
+			if (rows == MR && columns == NR)
+			{
+				for (int j = 0; j < NR; ++j)
+				{
+					float* column = result + j * stride;
+					_mm256_storeu_ps(column, _mm256_add_ps(_mm256_loadu_ps(column), upper[j]));
+					_mm256_storeu_ps(column + 8, _mm256_add_ps(_mm256_loadu_ps(column + 8), lower[j]));
+				}
+				return;
+			}
+			alignas(32) float block[MR * NR];
+			for (int j = 0; j < NR; ++j)
+			{
+				_mm256_store_ps(block + j * MR, upper[j]);
+				_mm256_store_ps(block + j * MR + 8, lower[j]);
+			}
+			accumulateEdge(block, result, stride, rows, columns);
+		}
+#elif defined(MPN_SSE2)
+		void kernel(int depth, const float* left, const float* right, float* result, std::size_t stride, int rows, int columns) noexcept
+		{
+			static_assert(MR == 8 && NR == 4, "The kernel holds an 8 x 4 block");
+			__m128 c00 = _mm_setzero_ps(), c01 = c00, c02 = c00, c03 = c00;
+			__m128 c10 = c00, c11 = c00, c12 = c00, c13 = c00;
+			for (int k = 0; k < depth; ++k)
+			{
+				const __m128 a0 = _mm_load_ps(left);
+				const __m128 a1 = _mm_load_ps(left + 4);
+				__m128 b = _mm_set1_ps(right[0]);
+				c00 = _mm_add_ps(_mm_mul_ps(a0, b), c00);
+				c10 = _mm_add_ps(_mm_mul_ps(a1, b), c10);
+				b = _mm_set1_ps(right[1]);
+				c01 = _mm_add_ps(_mm_mul_ps(a0, b), c01);
+				c11 = _mm_add_ps(_mm_mul_ps(a1, b), c11);
+				b = _mm_set1_ps(right[2]);
+				c02 = _mm_add_ps(_mm_mul_ps(a0, b), c02);
+				c12 = _mm_add_ps(_mm_mul_ps(a1, b), c12);
+				b = _mm_set1_ps(right[3]);
+				c03 = _mm_add_ps(_mm_mul_ps(a0, b), c03);
+				c13 = _mm_add_ps(_mm_mul_ps(a1, b), c13);
+				left += MR;
+				right += NR;
+			}
+
+			const __m128 upper[NR] = { c00, c01, c02, c03 };
+			const __m128 lower[NR] = { c10, c11, c12, c13 };
+			if (rows == MR && columns == NR)
+			{
+				for (int j = 0; j < NR; ++j)
+				{
+					float* column = result + j * stride;
+					_mm_storeu_ps(column, _mm_add_ps(_mm_loadu_ps(column), upper[j]));
+					_mm_storeu_ps(column + 4, _mm_add_ps(_mm_loadu_ps(column + 4), lower[j]));
+				}
+				return;
+			}
+			alignas(16) float block[MR * NR];
+			for (int j = 0; j < NR; ++j)
+			{
+				_mm_store_ps(block + j * MR, upper[j]);
+				_mm_store_ps(block + j * MR + 4, lower[j]);
+			}
+			accumulateEdge(block, result, stride, rows, columns);
+		}
+#else
+		void kernel(int depth, const float* left, const float* right, float* result, std::size_t stride, int rows, int columns) noexcept
+		{
+			float block[MR * NR] = {};
+			for (int k = 0; k < depth; ++k)
+			{
+				for (int j = 0; j < NR; ++j)
+					for (int i = 0; i < MR; ++i)
+						block[i + j * MR] += left[i] * right[j];
+				left += MR;
+				right += NR;
+			}
+			accumulateEdge(block, result, stride, rows, columns);
+		}
+#endif
+	}
+
+	void multiply(const MatrixX& lhs, const MatrixX& rhs, MatrixX& result, int threadCount)
+	{
+		if (lhs.getColumns() != rhs.getRows())
+			throw std::invalid_argument("The columns of the left matrix must match the rows of the right one");
+		count(Counter::MatrixMultiplies);
+
+		const int rows = lhs.getRows(), columns = rhs.getColumns(), depth = lhs.getColumns();
+		MatrixX product(rows, columns);
+		const int rowTiles = (rows + MC - 1) / MC;
+		const int tileCount = rowTiles * ((columns + NC - 1) / NC);
+		if (depth == 0 || tileCount == 0)
+		{
+			result = std::move(product);
+			return;
+		}
+
+		// Each tile of the result is owned by one worker, which packs its own panels
+		float* const target = product.data();
+		const std::size_t stride = rows;
+		std::atomic<int> nextTile{ 0 };
+		auto worker = [&]()
+		{
+			PackBuffer packedLeft(MC * KC), packedRight(KC * NC);
+			for (int tile = nextTile++; tile < tileCount; tile = nextTile++)
+			{
+				const int row = (tile % rowTiles) * MC, column = (tile / rowTiles) * NC;
+				const int rowCount = std::min(MC, rows - row), columnCount = std::min(NC, columns - column);
+				for (int k = 0; k < depth; k += KC)
+				{
+					const int depthCount = std::min(KC, depth - k);
+					packRight(rhs, k, depthCount, column, columnCount, packedRight.data());
+					packLeft(lhs, row, rowCount, k, depthCount, packedLeft.data());
+					for (int j = 0; j < columnCount; j += NR)
+						for (int i = 0; i < rowCount; i += MR)
+							kernel(depthCount, packedLeft.data() + i * depthCount, packedRight.data() + j * depthCount,
+								target + (row + i) + (column + j) * stride, stride,
+								std::min(MR, rowCount - i), std::min(NR, columnCount - j));
+				}
+			}
+		};
+
+		if (threadCount <= 0)
+			threadCount = defaultThreadCount();
+		threadCount = std::min(threadCount, tileCount);
+		std::vector<std::thread> workers;
+		workers.reserve(threadCount - 1);
+		for (int i = 1; i < threadCount; ++i)
+			workers.emplace_back(worker);
+		worker();
+		for (std::thread& thread : workers)
+			thread.join();
+
+		result = std::move(product);
+	}
+
+	MatrixX operator*(const MatrixX& lhs, const MatrixX& rhs)
+	{
+		MatrixX result;
+		multiply(lhs, rhs, result);
+		return result;
+	}
+
+	bool operator==(const MatrixX& left, const MatrixX& right) noexcept
+	{
+		if (left.getRows() != right.getRows() || left.getColumns() != right.getColumns())
+			return false;
+		for (int column = 0; column < left.getColumns(); ++column)
+			for (int row = 0; row < left.getRows(); ++row)
+				if (std::abs(left(row, column) - right(row, column)) > 1e-5f)
+					return false;
+		return true;
+	}
+
+	std::ostream& operator<<(std::ostream& os, const MatrixX& matrix)
+	{
+		os << '(';
+		for (int row = 0; row < matrix.getRows(); ++row)
+		{
+			os << '{';
+			for (int column = 0; column < matrix.getColumns(); ++column)
+				os << (column > 0 ? "," : "") << matrix(row, column);
+			os << '}';
+		}
+		os << ')';
+		return os;
+	}
+}
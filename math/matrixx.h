@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <new>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+
+#include "matrix.h"
+#include "vector.h"
+
+namespace mpn {
+
+	/*Allocator handing out storage aligned to 'Alignment' bytes, so SIMD kernels can use aligned loads.*/
+	template<typename T, ::std::size_t Alignment>
+	struct AlignedAllocator
+	{
+		using value_type = T;
+
+		template<typename U>
+		struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+		AlignedAllocator() noexcept = default;
+		template<typename U>
+		AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept {}
+
+		T* allocate(::std::size_t count)
+		{
+			return static_cast<T*>(::operator new(count * sizeof(T), ::std::align_val_t(Alignment)));
+		}
+		void deallocate(T* pointer, ::std::size_t) noexcept
+		{
+			::operator delete(pointer, ::std::align_val_t(Alignment));
+		}
+
+		template<typename U>
+		bool operator==(const AlignedAllocator<U, Alignment>&) const noexcept { return true; }
+	};
+
+	/*Heap allocated float matrix whose size is chosen at run time, for systems too large for Matrix.
+	  Same conventions as Matrix: column-major storage, element access by (row, column), and row vectors
+	  multiplied from the left. The storage is 64 byte aligned.*/
+	class MatrixX {
+	public:
+		static constexpr ::std::size_t ALIGNMENT = 64;
+
+		MatrixX() = default;
+		/*Zero matrix with the given size.*/
+		MatrixX(int rows, int columns);
+
+		template<int W, int H>
+		explicit MatrixX(const Matrix<W, H, float>& matrix)
+			: MatrixX(H, W)
+		{
+			for (int column = 0; column < W; ++column)
+				for (int row = 0; row < H; ++row)
+					(*this)(row, column) = matrix(row, column);
+		}
+
+		/*Single row matrix, the way Vector is multiplied with Matrix.*/
+		template<int N>
+		explicit MatrixX(const Vector<N, float>& vector)
+			: MatrixX(1, N)
+		{
+			for (int i = 0; i < N; ++i)
+				(*this)(0, i) = vector[i];
+		}
+
+		static MatrixX identity(int size);
+
+		float operator()(int row, int column) const noexcept {
+			assert(row >= 0 && row < rows && column >= 0 && column < columns);
+			return m[row + static_cast<::std::size_t>(rows) * column];
+		}
+		float& operator()(int row, int column) noexcept {
+			assert(row >= 0 && row < rows && column >= 0 && column < columns);
+			return m[row + static_cast<::std::size_t>(rows) * column];
+		}
+
+		int getRows() const noexcept { return rows; }
+		int getColumns() const noexcept { return columns; }
+		const float* data() const noexcept { return m.data(); }
+		float* data() noexcept { return m.data(); }
+
+		MatrixX asTransposed() const;
+
+		/*Converts back to a fixed size matrix.
+		 Throws std::invalid_argument if the sizes do not match.*/
+		template<int W, int H>
+		Matrix<W, H, float> asMatrix() const
+		{
+			if (rows != H || columns != W)
+				throw ::std::invalid_argument("The matrix sizes do not match");
+			Matrix<W, H, float> result;
+			for (int column = 0; column < W; ++column)
+				for (int row = 0; row < H; ++row)
+					result(row, column) = (*this)(row, column);
+			return result;
+		}
+
+		/*Copies a row into a vector.
+		 Throws std::invalid_argument if the row is not N long.*/
+		template<int N>
+		Vector<N, float> row(int index) const
+		{
+			if (columns != N)
+				throw ::std::invalid_argument("The vector size does not match the row");
+			Vector<N, float> result;
+			for (int i = 0; i < N; ++i)
+				result[i] = (*this)(index, i);
+			return result;
+		}
+
+	private:
+		int rows = 0, columns = 0;
+		::std::vector<float, AlignedAllocator<float, ALIGNMENT>> m;
+	};
+
+	/*General matrix product result = lhs * rhs, cache blocked: panels of both operands are packed into
+	  contiguous buffers and multiplied by a register blocked kernel (AVX/FMA or SSE where available).
+	  Tiles of the result are distributed over 'threadCount' workers (hardware concurrency if zero).
+	  'result' may be one of the operands.
+	 Throws std::invalid_argument if the columns of lhs do not match the rows of rhs.*/
+	void multiply(const MatrixX& lhs, const MatrixX& rhs, MatrixX& result, int threadCount = 0);
+
+	MatrixX operator*(const MatrixX& lhs, const MatrixX& rhs);
+
+	template<int N>
+	MatrixX operator*(const Vector<N, float>& lhs, const MatrixX& rhs)
+	{
+		return MatrixX(lhs) * rhs;
+	}
+
+	/*Same tolerance as the float Matrix comparison. Matrices of different sizes are never equal.*/
+	bool operator==(const MatrixX& left, const MatrixX& right) noexcept;
+
+	inline bool operator!=(const MatrixX& left, const MatrixX& right) noexcept
+	{
+		return !(left == right);
+	}
+
+	::std::ostream& operator<<(::std::ostream& os, const MatrixX& matrix);
+}
@@ -0,0 +1,88 @@
+#include "mesh.h"
+
+#include <stdexcept>
+
+namespace geom {
+
+	TriangleMesh::TriangleMesh(std::vector<Triangle> _triangles, int maxLeafSize)
+	{
+		std::vector<AABB> bounds;
+		bounds.reserve(_triangles.size());
+		for (const Triangle& triangle : _triangles)
+			bounds.push_back(createAABB(triangle));
+
+		std::vector<std::uint32_t> order;
+		bvh = BVH(bounds, order, maxLeafSize);
+
+		auto ordered = std::make_shared<std::vector<Triangle>>();
+		ordered->reserve(_triangles.size());
+		for (std::uint32_t index : order)
+			ordered->push_back(_triangles[index]);
+		triangles = *ordered;
+		storage = std::move(ordered);
+	}
+
+	TriangleMesh::TriangleMesh(std::vector<Triangle> _triangles, int maxLeafSize, float maxGrowth)
+	{
+		std::vector<std::uint32_t> order;
+		bvh = BVH(_triangles, order, maxLeafSize, maxGrowth);
+
+		auto ordered = std::make_shared<std::vector<Triangle>>();
+		ordered->reserve(order.size());
+		for (std::uint32_t index : order)
+			ordered->push_back(_triangles[index]);
+		triangles = *ordered;
+		storage = std::move(ordered);
+	}
+
+	float TriangleMesh::intersect(const Line& line, std::uint32_t* hitTriangle) const noexcept
+	{
+		return bvh.intersect(line,
+			[this](std::uint32_t index, const Line& l) { return triangles[index].intersect(l); },
+			hitTriangle);
+	}
+
+	bool TriangleMesh::occludes(const Line& line, float maxDistance) const noexcept
+	{
+		return bvh.occludes(line, maxDistance,
+			[this](std::uint32_t index, const Line& l, float d) { return triangles[index].occludes(l, d); });
+	}
+
+	IndexedMesh::IndexedMesh(std::vector<::mpn::Point3> _vertices, std::vector<Indices> _indices, int maxLeafSize)
+		: vertices(std::move(_vertices))
+	{
+		std::vector<AABB> bounds;
+		bounds.reserve(_indices.size());
+		for (const Indices& triple : _indices)
+		{
+			if (triple[0] >= vertices.size() || triple[1] >= vertices.size() || triple[2] >= vertices.size())
+				throw std::invalid_argument("Vertex index out of range");
+			bounds.push_back(createAABB(Triangle(vertices[triple[0]], vertices[triple[1]], vertices[triple[2]])));
+		}
+
+		std::vector<std::uint32_t> order;
+		bvh = BVH(bounds, order, maxLeafSize);
+
+		indices.reserve(_indices.size());
+		for (std::uint32_t index : order)
+			indices.push_back(_indices[index]);
+	}
+
+	float IndexedMesh::intersect(const Line& line, std::uint32_t* hitTriangle) const noexcept
+	{
+		return bvh.intersect(line,
+			[this](std::uint32_t index, const Line& l) { return intersect(index, l); },
+			hitTriangle);
+	}
+
+	bool IndexedMesh::occludes(const Line& line, float maxDistance) const noexcept
+	{
+		return bvh.occludes(line, maxDistance,
+			[this](std::uint32_t index, const Line& l, float d) { return occludes(index, l, d); });
+	}
+
+	AABB createAABB(const IndexedMesh& mesh, std::uint32_t triangle)
+	{
+		return createAABB(mesh.getTriangle(triangle));
+	}
+}
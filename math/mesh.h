@@ -0,0 +1,105 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "bvh.h"
+#include "primitives.h"
+
+namespace geom {
+
+	/*Triangle set with its own bounding volume hierarchy.
+	  The triangles are rearranged in the order of the hierarchy leaves when the mesh is created.
+	  The mesh is immutable once built, copies share the triangles.*/
+	class TriangleMesh
+	{
+	public:
+		TriangleMesh() = default;
+		explicit TriangleMesh(::std::vector<Triangle> triangles, int maxLeafSize = 4);
+
+		/*Builds the mesh over a spatial split hierarchy, see BVH. Triangles split across leaves are stored
+		  once per leaf, up to 'maxGrowth' times the triangle count extra, so getTriangles() may repeat them.*/
+		TriangleMesh(::std::vector<Triangle> triangles, int maxLeafSize, float maxGrowth);
+
+		/*Creates a mesh over prebuilt data, e.g. a file mapping.
+		 - triangles: must be in the order of the hierarchy leaves.
+		 - storage: keeps the memory of the triangles alive.*/
+		TriangleMesh(::std::span<const Triangle> triangles, BVH bvh, ::std::shared_ptr<const void> storage) noexcept
+			: storage(::std::move(storage)), triangles(triangles), bvh(::std::move(bvh)) {}
+
+		/*Returns the distance of the closest hit or INVALID_DISTANCE.
+		  The index of the triangle hit is written to 'hitTriangle' if it is not null.*/
+		float intersect(const Line& line, ::std::uint32_t* hitTriangle = nullptr) const noexcept;
+
+		/*Occlusion query: checks whether any triangle is hit at a distance in [0, maxDistance].*/
+		bool occludes(const Line& line, float maxDistance) const noexcept;
+
+		const AABB& getBounds() const { return bvh.getBounds(); }
+		const BVH& getBVH() const noexcept { return bvh; }
+		::std::span<const Triangle> getTriangles() const noexcept { return triangles; }
+
+	private:
+		::std::shared_ptr<const void> storage;
+		::std::span<const Triangle> triangles;
+		BVH bvh;
+	};
+
+	/*Triangle mesh with a shared vertex buffer. Each triangle is a triple of vertex indices,
+	  so vertices shared by neighbouring triangles are only stored once.
+	  The index triples are rearranged in the order of the hierarchy leaves when the mesh is created.*/
+	class IndexedMesh
+	{
+	public:
+		using Indices = ::std::array<::std::uint32_t, 3>;
+
+		IndexedMesh() = default;
+
+		/*Throws std::invalid_argument if an index is out of the vertex range.*/
+		IndexedMesh(::std::vector<::mpn::Point3> vertices, ::std::vector<Indices> indices, int maxLeafSize = 4);
+
+		/*Returns the distance of the closest hit or INVALID_DISTANCE.
+		  The index of the triangle hit is written to 'hitTriangle' if it is not null.*/
+		float intersect(const Line& line, ::std::uint32_t* hitTriangle = nullptr) const noexcept;
+
+		/*Intersects a single triangle, same as Triangle::intersect.*/
+		float intersect(::std::uint32_t triangle, const Line& line) const noexcept
+		{
+			const Indices& triple = indices[triangle];
+			return intersectTriangle(vertices[triple[0]], vertices[triple[1]], vertices[triple[2]], line);
+		}
+
+		/*Occlusion query: checks whether any triangle is hit at a distance in [0, maxDistance].*/
+		bool occludes(const Line& line, float maxDistance) const noexcept;
+
+		/*Occlusion query for a single triangle, same as Triangle::occludes.*/
+		bool occludes(::std::uint32_t triangle, const Line& line, float maxDistance) const noexcept
+		{
+			const Indices& triple = indices[triangle];
+			return occludesTriangle(vertices[triple[0]], vertices[triple[1]], vertices[triple[2]], line, maxDistance);
+		}
+
+		::mpn::Point3 getCenter(::std::uint32_t triangle) const { return getTriangle(triangle).getCenter(); }
+
+		Triangle getTriangle(::std::uint32_t triangle) const
+		{
+			const Indices& triple = indices[triangle];
+			return Triangle(vertices[triple[0]], vertices[triple[1]], vertices[triple[2]]);
+		}
+
+		const AABB& getBounds() const { return bvh.getBounds(); }
+		const BVH& getBVH() const noexcept { return bvh; }
+		const ::std::vector<::mpn::Point3>& getVertices() const noexcept { return vertices; }
+		const ::std::vector<Indices>& getIndices() const noexcept { return indices; }
+		size_t size() const noexcept { return indices.size(); }
+
+	private:
+		::std::vector<::mpn::Point3> vertices;
+		::std::vector<Indices> indices;
+		BVH bvh;
+	};
+
+	AABB createAABB(const IndexedMesh& mesh, ::std::uint32_t triangle);
+}
@@ -0,0 +1,221 @@
+#include "meshfile.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace geom {
+
+	static_assert(::std::is_trivially_copyable_v<BVHNode> && ::std::is_standard_layout_v<BVHNode>, "BVHNode must be mappable from a file");
+	static_assert(::std::is_trivially_copyable_v<Triangle> && ::std::is_standard_layout_v<Triangle>, "Triangle must be mappable from a file");
+	static_assert(alignof(BVHNode) <= MESH_FILE_ALIGNMENT && alignof(Triangle) <= MESH_FILE_ALIGNMENT, "Sections are not aligned enough");
+
+	namespace {
+
+		// MESH_FILE_BYTE_ORDER as read on a machine of the other byte order
+		constexpr std::uint32_t SWAPPED_BYTE_ORDER = 0x04030201;
+
+		/*Read-only mapping of a whole file, unmapped on destruction.*/
+		class MappedFile
+		{
+		public:
+			explicit MappedFile(const std::string& path)
+			{
+#ifdef _WIN32
+				file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+				if (file == INVALID_HANDLE_VALUE)
+					throw std::runtime_error("Cannot open mesh file " + path);
+				LARGE_INTEGER fileSize;
+				if (!GetFileSizeEx(file, &fileSize))
+				{
+					CloseHandle(file);
+					throw std::runtime_error("Cannot query size of mesh file " + path);
+				}
+				size = static_cast<size_t>(fileSize.QuadPart);
+				mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+				if (mapping != nullptr)
+					data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+				if (data == nullptr)
+				{
+					if (mapping != nullptr) CloseHandle(mapping);
+					CloseHandle(file);
+					throw std::runtime_error("Cannot map mesh file " + path);
+				}
+#else
+				const int descriptor = open(path.c_str(), O_RDONLY);
+				if (descriptor < 0)
+					throw std::runtime_error("Cannot open mesh file " + path);
+				struct stat status;
+				if (fstat(descriptor, &status) != 0)
+				{
+					close(descriptor);
+					throw std::runtime_error("Cannot query size of mesh file " + path);
+				}
+				size = static_cast<size_t>(status.st_size);
+				void* mapped = size == 0 ? MAP_FAILED : mmap(nullptr, size, PROT_READ, MAP_SHARED, descriptor, 0);
+				close(descriptor);	// the mapping stays valid without the descriptor
+				if (mapped == MAP_FAILED)
+					throw std::runtime_error("Cannot map mesh file " + path);
+				data = mapped;
+#endif
+			}
+
+			MappedFile(const MappedFile&) = delete;
+			MappedFile& operator=(const MappedFile&) = delete;
+
+			~MappedFile()
+			{
+#ifdef _WIN32
+				UnmapViewOfFile(data);
+				CloseHandle(mapping);
+				CloseHandle(file);
+#else
+				munmap(const_cast<void*>(data), size);
+#endif
+			}
+
+			const unsigned char* bytes() const noexcept { return static_cast<const unsigned char*>(data); }
+			size_t getSize() const noexcept { return size; }
+
+		private:
+			const void* data = nullptr;
+			size_t size = 0;
+#ifdef _WIN32
+			HANDLE file = INVALID_HANDLE_VALUE;
+			HANDLE mapping = nullptr;
+#endif
+		};
+
+		std::uint64_t alignUp(std::uint64_t offset)
+		{
+			return (offset + MESH_FILE_ALIGNMENT - 1) / MESH_FILE_ALIGNMENT * MESH_FILE_ALIGNMENT;
+		}
+
+		void writePadding(std::ofstream& out, std::uint64_t until)
+		{
+			static const char zeros[MESH_FILE_ALIGNMENT] = {};
+			const std::uint64_t position = static_cast<std::uint64_t>(out.tellp());
+			out.write(zeros, static_cast<std::streamsize>(until - position));
+		}
+
+		// Whether 'count' items of 'itemSize' bytes starting at 'offset' fit in 'size' bytes, written so it cannot wrap around
+		bool fits(std::uint64_t offset, std::uint64_t count, std::uint64_t itemSize, std::uint64_t size) noexcept
+		{
+			return offset <= size && count <= (size - offset) / itemSize;
+		}
+
+		// The traversals rely on the layout the builders produce: nodes in depth first order, the first child
+		// right after its parent, the second one right after the subtree of the first, no deeper than their
+		// BVH::MAX_DEPTH entry stacks, and leaves only addressing existing triangles
+		bool isWellFormed(std::span<const BVHNode> nodes, std::uint64_t triangleCount) noexcept
+		{
+			if (nodes.empty())
+				return triangleCount == 0;
+			if (nodes.size() > UINT32_MAX)
+				return false;
+
+			// Second children still to visit, with their depth
+			std::uint32_t pending[BVH::MAX_DEPTH];
+			int pendingDepth[BVH::MAX_DEPTH];
+			int pendingCount = 0;
+			std::uint32_t next = 0;		// index the next node has to be at in depth first order
+			int depth = 0;
+			while (true)
+			{
+				const BVHNode& node = nodes[next];
+				if (node.isLeaf())
+				{
+					if (std::uint64_t(node.offset) + node.count > triangleCount)
+						return false;
+					++next;
+					if (pendingCount == 0)
+						return next == nodes.size();
+					--pendingCount;
+					if (pending[pendingCount] != next)
+						return false;
+					depth = pendingDepth[pendingCount];
+				}
+				else
+				{
+					if (depth >= BVH::MAX_DEPTH || node.offset <= next + 1 || node.offset >= nodes.size())
+						return false;
+					pending[pendingCount] = node.offset;
+					pendingDepth[pendingCount++] = ++depth;
+					++next;
+				}
+				if (next >= nodes.size())
+					return false;
+			}
+		}
+	}
+
+	void saveMesh(const TriangleMesh& mesh, const std::string& path)
+	{
+		const std::span<const BVHNode> nodes = mesh.getBVH().getNodes();
+		const std::span<const Triangle> triangles = mesh.getTriangles();
+
+		MeshFileHeader header{};
+		std::memcpy(header.magic, MESH_FILE_MAGIC, sizeof(header.magic));
+		header.version = MESH_FILE_VERSION;
+		header.byteOrder = MESH_FILE_BYTE_ORDER;
+		header.nodeSize = sizeof(BVHNode);
+		header.triangleSize = sizeof(Triangle);
+		header.nodeOffset = alignUp(sizeof(MeshFileHeader));
+		header.nodeCount = nodes.size();
+		header.triangleOffset = alignUp(header.nodeOffset + nodes.size_bytes());
+		header.triangleCount = triangles.size();
+
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		if (!out)
+			throw std::runtime_error("Cannot create mesh file " + path);
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		writePadding(out, header.nodeOffset);
+		out.write(reinterpret_cast<const char*>(nodes.data()), static_cast<std::streamsize>(nodes.size_bytes()));
+		writePadding(out, header.triangleOffset);
+		out.write(reinterpret_cast<const char*>(triangles.data()), static_cast<std::streamsize>(triangles.size_bytes()));
+		if (!out)
+			throw std::runtime_error("Cannot write mesh file " + path);
+	}
+
+	TriangleMesh loadMesh(const std::string& path)
+	{
+		auto file = std::make_shared<const MappedFile>(path);
+
+		MeshFileHeader header;
+		if (file->getSize() < sizeof(header))
+			throw std::runtime_error("Mesh file is truncated: " + path);
+		std::memcpy(&header, file->bytes(), sizeof(header));
+		if (std::memcmp(header.magic, MESH_FILE_MAGIC, sizeof(header.magic)) != 0)
+			throw std::runtime_error("Not a mesh file: " + path);
+		if (header.byteOrder == SWAPPED_BYTE_ORDER)
+			throw std::runtime_error("Mesh file was written with the other byte order: " + path);
+		if (header.version != MESH_FILE_VERSION || header.byteOrder != MESH_FILE_BYTE_ORDER || header.nodeSize != sizeof(BVHNode) || header.triangleSize != sizeof(Triangle))
+			throw std::runtime_error("Mesh file was written with an incompatible version: " + path);
+		if (header.nodeOffset % MESH_FILE_ALIGNMENT != 0 || header.triangleOffset % MESH_FILE_ALIGNMENT != 0
+			|| !fits(header.nodeOffset, header.nodeCount, sizeof(BVHNode), file->getSize())
+			|| !fits(header.triangleOffset, header.triangleCount, sizeof(Triangle), file->getSize()))
+			throw std::runtime_error("Mesh file is truncated: " + path);
+
+		const std::span<const BVHNode> nodes(
+			reinterpret_cast<const BVHNode*>(file->bytes() + header.nodeOffset), static_cast<size_t>(header.nodeCount));
+		const std::span<const Triangle> triangles(
+			reinterpret_cast<const Triangle*>(file->bytes() + header.triangleOffset), static_cast<size_t>(header.triangleCount));
+		if (!isWellFormed(nodes, header.triangleCount))
+			throw std::runtime_error("Mesh file has a malformed hierarchy: " + path);
+		return TriangleMesh(triangles, BVH(nodes, file), file);
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "bvh.h"
+#include "mesh.h"
+#include "primitives.h"
+
+namespace geom {
+
+	/*Flat binary mesh file layout.
+	  The header is followed by the node and triangle arrays exactly as they are laid out in memory,
+	  each section aligned to MESH_FILE_ALIGNMENT bytes. Nothing in the file is a pointer, node links
+	  are array indices, so a mapping of the file can be used without any parsing or copying, on a machine
+	  of the same byte order as the writer.*/
+	struct MeshFileHeader
+	{
+		char magic[4];
+		::std::uint32_t version;
+		::std::uint32_t byteOrder;		// MESH_FILE_BYTE_ORDER as stored by the writer, reversed if it had the other byte order
+		::std::uint32_t nodeSize;		// sizeof(BVHNode) of the writer, guards against layout changes
+		::std::uint32_t triangleSize;	// sizeof(Triangle) of the writer
+		::std::uint32_t reserved;
+		::std::uint64_t nodeOffset;
+		::std::uint64_t nodeCount;
+		::std::uint64_t triangleOffset;
+		::std::uint64_t triangleCount;
+	};
+
+	constexpr const char MESH_FILE_MAGIC[4] = { 'M', 'P', 'N', 'M' };
+	constexpr ::std::uint32_t MESH_FILE_VERSION = 2;
+	constexpr ::std::uint32_t MESH_FILE_BYTE_ORDER = 0x01020304;
+	constexpr ::std::uint64_t MESH_FILE_ALIGNMENT = 64;
+
+	/*Writes the triangles and the hierarchy of the mesh to a mesh file.
+	  Throws std::runtime_error if the file cannot be written.*/
+	void saveMesh(const TriangleMesh& mesh, const ::std::string& path);
+
+	/*Maps a mesh file read-only into memory. The returned mesh reads its nodes and triangles directly
+	  from the mapping, which is shared by every process mapping the same file and stays alive as long
+	  as any copy of the mesh does.
+	  The header and the node links are validated once here, so a damaged or crafted file cannot make the
+	  queries read outside the mapping. The node bounds and triangle coordinates are used as they are.
+	  Throws std::runtime_error if the file cannot be mapped, was written with a different layout or byte order
+	  or is malformed.*/
+	TriangleMesh loadMesh(const ::std::string& path);
+}
@@ -0,0 +1,264 @@
+#include "obb.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <stdexcept>
+
+namespace geom {
+
+	float OBB::entryDistance(const Line& line) const noexcept
+	{
+		::mpn::count(::mpn::Counter::AABBTests);
+		const ::mpn::Vector3 offset = line.P - center;
+		float tmin = 0.0f;
+		float tmax = FLT_MAX;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const float origin = offset * axes[axis];
+			const float inverse = 1.0f / (line.v * axes[axis]);
+			const float t1 = (-halfExtents[axis] - origin) * inverse;
+			const float t2 = (halfExtents[axis] - origin) * inverse;
+			tmin = std::max(tmin, std::min(t1, t2));
+			tmax = std::min(tmax, std::max(t1, t2));
+		}
+		::mpn::count(::mpn::Counter::AABBHits, tmax >= tmin);
+		return tmax >= tmin ? tmin : INVALID_DISTANCE;
+	}
+
+	bool OBB::contains(const ::mpn::Point3& point) const noexcept
+	{
+		const ::mpn::Vector3 offset = point - center;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			if (std::abs(offset * axes[axis]) > halfExtents[axis])
+				return false;
+		}
+		return true;
+	}
+
+	AABB OBB::getBounds() const
+	{
+		::mpn::Vector3 reach;
+		for (int axis = 0; axis < 3; ++axis)
+			reach[axis] = std::abs(axes[0][axis]) * halfExtents[0] + std::abs(axes[1][axis]) * halfExtents[1] + std::abs(axes[2][axis]) * halfExtents[2];
+		return AABB(center - reach, center + reach);
+	}
+
+	bool overlaps(const OBB& left, const OBB& right) noexcept
+	{
+		// Rotation and translation of the right box in the frame of the left one
+		float rotation[3][3], absRotation[3][3];
+		for (int i = 0; i < 3; ++i)
+			for (int j = 0; j < 3; ++j)
+			{
+				rotation[i][j] = left.axes[i] * right.axes[j];
+				// Edges of the two boxes may be parallel, which leaves the cross product axes near zero
+				absRotation[i][j] = std::abs(rotation[i][j]) + ::mpn::EPSILON;
+			}
+		const ::mpn::Vector3 offset = right.center - left.center;
+		const float t[3] = { offset * left.axes[0], offset * left.axes[1], offset * left.axes[2] };
+		const ::mpn::Vector3& a = left.halfExtents;
+		const ::mpn::Vector3& b = right.halfExtents;
+
+		// Axes of the left box
+		for (int i = 0; i < 3; ++i)
+		{
+			if (std::abs(t[i]) > a[i] + b[0] * absRotation[i][0] + b[1] * absRotation[i][1] + b[2] * absRotation[i][2])
+				return false;
+		}
+		// Axes of the right box
+		for (int j = 0; j < 3; ++j)
+		{
+			const float distance = t[0] * rotation[0][j] + t[1] * rotation[1][j] + t[2] * rotation[2][j];
+			if (std::abs(distance) > b[j] + a[0] * absRotation[0][j] + a[1] * absRotation[1][j] + a[2] * absRotation[2][j])
+				return false;
+		}
+		// Cross products of an axis of each box
+		for (int i = 0; i < 3; ++i)
+		{
+			const int i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+			for (int j = 0; j < 3; ++j)
+			{
+				const int j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+				const float radiusLeft = a[i1] * absRotation[i2][j] + a[i2] * absRotation[i1][j];
+				const float radiusRight = b[j1] * absRotation[i][j2] + b[j2] * absRotation[i][j1];
+				if (std::abs(t[i2] * rotation[i1][j] - t[i1] * rotation[i2][j]) > radiusLeft + radiusRight)
+					return false;
+			}
+		}
+		return true;
+	}
+
+	namespace {
+
+		constexpr size_t BLOCK_SIZE = 256;
+
+		// Upper triangle of a symmetric matrix: xx, xy, xz, yy, yz, zz
+		struct Moments
+		{
+			double values[6] = {};
+
+			void add(const double d[3], double weight)
+			{
+				values[0] += weight * d[0] * d[0];
+				values[1] += weight * d[0] * d[1];
+				values[2] += weight * d[0] * d[2];
+				values[3] += weight * d[1] * d[1];
+				values[4] += weight * d[1] * d[2];
+				values[5] += weight * d[2] * d[2];
+			}
+
+			::mpn::Matrix3 toMatrix(double scale) const
+			{
+				::mpn::Matrix3 result;
+				const int index[3][3] = { { 0, 1, 2 }, { 1, 3, 4 }, { 2, 4, 5 } };
+				for (int row = 0; row < 3; ++row)
+					for (int column = 0; column < 3; ++column)
+						result(row, column) = static_cast<float>(values[index[row][column]] * scale);
+				return result;
+			}
+		};
+
+		// Partial sums in float over short blocks, added up in double
+		template<typename Term>
+		void sumBlocked(size_t count, Term&& term, double* sums, int width)
+		{
+			for (size_t begin = 0; begin < count; begin += BLOCK_SIZE)
+			{
+				float partial[6] = {};
+				const size_t end = std::min(count, begin + BLOCK_SIZE);
+				for (size_t i = begin; i < end; ++i)
+					term(i, partial);
+				for (int k = 0; k < width; ++k)
+					sums[k] += partial[k];
+			}
+		}
+
+		// Box along the eigenvectors of the covariance, spanning the projections of the points
+		template<typename Position>
+		OBB fitOBB(const ::mpn::Matrix3& covarianceMatrix, size_t count, Position&& position)
+		{
+			::mpn::Vector3 eigenvalues;
+			::mpn::Matrix3 eigenvectors;
+			::mpn::symmetricEigen(covarianceMatrix, eigenvalues, eigenvectors);
+			std::array<::mpn::Vector3, 3> axes;
+			for (int axis = 0; axis < 3; ++axis)
+				axes[axis] = ::mpn::Vector3(eigenvectors(0, axis), eigenvectors(1, axis), eigenvectors(2, axis));
+
+			float minimum[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+			float maximum[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+			for (size_t i = 0; i < count; ++i)
+			{
+				const ::mpn::Vector3 offset = position(i) - ::mpn::Point3(0.0f, 0.0f, 0.0f);
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					const float projection = offset * axes[axis];
+					minimum[axis] = std::min(minimum[axis], projection);
+					maximum[axis] = std::max(maximum[axis], projection);
+				}
+			}
+			::mpn::Point3 center(0.0f, 0.0f, 0.0f);
+			::mpn::Vector3 halfExtents;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				center = center + axes[axis] * (0.5f * (minimum[axis] + maximum[axis]));
+				halfExtents[axis] = 0.5f * (maximum[axis] - minimum[axis]);
+			}
+			return OBB(center, axes, halfExtents);
+		}
+
+		// Covariance of 'count' points given by position(i), in two passes: the mean first, then the
+		// moments about it, which avoids cancellation
+		template<typename Position>
+		::mpn::Matrix3 pointCovariance(size_t count, Position&& position, ::mpn::Point3& mean) noexcept
+		{
+			mean = ::mpn::Point3(0.0f, 0.0f, 0.0f);
+			if (count == 0)
+				return ::mpn::Matrix3();
+
+			double sum[3] = {};
+			sumBlocked(count, [&position](size_t i, float* partial)
+				{
+					const ::mpn::Point3& point = position(i);
+					for (int axis = 0; axis < 3; ++axis)
+						partial[axis] += point[axis];
+				}, sum, 3);
+			for (int axis = 0; axis < 3; ++axis)
+				mean[axis] = static_cast<float>(sum[axis] / count);
+
+			Moments moments;
+			sumBlocked(count, [&position, &mean](size_t i, float* partial)
+				{
+					const ::mpn::Point3& point = position(i);
+					const float dx = point[0] - mean[0], dy = point[1] - mean[1], dz = point[2] - mean[2];
+					partial[0] += dx * dx;
+					partial[1] += dx * dy;
+					partial[2] += dx * dz;
+					partial[3] += dy * dy;
+					partial[4] += dy * dz;
+					partial[5] += dz * dz;
+				}, moments.values, 6);
+			return moments.toMatrix(1.0 / count);
+		}
+	}
+
+	::mpn::Matrix3 covariance(std::span<const ::mpn::Point3> points, ::mpn::Point3& mean) noexcept
+	{
+		return pointCovariance(points.size(), [points](size_t i) -> const ::mpn::Point3& { return points[i]; }, mean);
+	}
+
+	::mpn::Matrix3 covariance(std::span<const Triangle> triangles, ::mpn::Point3& mean) noexcept
+	{
+		// Area weighted centroid first, then the second moments of the triangles about it
+		double area = 0.0;
+		double weighted[3] = {};
+		for (const Triangle& triangle : triangles)
+		{
+			const float triangleArea = 0.5f * ((triangle.vertices[1] - triangle.vertices[0]) % (triangle.vertices[2] - triangle.vertices[0])).length();
+			const ::mpn::Point3 centroid = triangle.getCenter();
+			area += triangleArea;
+			for (int axis = 0; axis < 3; ++axis)
+				weighted[axis] += triangleArea * centroid[axis];
+		}
+		if (!(area > 0.0))
+			return pointCovariance(triangles.size() * 3,
+				[triangles](size_t i) -> const ::mpn::Point3& { return triangles[i / 3].vertices[i % 3]; }, mean);
+		for (int axis = 0; axis < 3; ++axis)
+			mean[axis] = static_cast<float>(weighted[axis] / area);
+
+		// Second moment of a triangle about the origin: area / 12 * (9 c c^T + sum of v v^T over the vertices)
+		Moments moments;
+		for (const Triangle& triangle : triangles)
+		{
+			const double triangleArea = 0.5 * ((triangle.vertices[1] - triangle.vertices[0]) % (triangle.vertices[2] - triangle.vertices[0])).length();
+			double centroid[3] = {};
+			for (const ::mpn::Point3& vertex : triangle.vertices)
+			{
+				const double d[3] = { double(vertex[0]) - mean[0], double(vertex[1]) - mean[1], double(vertex[2]) - mean[2] };
+				moments.add(d, triangleArea / 12.0);
+				for (int axis = 0; axis < 3; ++axis)
+					centroid[axis] += d[axis] / 3.0;
+			}
+			moments.add(centroid, triangleArea * 9.0 / 12.0);
+		}
+		return moments.toMatrix(1.0 / area);
+	}
+
+	OBB createOBB(std::span<const ::mpn::Point3> points)
+	{
+		if (points.empty())
+			throw std::invalid_argument("There are no points to fit a box to");
+		::mpn::Point3 mean;
+		return fitOBB(covariance(points, mean), points.size(), [points](size_t i) { return points[i]; });
+	}
+
+	OBB createOBB(std::span<const Triangle> triangles)
+	{
+		if (triangles.empty())
+			throw std::invalid_argument("There are no triangles to fit a box to");
+		::mpn::Point3 mean;
+		const ::mpn::Matrix3 matrix = covariance(triangles, mean);
+		return fitOBB(matrix, triangles.size() * 3, [triangles](size_t i) { return triangles[i / 3].vertices[i % 3]; });
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <array>
+#include <span>
+
+#include "math.h"
+#include "matrix.h"
+#include "primitives.h"
+
+namespace geom {
+
+	/*Oriented bounding box: a center, three orthonormal axes and the half extents along them.*/
+	struct OBB
+	{
+		::mpn::Point3 center;
+		::std::array<::mpn::Vector3, 3> axes{ ::mpn::Vector3(1.0f, 0.0f, 0.0f), ::mpn::Vector3(0.0f, 1.0f, 0.0f), ::mpn::Vector3(0.0f, 0.0f, 1.0f) };
+		::mpn::Vector3 halfExtents;
+
+		OBB() = default;
+		OBB(const ::mpn::Point3& center, const ::std::array<::mpn::Vector3, 3>& axes, const ::mpn::Vector3& halfExtents) noexcept
+			: center(center), axes(axes), halfExtents(halfExtents) {}
+		explicit OBB(const AABB& box) noexcept
+			: center(box.getCenter()), halfExtents((box.maxCoords - box.minCoords) * 0.5f) {}
+
+		bool intersect(const Line& line) const noexcept { return entryDistance(line) >= 0.0f; }
+
+		/*Returns the distance along the line at which it enters the box (zero if the line starts inside),
+		  or INVALID_DISTANCE if the box is missed. Same as AABB::entryDistance in the frame of the box.*/
+		float entryDistance(const Line& line) const noexcept;
+
+		bool contains(const ::mpn::Point3& point) const noexcept;
+
+		/*Axis aligned box enclosing this one.*/
+		AABB getBounds() const;
+	};
+
+	/*Whether the two boxes share at least a point, tested on the 15 separating axes (Gottschalk et al.).*/
+	bool overlaps(const OBB& left, const OBB& right) noexcept;
+
+	/*Covariance of the points about their mean. The sums are reduced in fixed size blocks whose results
+	  are added up in double precision, so the rounding error does not grow with the point count.*/
+	::mpn::Matrix3 covariance(::std::span<const ::mpn::Point3> points, ::mpn::Point3& mean) noexcept;
+
+	/*Covariance of the triangle surfaces, each triangle weighted by its area, so it does not depend on how
+	  finely the surface is tessellated. Falls back to the vertex covariance if the surface has no area.*/
+	::mpn::Matrix3 covariance(::std::span<const Triangle> triangles, ::mpn::Point3& mean) noexcept;
+
+	/*Tight box around the points, oriented along the principal axes of their covariance.
+	 Throws std::invalid_argument if there are no points.*/
+	OBB createOBB(::std::span<const ::mpn::Point3> points);
+
+	/*Tight box around the triangles, oriented along the principal axes of the area weighted covariance.
+	 Throws std::invalid_argument if there are no triangles.*/
+	OBB createOBB(::std::span<const Triangle> triangles);
+}
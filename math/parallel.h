@@ -0,0 +1,13 @@
+#pragma once
+
+#include <algorithm>
+#include <thread>
+
+namespace mpn {
+
+	/*Number of worker threads used by the parallel algorithms of the library when none is requested.*/
+	inline int defaultThreadCount() noexcept
+	{
+		return static_cast<int>(::std::max(1u, ::std::thread::hardware_concurrency()));
+	}
+}
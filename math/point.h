@@ -17,11 +17,9 @@ namespace mpn
 				p[i] = T(0);
 			}
 		}
-		constexpr Point(const Point<N, T>& c) {
-			memcpy(p, c.p, arraySize);
-		}
-		constexpr explicit Point(T _p[N]) {
-			memcpy(p, _p, arraySize);
+		constexpr explicit Point(const T _p[N]) {
+			for (int i = 0; i < N; ++i)
+				p[i] = _p[i];
 		}
 		constexpr explicit Point(const Vector<N, T>& v) {
 			for (int i = 0; i < N; ++i)
@@ -37,11 +35,6 @@ namespace mpn
 		template<int N1 = N, typename = std::enable_if_t<N1 == 3>>
 		constexpr Point(T x, T y, T z) : p{ x,y,z } {}
 
-		constexpr Point<N, T>& operator=(const Point<N, T>& rhs) {
-			memcpy(p, rhs.p, arraySize);
-			return *this;
-		}
-		
 		constexpr T operator[](int index) const { return p[index]; }
 		constexpr T& operator[](int index) { return p[index]; }
 
@@ -63,7 +56,6 @@ namespace mpn
 		}
 
 	private:
-		static constexpr size_t arraySize = N * sizeof(T);
 		T p[N];
 	};
 
@@ -71,6 +63,9 @@ namespace mpn
 	using Point2 = Point<2, float>;
 	using Point1 = Point<1, float>;
 
+	static_assert(std::is_trivially_copyable_v<Point3> && std::is_standard_layout_v<Point3>, "Points must be copyable as raw memory");
+	static_assert(sizeof(Point3) == 3 * sizeof(float) && alignof(Point3) == alignof(float), "Points must be laid out as plain float arrays");
+
 	template<int N ,typename T>
 	constexpr bool operator==(const Point<N, T>& lhs, const Point<N, T>& rhs) {
 		for (int i = 0; i < N; ++i)
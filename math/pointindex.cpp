@@ -0,0 +1,281 @@
+#include "pointindex.h"
+
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+#include "batch.h"
+#include "parallel.h"
+
+namespace geom {
+
+	namespace {
+
+		constexpr size_t PARALLEL_BUILD_SIZE = 1 << 14;
+		constexpr size_t BATCH_GROUP_SIZE = 256;
+
+		struct Entry
+		{
+			::mpn::Point3 point;
+			std::uint32_t index;
+		};
+
+		// Sorts the range into tree order: median along the widest axis in the middle, then both halves
+		void buildRange(std::vector<Entry>& entries, std::vector<std::uint8_t>& axes, size_t begin, size_t end, int threadCount)
+		{
+			while (end - begin > 1)
+			{
+				::mpn::Point3 minCoords = entries[begin].point;
+				::mpn::Point3 maxCoords = minCoords;
+				for (size_t i = begin + 1; i < end; ++i)
+					for (int axis = 0; axis < 3; ++axis)
+					{
+						minCoords[axis] = std::min(minCoords[axis], entries[i].point[axis]);
+						maxCoords[axis] = std::max(maxCoords[axis], entries[i].point[axis]);
+					}
+				const ::mpn::Vector3 extent = maxCoords - minCoords;
+				const int axis = extent[0] >= extent[1] && extent[0] >= extent[2] ? 0 : extent[1] >= extent[2] ? 1 : 2;
+
+				const size_t middle = begin + (end - begin) / 2;
+				std::nth_element(entries.begin() + begin, entries.begin() + middle, entries.begin() + end,
+					[axis](const Entry& a, const Entry& b) { return a.point[axis] < b.point[axis]; });
+				axes[middle] = static_cast<std::uint8_t>(axis);
+
+				if (threadCount > 1 && end - begin >= PARALLEL_BUILD_SIZE)
+				{
+					std::thread left(buildRange, std::ref(entries), std::ref(axes), begin, middle, threadCount / 2);
+					buildRange(entries, axes, middle + 1, end, threadCount - threadCount / 2);
+					left.join();
+					return;
+				}
+				buildRange(entries, axes, begin, middle, 1);
+				begin = middle + 1;
+			}
+		}
+
+		// Calls work(begin, end) on equal slices of [0, count) on up to 'threadCount' threads
+		template<typename Work>
+		void parallelFor(size_t count, int threadCount, Work&& work)
+		{
+			const size_t sliceCount = std::max<size_t>(1, std::min<size_t>(threadCount, count / PARALLEL_BUILD_SIZE));
+			std::vector<std::thread> workers;
+			workers.reserve(sliceCount - 1);
+			for (size_t slice = 1; slice < sliceCount; ++slice)
+				workers.emplace_back([&work, slice, sliceCount, count]() { work(count * slice / sliceCount, count * (slice + 1) / sliceCount); });
+			work(0, count / sliceCount);
+			for (std::thread& worker : workers)
+				worker.join();
+		}
+
+		void checkPointCount(size_t count)
+		{
+			if (count >= std::numeric_limits<std::uint32_t>::max())
+				throw std::length_error("Too many points");
+		}
+	}
+
+	struct PointKdTree::Search
+	{
+		::mpn::Point3 query;
+		size_t k = 0;
+		float limit = std::numeric_limits<float>::infinity();	// only points this close are wanted
+		std::vector<PointNeighbor> heap;	// the k closest so far by tree position, farthest on top
+
+		static bool closer(const PointNeighbor& a, const PointNeighbor& b) noexcept { return a.squaredDistance < b.squaredDistance; }
+
+		float bound() const noexcept { return heap.size() < k ? limit : heap.front().squaredDistance; }
+
+		void consider(std::uint32_t position, float distance)
+		{
+			if (heap.size() < k)
+			{
+				if (distance > limit)
+					return;
+				heap.push_back(PointNeighbor{ position, distance });
+				std::push_heap(heap.begin(), heap.end(), closer);
+			}
+			else if (distance < heap.front().squaredDistance)
+			{
+				std::pop_heap(heap.begin(), heap.end(), closer);
+				heap.back() = PointNeighbor{ position, distance };
+				std::push_heap(heap.begin(), heap.end(), closer);
+			}
+		}
+	};
+
+	PointKdTree::PointKdTree(std::span<const ::mpn::Point3> points, int threadCount)
+	{
+		checkPointCount(points.size());
+		std::vector<Entry> entries(points.size());
+		for (size_t i = 0; i < points.size(); ++i)
+			entries[i] = Entry{ points[i], static_cast<std::uint32_t>(i) };
+		axes.assign(points.size(), 0);
+		buildRange(entries, axes, 0, entries.size(), threadCount > 0 ? threadCount : ::mpn::defaultThreadCount());
+
+		this->points.resize(entries.size());
+		indices.resize(entries.size());
+		for (size_t i = 0; i < entries.size(); ++i)
+		{
+			this->points[i] = entries[i].point;
+			indices[i] = entries[i].index;
+		}
+	}
+
+	void PointKdTree::search(Search& state, std::uint32_t begin, std::uint32_t end) const
+	{
+		while (begin < end)
+		{
+			const std::uint32_t middle = begin + (end - begin) / 2;
+			state.consider(middle, squaredDistance(state.query, points[middle]));
+
+			const float difference = state.query[axes[middle]] - points[middle][axes[middle]];
+			// Near side first, the far side only if the current bound reaches over the split
+			if (difference < 0.0f)
+			{
+				search(state, begin, middle);
+				if (difference * difference > state.bound())
+					return;
+				begin = middle + 1;
+			}
+			else
+			{
+				search(state, middle + 1, end);
+				if (difference * difference > state.bound())
+					return;
+				end = middle;
+			}
+		}
+	}
+
+	void PointKdTree::sortNeighbors(Search& state, std::span<PointNeighbor> neighbors) const
+	{
+		std::sort_heap(state.heap.begin(), state.heap.end(), Search::closer);
+		for (size_t i = 0; i < state.heap.size(); ++i)
+			neighbors[i] = PointNeighbor{ indices[state.heap[i].index], state.heap[i].squaredDistance };
+	}
+
+	size_t PointKdTree::nearest(const ::mpn::Point3& query, size_t k, std::span<PointNeighbor> neighbors) const
+	{
+		if (neighbors.size() < k)
+			throw std::invalid_argument("There must be room for k neighbors");
+		Search state;
+		state.query = query;
+		state.k = k;
+		state.heap.reserve(std::min(k, points.size()));
+		if (k > 0)
+			search(state, 0, static_cast<std::uint32_t>(points.size()));
+		sortNeighbors(state, neighbors);
+		return state.heap.size();
+	}
+
+	void PointKdTree::nearestBatch(std::span<const ::mpn::Point3> queries, size_t k, std::span<PointNeighbor> neighbors, int threadCount) const
+	{
+		if (neighbors.size() != queries.size() * k)
+			throw std::invalid_argument("There must be k neighbors for each query");
+		if (queries.empty() || k == 0)
+			return;
+
+		const std::vector<std::uint32_t> order = sortCoherent(queries);
+		const size_t groupCount = (queries.size() + BATCH_GROUP_SIZE - 1) / BATCH_GROUP_SIZE;
+		std::atomic<size_t> nextGroup{ 0 };
+		auto worker = [&]()
+		{
+			Search state;
+			state.k = k;
+			state.heap.reserve(std::min(k, points.size()));
+			std::vector<std::uint32_t> previous;	// tree positions of the neighbours of the previous query
+			previous.reserve(k);
+			for (size_t group = nextGroup++; group < groupCount; group = nextGroup++)
+			{
+				const size_t end = std::min(queries.size(), (group + 1) * BATCH_GROUP_SIZE);
+				for (size_t i = group * BATCH_GROUP_SIZE; i < end; ++i)
+				{
+					// The k previous neighbours are all within this bound, so the k nearest ones are too
+					state.query = queries[order[i]];
+					state.limit = std::numeric_limits<float>::infinity();
+					if (previous.size() == k)
+					{
+						state.limit = 0.0f;
+						for (std::uint32_t position : previous)
+							state.limit = std::max(state.limit, squaredDistance(state.query, points[position]));
+					}
+					state.heap.clear();
+					search(state, 0, static_cast<std::uint32_t>(points.size()));
+
+					previous.clear();
+					for (const PointNeighbor& neighbor : state.heap)
+						previous.push_back(neighbor.index);
+					const std::span<PointNeighbor> result = neighbors.subspan(order[i] * k, k);
+					sortNeighbors(state, result);
+					for (size_t j = state.heap.size(); j < k; ++j)
+						result[j] = PointNeighbor{ INVALID_POINT, std::numeric_limits<float>::infinity() };
+				}
+			}
+		};
+
+		if (threadCount <= 0)
+			threadCount = ::mpn::defaultThreadCount();
+		threadCount = static_cast<int>(std::min<size_t>(threadCount, groupCount));
+		std::vector<std::thread> workers;
+		workers.reserve(threadCount - 1);
+		for (int i = 1; i < threadCount; ++i)
+			workers.emplace_back(worker);
+		worker();
+		for (std::thread& thread : workers)
+			thread.join();
+	}
+
+	PointGrid::PointGrid(std::span<const ::mpn::Point3> points, float cellSize, int threadCount)
+		: cellSize(cellSize), inverseCellSize(1.0f / cellSize)
+	{
+		if (!(cellSize > 0.0f))
+			throw std::invalid_argument("The cell size must be positive");
+		checkPointCount(points.size());
+		if (threadCount <= 0)
+			threadCount = ::mpn::defaultThreadCount();
+
+		// About one bucket per point
+		std::uint32_t bucketCount = 1;
+		while (bucketCount < points.size() && bucketCount < (1u << 31))
+			bucketCount <<= 1;
+		bucketMask = bucketCount - 1;
+
+		// Counting sort by bucket, counted and scattered in parallel
+		std::vector<std::uint32_t> pointBuckets(points.size());
+		std::vector<std::atomic<std::uint32_t>> cursors(size_t(bucketCount) + 1);
+		parallelFor(points.size(), threadCount, [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; ++i)
+			{
+				pointBuckets[i] = bucket(cell(points[i][0]), cell(points[i][1]), cell(points[i][2]));
+				cursors[pointBuckets[i] + 1].fetch_add(1, std::memory_order_relaxed);
+			}
+		});
+
+		bucketStart.resize(size_t(bucketCount) + 1);
+		bucketStart[0] = 0;
+		for (std::uint32_t b = 0; b < bucketCount; ++b)
+		{
+			bucketStart[b + 1] = bucketStart[b] + cursors[b + 1].load(std::memory_order_relaxed);
+			cursors[b].store(bucketStart[b], std::memory_order_relaxed);
+		}
+
+		this->points.resize(points.size());
+		indices.resize(points.size());
+		parallelFor(points.size(), threadCount, [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; ++i)
+			{
+				const std::uint32_t position = cursors[pointBuckets[i]].fetch_add(1, std::memory_order_relaxed);
+				this->points[position] = points[i];
+				indices[position] = static_cast<std::uint32_t>(i);
+			}
+		});
+	}
+
+	std::int32_t PointGrid::cell(float coordinate) const noexcept
+	{
+		return static_cast<std::int32_t>(std::floor(coordinate * inverseCellSize));
+	}
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "point.h"
+
+namespace geom {
+
+	struct PointNeighbor
+	{
+		::std::uint32_t index;	// index into the indexed points
+		float squaredDistance;
+	};
+
+	constexpr ::std::uint32_t INVALID_POINT = UINT32_MAX;
+
+	/*Squared Euclidean distance of two points.*/
+	inline float squaredDistance(const ::mpn::Point3& a, const ::mpn::Point3& b) noexcept
+	{
+		const float dx = a[0] - b[0];
+		const float dy = a[1] - b[1];
+		const float dz = a[2] - b[2];
+		return dx * dx + dy * dy + dz * dz;
+	}
+
+	/*Implicit k-d tree over a point cloud, for nearest neighbour and radius queries.
+	  The points are stored in a single array in tree order: the splitting point of a range is its middle
+	  element, the left subtree lies before it and the right one after it, so no nodes or pointers are stored.
+	  Ranges are split at the median along their widest axis. The tree is immutable once built.*/
+	class PointKdTree
+	{
+	public:
+		PointKdTree() = default;
+
+		/*Builds the tree, the top levels in parallel on 'threadCount' threads (mpn::defaultThreadCount() if zero).
+		 Throws std::length_error if there are more points than 32 bit indices can address.*/
+		explicit PointKdTree(::std::span<const ::mpn::Point3> points, int threadCount = 0);
+
+		/*Writes the min(k, size()) points nearest to the query to 'neighbors', closest first, and returns their count.
+		 Throws std::invalid_argument if 'neighbors' holds fewer than k entries.*/
+		size_t nearest(const ::mpn::Point3& query, size_t k, ::std::span<PointNeighbor> neighbors) const;
+
+		/*Nearest neighbours of a batch of queries, k consecutive entries per query in 'neighbors'.
+		  Entries beyond size() are set to INVALID_POINT. The queries are processed along a Morton curve,
+		  each one starting from a distance bound given by the neighbours of the previous query of its thread,
+		  which prunes most of the tree before the first leaf is reached.
+		 Throws std::invalid_argument if 'neighbors' is not k times as long as 'queries'.*/
+		void nearestBatch(::std::span<const ::mpn::Point3> queries, size_t k, ::std::span<PointNeighbor> neighbors, int threadCount = 0) const;
+
+		/*Calls callback(index, squaredDistance) for every point within 'radius' of the query.*/
+		template<typename Callback>
+		void withinRadius(const ::mpn::Point3& query, float radius, Callback&& callback) const
+		{
+			if (!points.empty())
+				withinRadius(query, radius * radius, 0, static_cast<::std::uint32_t>(points.size()), callback);
+		}
+
+		size_t size() const noexcept { return points.size(); }
+		bool empty() const noexcept { return points.empty(); }
+
+	private:
+		struct Search;
+
+		void search(Search& state, ::std::uint32_t begin, ::std::uint32_t end) const;
+		void sortNeighbors(Search& state, ::std::span<PointNeighbor> neighbors) const;
+
+		template<typename Callback>
+		void withinRadius(const ::mpn::Point3& query, float squaredRadius, ::std::uint32_t begin, ::std::uint32_t end, Callback& callback) const;
+
+		::std::vector<::mpn::Point3> points;	// in tree order
+		::std::vector<::std::uint32_t> indices;	// original index of each point
+		::std::vector<::std::uint8_t> axes;		// split axis of the range whose middle element this is
+	};
+
+	template<typename Callback>
+	void PointKdTree::withinRadius(const ::mpn::Point3& query, float squaredRadius, ::std::uint32_t begin, ::std::uint32_t end, Callback& callback) const
+	{
+		while (begin < end)
+		{
+			const ::std::uint32_t middle = begin + (end - begin) / 2;
+			const float distance = squaredDistance(query, points[middle]);
+			if (distance <= squaredRadius)
+				callback(indices[middle], distance);
+
+			const float difference = query[axes[middle]] - points[middle][axes[middle]];
+			const bool left = difference < 0.0f;
+			// Recurse into the far side if the sphere reaches it, continue with the near side in place
+			if (difference * difference <= squaredRadius)
+			{
+				if (left)
+					withinRadius(query, squaredRadius, middle + 1, end, callback);
+				else
+					withinRadius(query, squaredRadius, begin, middle, callback);
+			}
+			if (left)
+				end = middle;
+			else
+				begin = middle + 1;
+		}
+	}
+
+	/*Uniform grid over a point cloud with hashed cells, for radius queries up to a fixed radius.
+	  The points are sorted by cell hash, so the points of a cell are contiguous and a query only reads the
+	  3x3x3 cells around it. Cells sharing a hash bucket are told apart by the distance test.*/
+	class PointGrid
+	{
+	public:
+		PointGrid() = default;
+
+		/*Builds the grid in parallel on 'threadCount' threads (mpn::defaultThreadCount() if zero).
+		 Throws std::invalid_argument if the cell size is not positive,
+		 std::length_error if there are more points than 32 bit indices can address.*/
+		PointGrid(::std::span<const ::mpn::Point3> points, float cellSize, int threadCount = 0);
+
+		/*Calls callback(index, squaredDistance) for every point within 'radius' of the query.
+		 Throws std::invalid_argument if the radius exceeds the cell size.*/
+		template<typename Callback>
+		void withinRadius(const ::mpn::Point3& query, float radius, Callback&& callback) const;
+
+		float getCellSize() const noexcept { return cellSize; }
+		size_t size() const noexcept { return points.size(); }
+
+	private:
+		::std::uint32_t bucket(::std::int32_t x, ::std::int32_t y, ::std::int32_t z) const noexcept
+		{
+			const ::std::uint32_t hash = static_cast<::std::uint32_t>(x) * 73856093u
+				^ static_cast<::std::uint32_t>(y) * 19349663u
+				^ static_cast<::std::uint32_t>(z) * 83492791u;
+			return hash & bucketMask;
+		}
+
+		::std::int32_t cell(float coordinate) const noexcept;
+
+		float cellSize = 1.0f;
+		float inverseCellSize = 1.0f;
+		::std::uint32_t bucketMask = 0;
+		::std::vector<::std::uint32_t> bucketStart;	// first point of each bucket, one extra entry at the end
+		::std::vector<::mpn::Point3> points;		// sorted by bucket
+		::std::vector<::std::uint32_t> indices;		// original index of each point
+	};
+
+	template<typename Callback>
+	void PointGrid::withinRadius(const ::mpn::Point3& query, float radius, Callback&& callback) const
+	{
+		if (radius > cellSize)
+			throw ::std::invalid_argument("The radius must not exceed the cell size");
+		if (points.empty())
+			return;
+
+		// Distinct buckets of the neighbouring cells, colliding cells must not be read twice
+		::std::uint32_t buckets[27];
+		int bucketCount = 0;
+		const ::std::int32_t x = cell(query[0]), y = cell(query[1]), z = cell(query[2]);
+		for (::std::int32_t dz = -1; dz <= 1; ++dz)
+			for (::std::int32_t dy = -1; dy <= 1; ++dy)
+				for (::std::int32_t dx = -1; dx <= 1; ++dx)
+				{
+					const ::std::uint32_t b = bucket(x + dx, y + dy, z + dz);
+					if (::std::find(buckets, buckets + bucketCount, b) == buckets + bucketCount)
+						buckets[bucketCount++] = b;
+				}
+
+		const float squaredRadius = radius * radius;
+		for (int i = 0; i < bucketCount; ++i)
+			for (::std::uint32_t p = bucketStart[buckets[i]]; p < bucketStart[buckets[i] + 1]; ++p)
+			{
+				const float distance = squaredDistance(query, points[p]);
+				if (distance <= squaredRadius)
+					callback(indices[p], distance);
+			}
+	}
+}
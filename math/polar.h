@@ -3,6 +3,7 @@
 
 #include <cassert>
 #include <ostream>
+#include <type_traits>
 
 #include "vector.h"
 
@@ -16,23 +17,16 @@ namespace mpn
 	template<typename T>
 	class PolarVector {
 		static const int N = 2;
-		static const size_t arraySize = N * sizeof(T);
 
 	public:
 		PolarVector() {
 			for (int i = 0; i < N; ++i)
 				v[i] = T(0);
 		}
-		PolarVector(const PolarVector& c) {
-			memcpy(v, c.v, arraySize);
-		}
-		explicit PolarVector(T _v[N]) {
-			//TODO range checking
-			memcpy(v, _v, arraySize);
-		}
 		explicit PolarVector(const T _v[N]) {
 			//TODO range checking
-			memcpy(v, _v, arraySize);
+			for (int i = 0; i < N; ++i)
+				v[i] = _v[i];
 		}
 
 		PolarVector(T r, T theta) {
@@ -50,12 +44,7 @@ namespace mpn
 			return v[index];
 		}
 
-		PolarVector<T>& operator=(const PolarVector<T>& rhs) {
-			memcpy(v, rhs.v, arraySize);
-			return *this;
-		}
-
-		float length() const {
+		T length() const {
 			return v[0];
 		}
 
@@ -63,6 +52,9 @@ namespace mpn
 		T /*alignas(16)*/ v[N];
 	};
 
+	static_assert(std::is_trivially_copyable_v<PolarVector<float>> && std::is_standard_layout_v<PolarVector<float>>, "Polar vectors must be copyable as raw memory");
+	static_assert(sizeof(PolarVector<float>) == 2 * sizeof(float), "Polar vectors must be laid out as plain float arrays");
+
 	template<typename T>
 	std::ostream& operator<<(std::ostream& out, const PolarVector<T>& vector) {
 		out << '(' << vector[0] << ',' << vector[1] << ')';
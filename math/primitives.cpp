@@ -1,12 +1,14 @@
+#include <cmath>
 #include <limits>
 
+#include "counters.h"
 #include "math.h"
 
 #include "primitives.h"
 
 namespace geom {
 
-	/*Rectangle2D device2coords(const Rectangle2D& dev, float w, float h)
+	Rectangle2D device2coords(const Rectangle2D& dev, float w, float h)
 	{
 		return Rectangle2D((dev.left() + 1.0f)*float(w) / 2.0f,
 			(dev.top() + 1.0f)*float(h) / 2.0f,
@@ -20,27 +22,220 @@ namespace geom {
 			2.0f*coords.top() / float(h) - 1.0f,
 			2.0f*coords.right() / float(w) - 1.0f,
 			2.0f*coords.bottom() / float(h) - 1.0f);
-	}*/
+	}
+
+	float intersectTriangle(const ::mpn::Point3& p0, const ::mpn::Point3& p1, const ::mpn::Point3& p2, const geom::Line& line) noexcept
+    {
+        float u, v;
+        return intersectTriangle(p0, p1, p2, line, u, v);
+    }
 
-	float Triangle::intersect(const geom::Line& line) const noexcept
+    float intersectTriangle(const ::mpn::Point3& p0, const ::mpn::Point3& p1, const ::mpn::Point3& p2, const geom::Line& line, float& u, float& v) noexcept
     {
+        ::mpn::count(::mpn::Counter::TriangleTests);
         // Mller-Trumbore intersection algorithm straight from Wikipedia
-        const mpn::Vector3 edge1 = vertices[1] - vertices[0];
-        const mpn::Vector3 edge2 = vertices[2] - vertices[0];
+        const mpn::Vector3 edge1 = p1 - p0;
+        const mpn::Vector3 edge2 = p2 - p0;
         const mpn::Vector3 h = line.v % edge2;
         const float a = edge1 * h;
         if (a > -mpn::EPSILON && a < mpn::EPSILON)
             return INVALID_DISTANCE;    // This ray is parallel to this triangle.
         const float f = 1.0f / a;
-        const mpn::Vector3 s = line.P - vertices[0];
-        const float u = f * (s * h);
+        const mpn::Vector3 s = line.P - p0;
+        u = f * (s * h);
         if (u < 0.0f || u > 1.0f)
             return INVALID_DISTANCE;
         const mpn::Vector3 q = s % edge1;
-        const float v = f * line.v * q;
+        v = f * line.v * q;
+        if (v < 0.0f || u + v > 1.0f)
+            return INVALID_DISTANCE;
+        const float t = f * (edge2 * q);
+        ::mpn::count(::mpn::Counter::TriangleHits, t >= 0.0f);
+        return t;
+    }
+
+    bool occludesTriangle(const ::mpn::Point3& p0, const ::mpn::Point3& p1, const ::mpn::Point3& p2, const geom::Line& line, float maxDistance) noexcept
+    {
+        ::mpn::count(::mpn::Counter::TriangleTests);
+        // Moller-Trumbore without the division: the barycentrics and the distance are compared scaled by the determinant
+        const mpn::Vector3 edge1 = p1 - p0;
+        const mpn::Vector3 edge2 = p2 - p0;
+        const mpn::Vector3 h = line.v % edge2;
+        float a = edge1 * h;
+        if (a > -mpn::EPSILON && a < mpn::EPSILON)
+            return false;    // This ray is parallel to this triangle.
+        const float sign = a < 0.0f ? -1.0f : 1.0f;
+        a *= sign;
+        const mpn::Vector3 s = line.P - p0;
+        const float u = sign * (s * h);
+        if (u < 0.0f || u > a)
+            return false;
+        const mpn::Vector3 q = s % edge1;
+        const float v = sign * (line.v * q);
+        if (v < 0.0f || u + v > a)
+            return false;
+        const float t = sign * (edge2 * q);
+        const bool hit = t >= 0.0f && t <= maxDistance * a;
+        ::mpn::count(::mpn::Counter::TriangleHits, hit);
+        return hit;
+    }
+
+    float Triangle::intersect(const geom::Line& line) const noexcept
+    {
+        return intersectTriangle(vertices[0], vertices[1], vertices[2], line);
+    }
+
+    bool Triangle::occludes(const geom::Line& line, float maxDistance) const noexcept
+    {
+        return occludesTriangle(vertices[0], vertices[1], vertices[2], line, maxDistance);
+    }
+
+    PrecomputedTriangle::PrecomputedTriangle(const Triangle& triangle) noexcept
+    {
+        const ::mpn::Point3& p0 = triangle.vertices[0];
+        const ::mpn::Point3& p1 = triangle.vertices[1];
+        const ::mpn::Point3& p2 = triangle.vertices[2];
+        const mpn::Vector3 edge1 = p1 - p0;
+        const mpn::Vector3 edge2 = p2 - p0;
+        const mpn::Vector3 normal = edge1 % edge2;
+        const mpn::Vector3 p2xp0 = p2.asVector() % p0.asVector();
+        const mpn::Vector3 p1xp0 = p1.asVector() % p0.asVector();
+
+        int axis = 0;
+        if (std::abs(normal[1]) > std::abs(normal[axis])) axis = 1;
+        if (std::abs(normal[2]) > std::abs(normal[axis])) axis = 2;
+        if (normal[axis] == 0.0f)
+        {
+            fixedAxis = 3;
+            axisA = axisB = 0;
+            for (float& value : m) value = 0.0f;
+            return;
+        }
+
+        // The remaining two axes in cyclic order, so that the same formulas hold for every case
+        const int a = (axis + 1) % 3;
+        const int b = (axis + 2) % 3;
+        fixedAxis = static_cast<std::uint8_t>(axis);
+        axisA = static_cast<std::uint8_t>(a);
+        axisB = static_cast<std::uint8_t>(b);
+        const float inverse = 1.0f / normal[axis];
+        m[0] = edge2[b] * inverse;
+        m[1] = -edge2[a] * inverse;
+        m[2] = p2xp0[axis] * inverse;
+        m[3] = -edge1[b] * inverse;
+        m[4] = edge1[a] * inverse;
+        m[5] = -p1xp0[axis] * inverse;
+        m[6] = normal[a] * inverse;
+        m[7] = normal[b] * inverse;
+        m[8] = -(p0.asVector() * normal) * inverse;
+    }
+
+    float PrecomputedTriangle::intersect(const geom::Line& line) const noexcept
+    {
+        float u, v;
+        return intersect(line, u, v);
+    }
+
+    float PrecomputedTriangle::intersect(const geom::Line& line, float& u, float& v) const noexcept
+    {
+        ::mpn::count(::mpn::Counter::TriangleTests);
+        if (fixedAxis == 3)
+            return INVALID_DISTANCE;
+        const int a = axisA;
+        const int b = axisB;
+
+        // Signed distance of the origin from the plane and its rate along the line, scaled by the normal component
+        const float originDistance = line.P[fixedAxis] + m[6] * line.P[a] + m[7] * line.P[b] + m[8];
+        const float directionRate = line.v[fixedAxis] + m[6] * line.v[a] + m[7] * line.v[b];
+        const float t = -originDistance / directionRate;
+        if (!(t >= 0.0f) || t == INFINITY)    // also rejects NaN for lines in the plane
+            return INVALID_DISTANCE;
+
+        const float hitA = line.P[a] + t * line.v[a];
+        const float hitB = line.P[b] + t * line.v[b];
+        u = m[0] * hitA + m[1] * hitB + m[2];
+        if (u < 0.0f || u > 1.0f)
+            return INVALID_DISTANCE;
+        v = m[3] * hitA + m[4] * hitB + m[5];
         if (v < 0.0f || u + v > 1.0f)
             return INVALID_DISTANCE;
-        return f * (edge2 * q);
+        ::mpn::count(::mpn::Counter::TriangleHits);
+        return t;
+    }
+
+    bool PrecomputedTriangle::occludes(const geom::Line& line, float maxDistance) const noexcept
+    {
+        ::mpn::count(::mpn::Counter::TriangleTests);
+        if (fixedAxis == 3)
+            return false;
+        const int a = axisA;
+        const int b = axisB;
+
+        // The same tests without the division: the distance and the barycentrics are compared scaled by the rate
+        const float originDistance = line.P[fixedAxis] + m[6] * line.P[a] + m[7] * line.P[b] + m[8];
+        const float directionRate = line.v[fixedAxis] + m[6] * line.v[a] + m[7] * line.v[b];
+        if (directionRate == 0.0f)
+            return false;    // parallel to the plane
+        const float sign = directionRate < 0.0f ? 1.0f : -1.0f;
+        const float rate = -sign * directionRate;
+        const float t = sign * originDistance;
+        if (!(t >= 0.0f && t <= maxDistance * rate))
+            return false;
+
+        const float hitA = line.P[a] * rate + t * line.v[a];
+        const float hitB = line.P[b] * rate + t * line.v[b];
+        const float u = m[0] * hitA + m[1] * hitB + m[2] * rate;
+        if (u < 0.0f || u > rate)
+            return false;
+        const float v = m[3] * hitA + m[4] * hitB + m[5] * rate;
+        if (v < 0.0f || u + v > rate)
+            return false;
+        ::mpn::count(::mpn::Counter::TriangleHits);
+        return true;
+    }
+
+    ::mpn::Point3 Triangle::closestPoint(const ::mpn::Point3& point) const noexcept
+    {
+        // Voronoi region tests of Ericson, Real-Time Collision Detection 5.1.5
+        const ::mpn::Point3& a = vertices[0];
+        const ::mpn::Point3& b = vertices[1];
+        const ::mpn::Point3& c = vertices[2];
+        const mpn::Vector3 ab = b - a;
+        const mpn::Vector3 ac = c - a;
+
+        const mpn::Vector3 ap = point - a;
+        const float d1 = ab * ap;
+        const float d2 = ac * ap;
+        if (d1 <= 0.0f && d2 <= 0.0f)
+            return a;
+
+        const mpn::Vector3 bp = point - b;
+        const float d3 = ab * bp;
+        const float d4 = ac * bp;
+        if (d3 >= 0.0f && d4 <= d3)
+            return b;
+
+        const float vc = d1 * d4 - d3 * d2;
+        if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+            return a + ab * (d1 / (d1 - d3));
+
+        const mpn::Vector3 cp = point - c;
+        const float d5 = ab * cp;
+        const float d6 = ac * cp;
+        if (d6 >= 0.0f && d5 <= d6)
+            return c;
+
+        const float vb = d5 * d2 - d1 * d6;
+        if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+            return a + ac * (d2 / (d2 - d6));
+
+        const float va = d3 * d6 - d5 * d4;
+        if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+            return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+        // Inside the face
+        const float denominator = 1.0f / (va + vb + vc);
+        return a + ab * (vb * denominator) + ac * (vc * denominator);
     }
 
     ::mpn::Point3 Triangle::getCenter() const
@@ -62,6 +257,7 @@ namespace geom {
         // as this needs to be lightning fast. Any artifacts can be eliminated by storing primitives with epsilon larger boxes.
 
         // Can be sped up even further by passing inverses externally instead of calculating here.
+        ::mpn::count(::mpn::Counter::AABBTests);
         const float vInvX = 1.0f / line.v[0];
         const float vInvY = 1.0f / line.v[1];
         const float vInvZ = 1.0f / line.v[2];
@@ -83,7 +279,45 @@ namespace geom {
         tmin = std::max(tmin, std::min(tz1, tz2));
         tmax = std::min(tmax, std::max(tz1, tz2));
 
-        return tmax >= std::max(tmin, 0.0f);
+        const bool hit = tmax >= std::max(tmin, 0.0f);
+        ::mpn::count(::mpn::Counter::AABBHits, hit);
+        return hit;
+    }
+
+    float AABB::entryDistance(const geom::Line& line) const noexcept
+    {
+        // Same slab test as intersect(), but keeps the entry distance for front-to-back traversal.
+        ::mpn::count(::mpn::Counter::AABBTests);
+        const float vInvX = 1.0f / line.v[0];
+        const float vInvY = 1.0f / line.v[1];
+        const float vInvZ = 1.0f / line.v[2];
+        float tx1 = (minCoords[0] - line.P[0]) * vInvX;
+        float tx2 = (maxCoords[0] - line.P[0]) * vInvX;
+
+        float tmin = std::min(tx1, tx2);
+        float tmax = std::max(tx1, tx2);
+
+        float ty1 = (minCoords[1] - line.P[1]) * vInvY;
+        float ty2 = (maxCoords[1] - line.P[1]) * vInvY;
+
+        tmin = std::max(tmin, std::min(ty1, ty2));
+        tmax = std::min(tmax, std::max(ty1, ty2));
+
+        float tz1 = (minCoords[2] - line.P[2]) * vInvZ;
+        float tz2 = (maxCoords[2] - line.P[2]) * vInvZ;
+
+        tmin = std::max(tmin, std::min(tz1, tz2));
+        tmax = std::min(tmax, std::max(tz1, tz2));
+
+        tmin = std::max(tmin, 0.0f);
+        ::mpn::count(::mpn::Counter::AABBHits, tmax >= tmin);
+        return tmax >= tmin ? tmin : INVALID_DISTANCE;
+    }
+
+    bool AABB::occludes(const geom::Line& line, float maxDistance) const noexcept
+    {
+        const float entry = entryDistance(line);
+        return entry >= 0.0f && entry <= maxDistance;
     }
 
     AABB AABB::_union(const AABB& left, const AABB& right)
@@ -103,6 +337,104 @@ namespace geom {
         };
     }
 
+    bool overlaps(const Triangle& triangle, const AABB& box) noexcept
+    {
+        // Everything relative to the box center, so the box is symmetric around the origin
+        const ::mpn::Point3 center = box.getCenter();
+        const ::mpn::Vector3 half = box.maxCoords - center;
+        const ::mpn::Vector3 v[3] = { triangle.vertices[0] - center, triangle.vertices[1] - center, triangle.vertices[2] - center };
+        const ::mpn::Vector3 edges[3] = { v[1] - v[0], v[2] - v[1], v[0] - v[2] };
+
+        // Projections of the triangle and the box radius on an axis are compared
+        auto separates = [&v, &half](const ::mpn::Vector3& axis)
+        {
+            const float p0 = v[0] * axis;
+            const float p1 = v[1] * axis;
+            const float p2 = v[2] * axis;
+            const float radius = half[0] * std::abs(axis[0]) + half[1] * std::abs(axis[1]) + half[2] * std::abs(axis[2]);
+            return std::min(p0, std::min(p1, p2)) > radius || std::max(p0, std::max(p1, p2)) < -radius;
+        };
+
+        // Box face normals: the bounds of the triangle against the box
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            if (std::min(v[0][axis], std::min(v[1][axis], v[2][axis])) > half[axis]
+                || std::max(v[0][axis], std::max(v[1][axis], v[2][axis])) < -half[axis])
+                return false;
+        }
+
+        // Triangle normal
+        if (separates(edges[0] % edges[1]))
+            return false;
+
+        // Cross products of the box axes with the triangle edges
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            ::mpn::Vector3 boxAxis(0.0f, 0.0f, 0.0f);
+            boxAxis[axis] = 1.0f;
+            for (const ::mpn::Vector3& edge : edges)
+            {
+                if (separates(boxAxis % edge))
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    bool clipTriangle(const Triangle& triangle, const AABB& box, AABB& clipped) noexcept
+    {
+        // Sutherland-Hodgman, every plane adds at most one vertex to the polygon
+        ::mpn::Point3 polygon[9] = { triangle.vertices[0], triangle.vertices[1], triangle.vertices[2] };
+        ::mpn::Point3 buffer[9];
+        int size = 3;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            for (int side = 0; side < 2; ++side)
+            {
+                const float plane = side == 0 ? box.minCoords[axis] : box.maxCoords[axis];
+                auto inside = [axis, side, plane](const ::mpn::Point3& point) { return side == 0 ? point[axis] >= plane : point[axis] <= plane; };
+                int clippedSize = 0;
+                for (int i = 0; i < size; ++i)
+                {
+                    const ::mpn::Point3& current = polygon[i];
+                    const ::mpn::Point3& next = polygon[(i + 1) % size];
+                    if (inside(current))
+                        buffer[clippedSize++] = current;
+                    if (inside(current) != inside(next))
+                    {
+                        const float t = (plane - current[axis]) / (next[axis] - current[axis]);
+                        ::mpn::Point3 crossing = current + (next - current) * t;
+                        crossing[axis] = plane;
+                        buffer[clippedSize++] = crossing;
+                    }
+                }
+                size = clippedSize;
+                if (size == 0)
+                    return false;
+                std::copy(buffer, buffer + size, polygon);
+            }
+        }
+
+        ::mpn::Point3 minCoords = polygon[0];
+        ::mpn::Point3 maxCoords = polygon[0];
+        for (int i = 1; i < size; ++i)
+        {
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                minCoords[axis] = std::min(minCoords[axis], polygon[i][axis]);
+                maxCoords[axis] = std::max(maxCoords[axis], polygon[i][axis]);
+            }
+        }
+        // Crossings are rounded, keep them within the box
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            minCoords[axis] = std::clamp(minCoords[axis], box.minCoords[axis], box.maxCoords[axis]);
+            maxCoords[axis] = std::clamp(maxCoords[axis], box.minCoords[axis], box.maxCoords[axis]);
+        }
+        clipped = AABB(minCoords, maxCoords);
+        return true;
+    }
+
     AABB createAABB(const Triangle& triangle)
     {
         return AABB
@@ -121,14 +453,19 @@ namespace geom {
     }
 
     AABB createAABB(std::vector<Triangle>::const_iterator begin, std::vector<Triangle>::const_iterator end)
+    {
+        return createAABB(std::span<const Triangle>(std::to_address(begin), std::to_address(end)));
+    }
+
+    AABB createAABB(std::span<const Triangle> triangles)
     {
         ::mpn::Point3 minCoords(FLT_MAX, FLT_MAX, FLT_MAX);
     	::mpn::Point3 maxCoords(-FLT_MAX, -FLT_MAX, -FLT_MAX);
-        for (std::vector<Triangle>::const_iterator it = begin; it != end; ++it)
+        for (const Triangle& triangle : triangles)
         {
             for (int vertexID = 0; vertexID < 3; ++vertexID)
             {
-                const ::mpn::Point3& vertex = it->vertices[vertexID];
+                const ::mpn::Point3& vertex = triangle.vertices[vertexID];
                 for (int axisID = 0; axisID < 3; ++axisID)
                 {
                     if (vertex[axisID] < minCoords[axisID])
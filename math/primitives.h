@@ -1,6 +1,11 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <span>
 
 #include "vector.h"
 #include "point.h"
@@ -41,17 +46,28 @@ namespace geom {
 	  - w: screen width.
 	  - h: screen height.
 	  Result is a Rectangle2D with coordinates in range [-1,+1]. */
-	//Rectangle2D coords2device(const Rectangle2D& coords, float w, float h);
+	Rectangle2D coords2device(const Rectangle2D& coords, float w, float h);
 
 	/*Converts device coordinates into pixel size coordinates.
 	  - coords: device coordinates.
 	  - w: screen width
 	  - h: screen height
 	  Result is a Rectangle2D with coordinates in range [0,w) and [0,h) respectively.*/
-	//Rectangle2D device2coords(const Rectangle2D& dev, float w, float h);
+	Rectangle2D device2coords(const Rectangle2D& dev, float w, float h);
 
 	constexpr const float INVALID_DISTANCE = -1;
 
+	/*Intersects the line with the triangle given by its vertices.
+	  Returns the distance along the line (in units of the direction vector) or INVALID_DISTANCE if it is missed.*/
+	float intersectTriangle(const ::mpn::Point3& p0, const ::mpn::Point3& p1, const ::mpn::Point3& p2, const geom::Line& line) noexcept;
+	/*Same as above, also returns the barycentric coordinates of the hit: the weights 'u' of p1 and 'v' of p2.
+	  The barycentrics are unspecified on a miss.*/
+	float intersectTriangle(const ::mpn::Point3& p0, const ::mpn::Point3& p1, const ::mpn::Point3& p2, const geom::Line& line, float& u, float& v) noexcept;
+
+	/*Checks whether the line hits the triangle given by its vertices at a distance in [0, maxDistance].
+	  Cheaper than intersectTriangle as the distance itself is never computed.*/
+	bool occludesTriangle(const ::mpn::Point3& p0, const ::mpn::Point3& p1, const ::mpn::Point3& p2, const geom::Line& line, float maxDistance) noexcept;
+
 	struct Triangle
 	{
 		::std::array<::mpn::Point3, 3> vertices;
@@ -60,12 +76,43 @@ namespace geom {
 		constexpr Triangle(::mpn::Point3 p0, ::mpn::Point3 p1, ::mpn::Point3 p2) : vertices{ p0, p1, p2 } {};
 		
 		float intersect(const geom::Line& line) const noexcept;
+		/*Occlusion query: checks whether there is a hit at a distance in [0, maxDistance].*/
+		bool occludes(const geom::Line& line, float maxDistance) const noexcept;
+
+		/*Point of the triangle (including its inside) closest to the given point.*/
+		::mpn::Point3 closestPoint(const ::mpn::Point3& point) const noexcept;
+		float distance(const ::mpn::Point3& point) const noexcept { return (point - closestPoint(point)).length(); }
 
 		::mpn::Point3 getCenter() const;
 	};
 
 	static_assert(sizeof(Triangle) <= 64, "Triangle not lightweight enough");
 
+	/*Triangle stored as the affine transformation mapping it onto the unit triangle (Baldwin-Weber).
+	  Converting from Triangle is done once, after that an intersection costs a plane test and two
+	  dot products instead of the edges and cross products Triangle::intersect computes for every line.
+	  Meant for static geometry, it cannot be converted back without loss of precision.*/
+	class PrecomputedTriangle
+	{
+	public:
+		explicit PrecomputedTriangle(const Triangle& triangle) noexcept;
+
+		/*Returns the distance of the hit or INVALID_DISTANCE if it is missed or behind the line origin.
+		  Distances and barycentrics match Triangle::intersect up to rounding.*/
+		float intersect(const geom::Line& line) const noexcept;
+		float intersect(const geom::Line& line, float& u, float& v) const noexcept;
+		/*Occlusion query: checks whether there is a hit at a distance in [0, maxDistance].*/
+		bool occludes(const geom::Line& line, float maxDistance) const noexcept;
+
+	private:
+		// Rows mapping the two projected coordinates to u and v, then the plane equation solved for the fixed axis
+		float m[9];
+		::std::uint8_t fixedAxis;	// axis of the largest normal component, 3 for degenerate triangles
+		::std::uint8_t axisA, axisB;	// the two projected axes, following the fixed one in cyclic order
+	};
+
+	static_assert(sizeof(PrecomputedTriangle) == 40, "PrecomputedTriangle not lightweight enough");
+
 	struct AABB
 	{
 		::mpn::Point3 minCoords;
@@ -81,6 +128,14 @@ namespace geom {
 		}
 
 		bool intersect(const geom::Line& line) const noexcept;
+
+		/*Returns the distance along the line at which it enters the box (zero if the line starts inside),
+		  or INVALID_DISTANCE if the box is missed. Same edge case behaviour as intersect().*/
+		float entryDistance(const geom::Line& line) const noexcept;
+
+		/*Occlusion query: checks whether the line enters the box at a distance in [0, maxDistance].*/
+		bool occludes(const geom::Line& line, float maxDistance) const noexcept;
+
 		inline ::mpn::Point3 getCenter() const noexcept {
 			return ::mpn::Point3(
 				(minCoords[0] + maxCoords[0]) / 2.0f,
@@ -89,6 +144,29 @@ namespace geom {
 			);
 		}
 
+		/*Point of the box closest to the given point, the point itself if it is inside.*/
+		::mpn::Point3 closestPoint(const ::mpn::Point3& point) const noexcept
+		{
+			return ::mpn::Point3(
+				::std::min(::std::max(point[0], minCoords[0]), maxCoords[0]),
+				::std::min(::std::max(point[1], minCoords[1]), maxCoords[1]),
+				::std::min(::std::max(point[2], minCoords[2]), maxCoords[2]));
+		}
+
+		/*Squared distance of the point from the box, zero inside.*/
+		float squaredDistance(const ::mpn::Point3& point) const noexcept
+		{
+			float result = 0.0f;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				const float outside = ::std::max(::std::max(minCoords[axis] - point[axis], point[axis] - maxCoords[axis]), 0.0f);
+				result += outside * outside;
+			}
+			return result;
+		}
+
+		float distance(const ::mpn::Point3& point) const noexcept { return ::std::sqrt(squaredDistance(point)); }
+
 		bool contains(const AABB& other) const noexcept
 		{
 			return minCoords[0] <= other.minCoords[0]
@@ -102,6 +180,24 @@ namespace geom {
 		static AABB _union(const AABB& left, const AABB& right);
 	};
 
+	/*Whether two boxes share at least a point.*/
+	inline bool overlaps(const AABB& left, const AABB& right) noexcept
+	{
+		return left.minCoords[0] <= right.maxCoords[0] && right.minCoords[0] <= left.maxCoords[0]
+			&& left.minCoords[1] <= right.maxCoords[1] && right.minCoords[1] <= left.maxCoords[1]
+			&& left.minCoords[2] <= right.maxCoords[2] && right.minCoords[2] <= left.maxCoords[2];
+	}
+
+	/*Whether the triangle and the box share at least a point (separating axis test by Akenine-Mller).
+	  Touching counts as overlapping, so voxelizing with it is conservative.*/
+	bool overlaps(const Triangle& triangle, const AABB& box) noexcept;
+
+	/*Bounds of the part of the triangle inside the box, found by clipping it against the six slab planes.
+	  Tighter than the intersection of the triangle bounds and the box for long diagonal triangles.
+	  Returns false if no part of the triangle is inside the box.*/
+	bool clipTriangle(const Triangle& triangle, const AABB& box, AABB& clipped) noexcept;
+
 	AABB createAABB(const Triangle& triangle);
 	AABB createAABB(std::vector<Triangle>::const_iterator begin, std::vector<Triangle>::const_iterator end);
+	AABB createAABB(::std::span<const Triangle> triangles);
 }
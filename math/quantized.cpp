@@ -0,0 +1,166 @@
+#include "quantized.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "counters.h"
+
+namespace geom {
+
+	QuantizationFrame::QuantizationFrame(const AABB& bounds)
+		: origin(bounds.minCoords)
+	{
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const float extent = bounds.maxCoords[axis] - bounds.minCoords[axis];
+			step[axis] = extent > 0.0f ? extent / MAX_VALUE : 1.0f;
+			// Rounding can leave the last grid point short of the maximum
+			while (decode(MAX_VALUE, axis) < bounds.maxCoords[axis])
+				step[axis] = std::nextafter(step[axis], std::numeric_limits<float>::infinity());
+		}
+	}
+
+	std::uint16_t QuantizationFrame::encode(float value, int axis) const noexcept
+	{
+		const float q = std::round((value - origin[axis]) / step[axis]);
+		return static_cast<std::uint16_t>(std::clamp(q, 0.0f, float(MAX_VALUE)));
+	}
+
+	std::uint16_t QuantizationFrame::encodeFloor(float value, int axis) const noexcept
+	{
+		const float q = std::floor((value - origin[axis]) / step[axis]);
+		std::uint16_t result = static_cast<std::uint16_t>(std::clamp(q, 0.0f, float(MAX_VALUE)));
+		// The division is not exact, make sure the grid point really is not above the value
+		while (result > 0 && decode(result, axis) > value)
+			--result;
+		return result;
+	}
+
+	std::uint16_t QuantizationFrame::encodeCeil(float value, int axis) const noexcept
+	{
+		const float q = std::ceil((value - origin[axis]) / step[axis]);
+		std::uint16_t result = static_cast<std::uint16_t>(std::clamp(q, 0.0f, float(MAX_VALUE)));
+		while (result < MAX_VALUE && decode(result, axis) < value)
+			++result;
+		return result;
+	}
+
+	QuantizedPoint3 QuantizedPoint3::encode(const ::mpn::Point3& point, const QuantizationFrame& frame) noexcept
+	{
+		return QuantizedPoint3{ { frame.encode(point[0], 0), frame.encode(point[1], 1), frame.encode(point[2], 2) } };
+	}
+
+	::mpn::Point3 QuantizedPoint3::decode(const QuantizationFrame& frame) const noexcept
+	{
+		return ::mpn::Point3(frame.decode(coords[0], 0), frame.decode(coords[1], 1), frame.decode(coords[2], 2));
+	}
+
+	QuantizedLine::QuantizedLine(const Line& line, const QuantizationFrame& frame) noexcept
+		: step(frame.step),
+		offset(frame.origin - line.P),
+		inverseDirection(1.0f / line.v[0], 1.0f / line.v[1], 1.0f / line.v[2])
+	{
+	}
+
+	QuantizedAABB QuantizedAABB::encode(const AABB& box, const QuantizationFrame& frame) noexcept
+	{
+		QuantizedAABB result;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			result.minCoords[axis] = frame.encodeFloor(box.minCoords[axis], axis);
+			result.maxCoords[axis] = frame.encodeCeil(box.maxCoords[axis], axis);
+		}
+		return result;
+	}
+
+	AABB QuantizedAABB::decode(const QuantizationFrame& frame) const
+	{
+		return AABB(
+			::mpn::Point3(frame.decode(minCoords[0], 0), frame.decode(minCoords[1], 1), frame.decode(minCoords[2], 2)),
+			::mpn::Point3(frame.decode(maxCoords[0], 0), frame.decode(maxCoords[1], 1), frame.decode(maxCoords[2], 2)));
+	}
+
+	float QuantizedAABB::entryDistance(const QuantizedLine& line) const noexcept
+	{
+		// Same slab test as AABB::entryDistance, the plane coordinates are decoded on the fly
+		::mpn::count(::mpn::Counter::AABBTests);
+		float tx1 = (float(minCoords[0]) * line.step[0] + line.offset[0]) * line.inverseDirection[0];
+		float tx2 = (float(maxCoords[0]) * line.step[0] + line.offset[0]) * line.inverseDirection[0];
+
+		float tmin = std::min(tx1, tx2);
+		float tmax = std::max(tx1, tx2);
+
+		float ty1 = (float(minCoords[1]) * line.step[1] + line.offset[1]) * line.inverseDirection[1];
+		float ty2 = (float(maxCoords[1]) * line.step[1] + line.offset[1]) * line.inverseDirection[1];
+
+		tmin = std::max(tmin, std::min(ty1, ty2));
+		tmax = std::min(tmax, std::max(ty1, ty2));
+
+		float tz1 = (float(minCoords[2]) * line.step[2] + line.offset[2]) * line.inverseDirection[2];
+		float tz2 = (float(maxCoords[2]) * line.step[2] + line.offset[2]) * line.inverseDirection[2];
+
+		tmin = std::max(tmin, std::min(tz1, tz2));
+		tmax = std::min(tmax, std::max(tz1, tz2));
+
+		tmin = std::max(tmin, 0.0f);
+		::mpn::count(::mpn::Counter::AABBHits, tmax >= tmin);
+		return tmax >= tmin ? tmin : INVALID_DISTANCE;
+	}
+
+	QuantizedMesh::QuantizedMesh(const IndexedMesh& mesh)
+		: indices(mesh.getIndices())
+	{
+		if (mesh.getBVH().empty())
+			return;
+
+		frame = QuantizationFrame(mesh.getBounds());
+
+		vertices.reserve(mesh.getVertices().size());
+		for (const ::mpn::Point3& vertex : mesh.getVertices())
+			vertices.push_back(QuantizedPoint3::encode(vertex, frame));
+
+		nodes.reserve(mesh.getBVH().getNodes().size());
+		for (const BVHNode& node : mesh.getBVH().getNodes())
+			nodes.push_back(QuantizedBVHNode{ QuantizedAABB::encode(node.bounds, frame), node.offset, node.count });
+	}
+
+	float QuantizedMesh::intersect(const Line& line, std::uint32_t* hitTriangle) const noexcept
+	{
+		if (nodes.empty())
+			return INVALID_DISTANCE;
+		const QuantizedLine quantizedLine(line, frame);
+		return traverseClosestHit(nodes.data(),
+			[&quantizedLine](const QuantizedBVHNode& node) { return node.bounds.entryDistance(quantizedLine); },
+			[this, &line](std::uint32_t index) { return intersect(index, line); },
+			hitTriangle);
+	}
+
+	float QuantizedMesh::intersect(std::uint32_t triangle, const Line& line) const noexcept
+	{
+		const IndexedMesh::Indices& triple = indices[triangle];
+		return intersectTriangle(
+			vertices[triple[0]].decode(frame),
+			vertices[triple[1]].decode(frame),
+			vertices[triple[2]].decode(frame),
+			line);
+	}
+
+	bool QuantizedMesh::occludes(const Line& line, float maxDistance) const noexcept
+	{
+		if (nodes.empty())
+			return false;
+		const QuantizedLine quantizedLine(line, frame);
+		return traverseAnyHit(nodes.data(),
+			[&quantizedLine, maxDistance](const QuantizedBVHNode& node) { return node.bounds.occludes(quantizedLine, maxDistance); },
+			[this, &line, maxDistance](std::uint32_t index)
+			{
+				const IndexedMesh::Indices& triple = indices[index];
+				return occludesTriangle(
+					vertices[triple[0]].decode(frame),
+					vertices[triple[1]].decode(frame),
+					vertices[triple[2]].decode(frame),
+					line, maxDistance);
+			});
+	}
+}
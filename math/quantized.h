@@ -0,0 +1,120 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "bvh.h"
+#include "mesh.h"
+#include "primitives.h"
+
+namespace geom {
+
+	/*16 bit fixed point grid spanning an enclosing box.
+	  A coordinate q on an axis stands for origin + q * step.*/
+	struct QuantizationFrame
+	{
+		static constexpr ::std::uint16_t MAX_VALUE = 0xFFFF;
+
+		::mpn::Point3 origin;
+		::mpn::Vector3 step;
+
+		QuantizationFrame() = default;
+		/*The grid is made large enough to represent the whole box.*/
+		explicit QuantizationFrame(const AABB& bounds);
+
+		/*Rounds to the closest grid point, clamped into the frame.*/
+		::std::uint16_t encode(float value, int axis) const noexcept;
+		/*Rounds down (towards the origin) to the grid, result is never larger than 'value'.*/
+		::std::uint16_t encodeFloor(float value, int axis) const noexcept;
+		/*Rounds up to the grid, result is never smaller than 'value' unless it is outside the frame.*/
+		::std::uint16_t encodeCeil(float value, int axis) const noexcept;
+
+		float decode(::std::uint16_t value, int axis) const noexcept { return origin[axis] + float(value) * step[axis]; }
+	};
+
+	/*Vertex quantized in a QuantizationFrame, 6 bytes instead of 12.*/
+	struct QuantizedPoint3
+	{
+		::std::array<::std::uint16_t, 3> coords;
+
+		static QuantizedPoint3 encode(const ::mpn::Point3& point, const QuantizationFrame& frame) noexcept;
+		::mpn::Point3 decode(const QuantizationFrame& frame) const noexcept;
+	};
+
+	/*Per line constants folding the frame decode into the slab test:
+	  a plane at grid value q is hit at (q * step + offset) * inverseDirection.*/
+	struct QuantizedLine
+	{
+		::mpn::Vector3 step;
+		::mpn::Vector3 offset;
+		::mpn::Vector3 inverseDirection;
+
+		QuantizedLine(const Line& line, const QuantizationFrame& frame) noexcept;
+	};
+
+	/*Box quantized in a QuantizationFrame, 12 bytes instead of 24.
+	  Encoding rounds outward, so the decoded box always contains the original one and a line that
+	  hits the original box hits the quantized one too.*/
+	struct QuantizedAABB
+	{
+		::std::array<::std::uint16_t, 3> minCoords;
+		::std::array<::std::uint16_t, 3> maxCoords;
+
+		static QuantizedAABB encode(const AABB& box, const QuantizationFrame& frame) noexcept;
+		AABB decode(const QuantizationFrame& frame) const;
+
+		/*Same as AABB::entryDistance on the decoded box, without decoding it.*/
+		float entryDistance(const QuantizedLine& line) const noexcept;
+		bool intersect(const QuantizedLine& line) const noexcept { return entryDistance(line) >= 0.0f; }
+		bool occludes(const QuantizedLine& line, float maxDistance) const noexcept
+		{
+			const float entry = entryDistance(line);
+			return entry >= 0.0f && entry <= maxDistance;
+		}
+	};
+
+	/*Node of a quantized hierarchy, same topology as BVHNode in 20 bytes instead of 32.*/
+	struct QuantizedBVHNode
+	{
+		QuantizedAABB bounds;
+		::std::uint32_t offset;
+		::std::uint32_t count;
+
+		constexpr bool isLeaf() const noexcept { return count != 0; }
+	};
+
+	static_assert(sizeof(QuantizedBVHNode) == 20, "QuantizedBVHNode should not be padded");
+
+	/*Compact version of IndexedMesh for data sets that do not fit in memory as floats.
+	  Vertices and node bounds are stored in 16 bit fixed point relative to the mesh bounds.
+	  Vertices are rounded to the closest grid point, so the geometry moves by at most half a grid step
+	  on each axis. Node bounds are rounded outward and still contain the rounded triangles.*/
+	class QuantizedMesh
+	{
+	public:
+		QuantizedMesh() = default;
+		explicit QuantizedMesh(const IndexedMesh& mesh);
+
+		/*Returns the distance of the closest hit or INVALID_DISTANCE.
+		  The index of the triangle hit is written to 'hitTriangle' if it is not null.*/
+		float intersect(const Line& line, ::std::uint32_t* hitTriangle = nullptr) const noexcept;
+
+		/*Intersects a single triangle with the decoded vertices.*/
+		float intersect(::std::uint32_t triangle, const Line& line) const noexcept;
+
+		/*Occlusion query: checks whether any triangle is hit at a distance in [0, maxDistance].*/
+		bool occludes(const Line& line, float maxDistance) const noexcept;
+
+		const QuantizationFrame& getFrame() const noexcept { return frame; }
+		const ::std::vector<QuantizedBVHNode>& getNodes() const noexcept { return nodes; }
+		const ::std::vector<QuantizedPoint3>& getVertices() const noexcept { return vertices; }
+		const ::std::vector<IndexedMesh::Indices>& getIndices() const noexcept { return indices; }
+
+	private:
+		QuantizationFrame frame;
+		::std::vector<QuantizedBVHNode> nodes;
+		::std::vector<QuantizedPoint3> vertices;
+		::std::vector<IndexedMesh::Indices> indices;
+	};
+}
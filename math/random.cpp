@@ -2,6 +2,8 @@
 
 #include <time.h>
 
+#include "counters.h"
+
 namespace mpn
 {
 	thread_local std::default_random_engine randomEngine(time(nullptr));
@@ -16,12 +18,14 @@ namespace mpn
 
 	float frand(float min, float max)
 	{
+		count(Counter::RandomDraws);
 		const std::uniform_real_distribution<float> distribution(min, max);
 		return distribution(randomEngine);
 	}
 
 	int dice(int min, int max)
 	{
+		count(Counter::RandomDraws);
 		const std::uniform_int_distribution<int> distribution(min, max - 1);
 		return distribution(randomEngine);
 	}
@@ -0,0 +1,153 @@
+#include "sdf.h"
+
+#include <cmath>
+#include <stdexcept>
+
+namespace geom {
+
+	namespace {
+
+		SDFLayout createLayout(const AABB& bounds, const SDFSettings& settings)
+		{
+			if (settings.resolution < 2)
+				throw std::invalid_argument("The resolution must be at least two samples");
+			const mpn::Vector3 extent = bounds.maxCoords - bounds.minCoords;
+			const float longest = std::max(std::max(extent[0], extent[1]), extent[2]);
+			if (!(longest > 0.0f))
+				throw std::invalid_argument("The triangles have no extent");
+
+			SDFLayout layout;
+			layout.spacing = longest / float(settings.resolution - 1);
+			const float padding = float(settings.padding) * layout.spacing;
+			layout.origin = bounds.minCoords - mpn::Vector3(padding, padding, padding);
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				layout.samples[axis] = static_cast<std::uint32_t>(std::ceil(extent[axis] / layout.spacing)) + 1 + 2 * settings.padding;
+				layout.bricks[axis] = (layout.samples[axis] + SDFBrick::SIZE - 1) / SDFBrick::SIZE;
+			}
+			return layout;
+		}
+
+		std::vector<Triangle> copyTriangles(std::span<const Triangle> triangles)
+		{
+			if (triangles.empty())
+				throw std::invalid_argument("There are no triangles to bake");
+			return std::vector<Triangle>(triangles.begin(), triangles.end());
+		}
+	}
+
+	SDFBaker::SDFBaker(std::span<const Triangle> triangles, const SDFSettings& settings)
+		: settings(settings),
+		mesh(copyTriangles(triangles)),
+		distance(mesh),
+		layout(createLayout(mesh.getBounds(), settings))	// the root bounds, same as createAABB() over the triangles
+	{
+	}
+
+	bool SDFBaker::bakeBrick(std::uint32_t index, SDFBrick& brick, float narrowBand) const
+	{
+		brick.brick = { index % layout.bricks[0], index / layout.bricks[0] % layout.bricks[1], index / layout.bricks[0] / layout.bricks[1] };
+		const std::uint32_t first[3] = { brick.brick[0] * SDFBrick::SIZE, brick.brick[1] * SDFBrick::SIZE, brick.brick[2] * SDFBrick::SIZE };
+
+		if (narrowBand < FLT_MAX)
+		{
+			// No sample is closer to the surface than the center minus half the brick diagonal
+			const float half = 0.5f * float(SDFBrick::SIZE - 1);
+			const mpn::Point3 center = layout.position(first[0], first[1], first[2]) + mpn::Vector3(half, half, half) * layout.spacing;
+			const float reach = narrowBand + half * layout.spacing * std::sqrt(3.0f);
+			if (distance.closestPoint(center, reach).distance == INVALID_DISTANCE)
+				return false;
+		}
+
+		for (int z = 0; z < SDFBrick::SIZE; ++z)
+			for (int y = 0; y < SDFBrick::SIZE; ++y)
+				for (int x = 0; x < SDFBrick::SIZE; ++x)
+				{
+					const mpn::Point3 position = layout.position(first[0] + x, first[1] + y, first[2] + z);
+					// The previous sample bounds the distance, which prunes most of the hierarchy
+					float magnitude = INVALID_DISTANCE;
+					if (x > 0)
+						magnitude = distance.closestPoint(position, std::abs(brick.at(x - 1, y, z)) + 1.001f * layout.spacing).distance;
+					if (magnitude == INVALID_DISTANCE)
+						magnitude = distance.distance(position);
+
+					// Inherit the sign of a neighbour whose empty ball covers this sample
+					float sign;
+					if (x > 0 && std::abs(brick.at(x - 1, y, z)) > layout.spacing)
+						sign = std::copysign(1.0f, brick.at(x - 1, y, z));
+					else if (y > 0 && std::abs(brick.at(x, y - 1, z)) > layout.spacing)
+						sign = std::copysign(1.0f, brick.at(x, y - 1, z));
+					else if (z > 0 && std::abs(brick.at(x, y, z - 1)) > layout.spacing)
+						sign = std::copysign(1.0f, brick.at(x, y, z - 1));
+					else
+						sign = isInside(position) ? -1.0f : 1.0f;
+					brick.at(x, y, z) = sign * magnitude;
+				}
+		return true;
+	}
+
+	SDFGrid SDFBaker::bakeDense(int threadCount) const
+	{
+		SDFGrid grid{ layout, std::vector<float>(size_t(layout.samples[0]) * layout.samples[1] * layout.samples[2]) };
+		// Bricks cover disjoint samples, but the copy is serialized by bake() anyway
+		bake([&grid](const SDFBrick& brick)
+			{
+				for (int z = 0; z < SDFBrick::SIZE; ++z)
+					for (int y = 0; y < SDFBrick::SIZE; ++y)
+						for (int x = 0; x < SDFBrick::SIZE; ++x)
+						{
+							const std::uint32_t sx = brick.brick[0] * SDFBrick::SIZE + x;
+							const std::uint32_t sy = brick.brick[1] * SDFBrick::SIZE + y;
+							const std::uint32_t sz = brick.brick[2] * SDFBrick::SIZE + z;
+							if (sx < grid.layout.samples[0] && sy < grid.layout.samples[1] && sz < grid.layout.samples[2])
+								grid.values[(size_t(sz) * grid.layout.samples[1] + sy) * grid.layout.samples[0] + sx] = brick.at(x, y, z);
+						}
+			},
+			threadCount, FLT_MAX);
+		return grid;
+	}
+
+	bool SDFBaker::isInside(const mpn::Point3& point) const noexcept
+	{
+		if (settings.sign == SignMethod::WindingNumber)
+			return windingNumber(point) > 0.5f;
+		// Majority vote, a line grazing an edge or a vertex only spoils one of the three counts
+		int votes = 0;
+		for (int axis = 0; axis < 3; ++axis)
+			votes += countCrossings(point, axis) % 2;
+		return votes >= 2;
+	}
+
+	int SDFBaker::countCrossings(const mpn::Point3& point, int axis) const noexcept
+	{
+		mpn::Vector3 direction(0.0f, 0.0f, 0.0f);
+		direction[axis] = 1.0f;
+		// Restart just past every hit; triangles sharing the crossed edge are counted once
+		const float step = layout.spacing * 1e-3f;
+		Line line(point, direction);
+		int crossings = 0;
+		for (float hit = mesh.intersect(line); hit >= 0.0f; hit = mesh.intersect(line))
+		{
+			++crossings;
+			line.P = line.P + direction * (hit + step);
+		}
+		return crossings;
+	}
+
+	float SDFBaker::windingNumber(const mpn::Point3& point) const noexcept
+	{
+		// Sum of the signed solid angles of the triangles (Van Oosterom and Strackee) over 4 pi
+		double solidAngle = 0.0;
+		for (const Triangle& triangle : mesh.getTriangles())
+		{
+			const mpn::Vector3 a = triangle.vertices[0] - point;
+			const mpn::Vector3 b = triangle.vertices[1] - point;
+			const mpn::Vector3 c = triangle.vertices[2] - point;
+			const float la = a.length(), lb = b.length(), lc = c.length();
+			const float numerator = a * (b % c);
+			const float denominator = la * lb * lc + (a * b) * lc + (a * c) * lb + (b * c) * la;
+			solidAngle += 2.0 * std::atan2(numerator, denominator);
+		}
+		return static_cast<float>(solidAngle / (4.0 * PI));
+	}
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cfloat>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "distance.h"
+#include "mesh.h"
+#include "parallel.h"
+#include "primitives.h"
+
+namespace geom {
+
+	/*How the inside of a mesh is told from the outside.*/
+	enum class SignMethod
+	{
+		RayParity,		// majority of the crossing counts of three axis aligned lines, needs a closed mesh
+		WindingNumber	// generalized winding number, tolerates holes but visits every triangle
+	};
+
+	struct SDFSettings
+	{
+		int resolution = 64;					// samples along the longest side of the bounds
+		int padding = 2;						// extra samples around the bounds on every side
+		SignMethod sign = SignMethod::RayParity;
+		float narrowBand = FLT_MAX;				// bricks farther than this from the surface are not emitted
+	};
+
+	/*Sample placement of a signed distance grid. Samples are 'spacing' apart, starting at 'origin',
+	  and grouped into bricks of SDFBrick::SIZE^3 samples; the last bricks may reach past the samples.*/
+	struct SDFLayout
+	{
+		::mpn::Point3 origin;
+		float spacing = 0.0f;
+		::std::array<::std::uint32_t, 3> samples{};
+		::std::array<::std::uint32_t, 3> bricks{};
+
+		::mpn::Point3 position(::std::uint32_t x, ::std::uint32_t y, ::std::uint32_t z) const noexcept
+		{
+			return origin + ::mpn::Vector3(float(x) * spacing, float(y) * spacing, float(z) * spacing);
+		}
+
+		size_t brickCount() const noexcept { return size_t(bricks[0]) * bricks[1] * bricks[2]; }
+	};
+
+	/*Signed distances of a block of samples, negative inside.*/
+	struct SDFBrick
+	{
+		static constexpr int SIZE = 8;
+
+		::std::array<::std::uint32_t, 3> brick{};	// brick coordinates, the first sample is brick * SIZE
+		float values[SIZE * SIZE * SIZE];			// x fastest
+
+		float& at(int x, int y, int z) noexcept { return values[(z * SIZE + y) * SIZE + x]; }
+		float at(int x, int y, int z) const noexcept { return values[(z * SIZE + y) * SIZE + x]; }
+	};
+
+	/*Dense signed distance grid, x fastest.*/
+	struct SDFGrid
+	{
+		SDFLayout layout;
+		::std::vector<float> values;
+
+		float at(::std::uint32_t x, ::std::uint32_t y, ::std::uint32_t z) const noexcept
+		{
+			return values[(size_t(z) * layout.samples[1] + y) * layout.samples[0] + x];
+		}
+	};
+
+	/*Bakes signed distance fields from triangles over a grid spanning their bounds.
+	  Bricks are independent and are handed out to worker threads one at a time. Distances come from
+	  MeshDistance; the sign is only evaluated where it cannot be inherited: a sample whose neighbour is
+	  farther from the surface than the sample spacing lies on the same side as that neighbour, so apart
+	  from a thin shell around the surface every sample takes its sign from the one before it.*/
+	class SDFBaker
+	{
+	public:
+		/*Throws std::invalid_argument if there are no triangles, they have no extent or the resolution is below 2.*/
+		SDFBaker(::std::span<const Triangle> triangles, const SDFSettings& settings);
+
+		SDFBaker(const SDFBaker&) = delete;
+		SDFBaker& operator=(const SDFBaker&) = delete;
+
+		/*Computes the brick with the given index (x fastest). Returns false, leaving the values undefined,
+		  if the brick lies entirely outside the narrow band.*/
+		bool bakeBrick(::std::uint32_t index, SDFBrick& brick) const { return bakeBrick(index, brick, settings.narrowBand); }
+
+		/*Streams the bricks within the narrow band, computed on 'threadCount' threads (mpn::defaultThreadCount() if zero).
+		  The output is called for one brick at a time, in no particular order, and must not throw.
+		 - output: void(const SDFBrick& brick)*/
+		template<typename Output>
+		void bake(Output&& output, int threadCount = 0) const
+		{
+			bake(output, threadCount, settings.narrowBand);
+		}
+
+		/*Bakes every sample into a dense grid, the narrow band is ignored.*/
+		SDFGrid bakeDense(int threadCount = 0) const;
+
+		const SDFLayout& getLayout() const noexcept { return layout; }
+
+	private:
+		template<typename Output>
+		void bake(Output&& output, int threadCount, float narrowBand) const
+		{
+			const size_t brickCount = layout.brickCount();
+			::std::atomic<size_t> nextBrick{ 0 };
+			::std::mutex outputMutex;
+			auto worker = [&]()
+			{
+				SDFBrick brick;
+				for (size_t index = nextBrick++; index < brickCount; index = nextBrick++)
+				{
+					if (!bakeBrick(static_cast<::std::uint32_t>(index), brick, narrowBand))
+						continue;
+					const ::std::lock_guard<::std::mutex> lock(outputMutex);
+					output(static_cast<const SDFBrick&>(brick));
+				}
+			};
+
+			if (threadCount <= 0)
+				threadCount = ::mpn::defaultThreadCount();
+			threadCount = static_cast<int>(::std::min<size_t>(threadCount, brickCount));
+			::std::vector<::std::thread> workers;
+			workers.reserve(threadCount - 1);
+			for (int i = 1; i < threadCount; ++i)
+				workers.emplace_back(worker);
+			worker();
+			for (::std::thread& thread : workers)
+				thread.join();
+		}
+
+		bool bakeBrick(::std::uint32_t index, SDFBrick& brick, float narrowBand) const;
+		bool isInside(const ::mpn::Point3& point) const noexcept;
+		int countCrossings(const ::mpn::Point3& point, int axis) const noexcept;
+		float windingNumber(const ::mpn::Point3& point) const noexcept;
+
+		SDFSettings settings;
+		TriangleMesh mesh;
+		MeshDistance distance;
+		SDFLayout layout;
+	};
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+/*Instruction sets available for hand vectorized kernels.
+  MSVC only reports AVX through __AVX__/__AVX2__ (/arch:AVX, /arch:AVX2), SSE2 is always there on x64.*/
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MPN_SSE2 1
+#endif
+
+#if defined(__AVX__)
+#define MPN_AVX 1
+#endif
+
+#if defined(__AVX2__)
+#define MPN_AVX2 1
+#endif
+
+/*Fused multiply-add. GCC and Clang report it separately (-mfma), MSVC has it with /arch:AVX2.*/
+#if defined(__FMA__) || (defined(_MSC_VER) && defined(__AVX2__))
+#define MPN_FMA 1
+#endif
+
+/*Half precision conversions. GCC and Clang report them separately (-mf16c), MSVC has them with /arch:AVX2.*/
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+#define MPN_F16C 1
+#endif
+
+#if defined(MPN_SSE2) || defined(MPN_AVX)
+#include <immintrin.h>
+#endif
@@ -2,7 +2,9 @@
 
 
 #include <cassert>
+#include <cmath>
 #include <ostream>
+#include <type_traits>
 
 #include "math.h"
 #include "vector.h"
@@ -17,13 +19,9 @@ namespace mpn
 	template<typename T>
 	class SphericalVector {
 		static constexpr int N = 3;
-		static constexpr size_t arraySize = N * sizeof(T);
 
 	public:
 		SphericalVector() : v{ T(0), T(0), T(0) } {}
-		SphericalVector(const SphericalVector& c) {
-			memcpy(v, c.v, arraySize);
-		}
 		
 		/*explicit SphericalVector(T _v[N]) {
 			throw exc::UnsupportedOperationException();
@@ -53,15 +51,14 @@ namespace mpn
 			else
 			{
 				//Enforcing constraints on vector values
-				const T signOfCosTheta = cosf(theta) >= 0 ? T(+1) : T(-1);
+				const T signOfCosTheta = std::cos(theta) >= 0 ? T(+1) : T(-1);
 
 				//If the inclination angle is in the wrong hemisphere,
 				//we correct by adding 180 to the direction angle.
 				if (signOfCosTheta < 0) phi += PI;
 				
-				//TODO fmodf works against template parameter)
-				v[1] = fmodf(theta, T(PI_2));
-				v[2] = fmodf(phi, T(PI * 2));
+				v[1] = std::fmod(theta, T(PI_2));
+				v[2] = std::fmod(phi, T(PI * 2));
 				if (v[2] < 0) v[2] += PI * 2;
 			}
 		}
@@ -78,12 +75,7 @@ namespace mpn
 			return v[index];
 		}*/
 
-		SphericalVector<T>& operator=(const SphericalVector<T>& rhs) {
-			memcpy(v, rhs.v, arraySize);
-			return *this;
-		}
-		
-		float length() const {
+		T length() const {
 			return v[0];
 		}
 
@@ -111,4 +103,7 @@ namespace mpn
 	}
 
 	using SphericalVector3 = SphericalVector<float>;
+
+	static_assert(std::is_trivially_copyable_v<SphericalVector3> && std::is_standard_layout_v<SphericalVector3>, "Spherical vectors must be copyable as raw memory");
+	static_assert(sizeof(SphericalVector3) == 3 * sizeof(float), "Spherical vectors must be laid out as plain float arrays");
 }
@@ -1,6 +1,7 @@
 #include "transform.h"
 #define _USE_MATH_DEFINES
 #include <math.h>
+#include <stdexcept>
 
 namespace mpn {
 
@@ -82,6 +83,15 @@ namespace mpn {
 		: T(trfMatrix), Tinv(trfMatrixInverse), Tinv_transpone(Tinv.asTransposed())
 	{
 	}
+
+	Transform::Transform(Matrix4 trfMatrix)
+		: T(trfMatrix)
+	{
+		const bool affine = T(0, 3) == 0.0f && T(1, 3) == 0.0f && T(2, 3) == 0.0f && T(3, 3) == 1.0f;
+		if (!(affine ? affineInverse(T, Tinv) : inverse(T, Tinv)))
+			throw std::invalid_argument("The transformation matrix is singular");
+		Tinv_transpone = Tinv.asTransposed();
+	}
 	
 	void Transform::translate(const Vector3& tr)
 	{
@@ -157,6 +167,7 @@ namespace mpn {
 
 	geom::Line Transform::inverseTransformLine(const geom::Line& line) const
 	{
+		count(Counter::TransformApplications);
 		/*Point3 gP(line.P * Tinv);
 		return geom::Line(gP, (line.P + line.v) * Tinv - gP);*/
 		return geom::Line(line.P * Tinv, line.v * Tinv); 
@@ -164,19 +175,41 @@ namespace mpn {
 
 	Vector3 Transform::transform(const Vector3& vector) const
 	{
+		count(Counter::TransformApplications);
 		return vector * Tinv_transpone;
 	}
 
 	Point3 Transform::transform(const Point3& point) const
 	{
+		count(Counter::TransformApplications);
 		return point * T;
 	}
 	
 	Point3 Transform::inverseTransform(const Point3& point) const
 	{
+		count(Counter::TransformApplications);
 		return point * Tinv;
 	}
 
+	geom::AABB Transform::transform(const geom::AABB& box) const
+	{
+		Point3 minCoords = transform(box.minCoords);
+		Point3 maxCoords = minCoords;
+		for (int corner = 1; corner < 8; ++corner)
+		{
+			const Point3 transformed = transform(Point3(
+				(corner & 1) ? box.maxCoords[0] : box.minCoords[0],
+				(corner & 2) ? box.maxCoords[1] : box.minCoords[1],
+				(corner & 4) ? box.maxCoords[2] : box.minCoords[2]));
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				minCoords[axis] = std::min(minCoords[axis], transformed[axis]);
+				maxCoords[axis] = std::max(maxCoords[axis], transformed[axis]);
+			}
+		}
+		return geom::AABB(minCoords, maxCoords);
+	}
+
 	Transform operator*(const Transform& left, const Transform& right) 
 	{
 		return Transform(left.T * right.T, right.Tinv * left.Tinv);
@@ -23,6 +23,9 @@ namespace mpn {
 		explicit Transform(geom::Line _rot_axis, float _rot_angle, Point3 _position);
 		explicit Transform(Vector3 _scaling, geom::Line _rot_axis, float _rot_angle, Point3 _position);
 		explicit Transform(Matrix4 trfMatrix, Matrix4 trfMatrixInverse);
+		/*Computes the inverse, with affineInverse() if the last column is (0, 0, 0, 1).
+		 Throws std::invalid_argument if the matrix is singular.*/
+		explicit Transform(Matrix4 trfMatrix);
 
 		void translate(const Vector3& tr);
 		void scale(const Vector3& sc);
@@ -31,6 +34,8 @@ namespace mpn {
 		Vector3 transform(const Vector3& vector) const;
 		Point3 transform(const Point3& point) const;
 		Point3 inverseTransform(const Point3& point) const;
+		/*Returns the axis aligned box enclosing the transformed corners of 'box'.*/
+		geom::AABB transform(const geom::AABB& box) const;
 		geom::Line inverseTransformLine(const geom::Line& line) const;
 
 		const float* const getMatrixData() const { return T.data(); }
@@ -52,44 +57,48 @@ namespace mpn {
 	template<typename T>
 	SphericalVector<T> cartesianToSpherical(const Vector<3, T>& v)
 	{
-		const float radius = v.length();
+		using std::asin, std::atan2;
+		const T radius = v.length();
 		if (radius == 0) return SphericalVector<T>();
 
-		const float theta = asinf(v[1] / radius);
-		const float phi = atan2f(v[2], v[0]);
+		const T theta = asin(v[1] / radius);
+		const T phi = atan2(v[2], v[0]);
 		return SphericalVector<T>(radius, theta, phi);
 	}
 
 	template<typename T>
 	Vector<3, T> sphericalToCartesian(const SphericalVector<T>& v)
 	{
-		const float radius = v[0];
-		const float theta = v[1];
-		const float phi = v[2];
+		using std::cos, std::sin;
+		const T radius = v[0];
+		const T theta = v[1];
+		const T phi = v[2];
 
-		const float partialResultForXAndZ = radius * cosf(theta);
+		const T partialResultForXAndZ = radius * cos(theta);
 		return Vector<3, T>(
-			partialResultForXAndZ * cosf(phi),
-			radius * sinf(theta),
-			partialResultForXAndZ * sinf(phi));
+			partialResultForXAndZ * cos(phi),
+			radius * sin(theta),
+			partialResultForXAndZ * sin(phi));
 	}
 
 	template<typename T>
 	PolarVector<T> cartesianToPolar(const Vector<2, T>& v)
 	{
-		const float radius = v.length();
-		const float theta = atan2f(v[1], v[0]);
+		using std::atan2;
+		const T radius = v.length();
+		const T theta = atan2(v[1], v[0]);
 	    return PolarVector<T>(radius, theta);
 	}
 
 	template<typename T>
 	Vector<2, T> polarToCartesian(const PolarVector<T>& v)
 	{
-		const float radius = v[0];
-		const float theta = v[1];
+		using std::cos, std::sin;
+		const T radius = v[0];
+		const T theta = v[1];
 
 		return Vector<2, T>(
-			radius * cosf(theta),
-			radius * sinf(theta));
+			radius * cos(theta),
+			radius * sin(theta));
 	}
 }
\ No newline at end of file
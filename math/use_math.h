@@ -1,11 +1,34 @@
 #pragma once
 
+#include "batch.h"
+#include "broadphase.h"
+#include "bvh.h"
+#include "camera.h"
+#include "counters.h"
+#include "distance.h"
+#include "dynamictree.h"
+#include "frustum.h"
+#include "half.h"
+#include "instancing.h"
+#include "lanes.h"
 #include "math.h"
 #include "matrix.h"
+#include "matrixx.h"
+#include "mesh.h"
+#include "meshfile.h"
+#include "obb.h"
+#include "parallel.h"
 #include "point.h"
+#include "pointindex.h"
 #include "polar.h"
 #include "primitives.h"
+#include "quantized.h"
 #include "random.h"
+#include "sdf.h"
+#include "simd.h"
 #include "spherical.h"
 #include "transform.h"
 #include "vector.h"
+#include "views.h"
+#include "voxel.h"
+#include "widebvh.h"
@@ -1,7 +1,9 @@
 #pragma once
 
 #include <cassert>
+#include <cmath>
 #include <ostream>
+#include <type_traits>
 
 #include "random.h"
 
@@ -15,14 +17,9 @@ namespace mpn
 			for (int i = 0; i < N; ++i)
 				v[i] = T(0);
 		}
-		constexpr Vector(const Vector& c) {
-			memcpy(v, c.v, arraySize);
-		}
-		constexpr explicit Vector(T _v[N]) {
-			memcpy(v, _v, arraySize);
-		}
 		constexpr explicit Vector(const T _v[N]) {
-			memcpy(v, _v, arraySize);
+			for (int i = 0; i < N; ++i)
+				v[i] = _v[i];
 		}
 
 		template<int N1 = N, typename = std::enable_if_t<N1 == 2>>
@@ -40,26 +37,22 @@ namespace mpn
 			return v[index];
 		}
 
-		constexpr Vector<N, T>& operator=(const Vector<N, T>& rhs) {
-			memcpy(v, rhs.v, arraySize);
-			return *this;
-		}
-		
 		constexpr Vector<N, T>& operator*=(float rhs) {
 			for (int i = 0; i < N; ++i)
 				v[i] *= rhs;
 			return *this;
 		}
 
-		constexpr float length() const {
-			float result = 0.0f;
+		constexpr T length() const {
+			T result = T(0);
 			for (int i = 0; i < N; ++i)
 				result += v[i] * v[i];
-			return sqrtf(result);
+			using std::sqrt;
+			return sqrt(result);
 		}
 
 		constexpr Vector<N, T> asUnitVector() const {
-			float size = length();
+			const T size = length();
 			Vector<N, T> result;
 			for (int i = 0; i < N; ++i)
 				result[i] = v[i] / size;
@@ -76,13 +69,15 @@ namespace mpn
 		}
 
 	private:
-		static constexpr size_t arraySize = N * sizeof(T);
 		T v[N];
 	};
 
 	using Vector3 = Vector<3, float>;
 	using Vector2 = Vector<2, float>;
 
+	static_assert(std::is_trivially_copyable_v<Vector3> && std::is_standard_layout_v<Vector3>, "Vectors must be copyable as raw memory");
+	static_assert(sizeof(Vector3) == 3 * sizeof(float) && alignof(Vector3) == alignof(float), "Vectors must be laid out as plain float arrays");
+
 	template<int N, typename T>
 	constexpr bool operator==(const Vector<N, T>& lhs, const Vector<N, T>& rhs) {
 		for (int i = 0; i < N; ++i)
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+
+#include "matrix.h"
+#include "point.h"
+#include "polar.h"
+#include "spherical.h"
+#include "vector.h"
+
+namespace mpn {
+
+	/*Number of floats in the float value types that can be viewed as plain float arrays, 0 for any other type.*/
+	template<typename Item>
+	constexpr size_t floatCount = 0;
+	template<int N>
+	constexpr size_t floatCount<Vector<N, float>> = N;
+	template<int N>
+	constexpr size_t floatCount<Point<N, float>> = N;
+	template<int W, int H>
+	constexpr size_t floatCount<Matrix<W, H, float>> = W * H;
+	template<>
+	constexpr size_t floatCount<PolarVector<float>> = 2;
+	template<>
+	constexpr size_t floatCount<SphericalVector<float>> = 3;
+
+	namespace layout {
+
+		template<typename Item>
+		constexpr void checkLayout() noexcept
+		{
+			static_assert(floatCount<Item> > 0, "Only the float vector, point and matrix types can be viewed as floats");
+			static_assert(std::is_trivially_copyable_v<Item> && std::is_standard_layout_v<Item>
+				&& sizeof(Item) == floatCount<Item> * sizeof(float) && alignof(Item) == alignof(float),
+				"The item must be laid out as a plain float array");
+		}
+	}
+
+	/*Views a contiguous range of vectors, points or matrices as the floats of their components, without copying.
+	  Matrices are seen column by column, like their data().*/
+	template<typename Range>
+	auto asFloats(Range&& items) noexcept
+	{
+		using Item = std::remove_reference_t<decltype(*std::ranges::data(items))>;
+		using Float = std::conditional_t<std::is_const_v<Item>, const float, float>;
+		layout::checkLayout<std::remove_const_t<Item>>();
+		return std::span<Float>(reinterpret_cast<Float*>(std::ranges::data(items)), std::ranges::size(items) * floatCount<std::remove_const_t<Item>>);
+	}
+
+	/*Views a contiguous range of floats, like a mapped file or a network buffer, as vectors, points or
+	  matrices without copying. Polar and spherical vectors are not normalized on the way.
+	 Throws std::invalid_argument if the float count is not a multiple of the item size.*/
+	template<typename Item, typename Range>
+	auto viewAs(Range&& values)
+	{
+		using Float = std::remove_reference_t<decltype(*std::ranges::data(values))>;
+		static_assert(std::is_same_v<std::remove_const_t<Float>, float>, "Only float buffers can be viewed as items");
+		using Result = std::conditional_t<std::is_const_v<Float>, const Item, Item>;
+		layout::checkLayout<Item>();
+		const size_t count = std::ranges::size(values);
+		if (count % floatCount<Item> != 0)
+			throw std::invalid_argument("The buffer does not hold a whole number of items");
+		return std::span<Result>(reinterpret_cast<Result*>(std::ranges::data(values)), count / floatCount<Item>);
+	}
+}
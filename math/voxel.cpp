@@ -0,0 +1,156 @@
+#include "voxel.h"
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+#include <thread>
+
+#include "parallel.h"
+
+namespace geom {
+
+	VoxelGrid::VoxelGrid(const ::mpn::Point3& origin, float voxelSize, const std::array<std::uint32_t, 3>& size)
+		: origin(origin), voxelSize(voxelSize), size(size), rowWords((size[0] + 63) / 64)
+	{
+		if (!(voxelSize > 0.0f))
+			throw std::invalid_argument("The voxel size must be positive");
+		if (size[0] == 0 || size[1] == 0 || size[2] == 0)
+			throw std::invalid_argument("The grid must have voxels along every axis");
+		words.assign(rowWords * size[1] * size[2], 0);
+	}
+
+	namespace {
+
+		AABB getBounds(std::span<const Triangle> triangles)
+		{
+			if (triangles.empty())
+				throw std::invalid_argument("There are no triangles to voxelize");
+			return createAABB(triangles);
+		}
+
+		// Voxel size and counts spanning the bounds, 'resolution' voxels along the longest side
+		std::array<std::uint32_t, 3> getGridSize(const AABB& bounds, int resolution, float& voxelSize)
+		{
+			if (resolution <= 0)
+				throw std::invalid_argument("The resolution must be positive");
+			const ::mpn::Vector3 extent = bounds.maxCoords - bounds.minCoords;
+			voxelSize = std::max(std::max(extent[0], extent[1]), extent[2]) / float(resolution);
+			std::array<std::uint32_t, 3> size;
+			for (int axis = 0; axis < 3; ++axis)
+				size[axis] = std::clamp(static_cast<std::uint32_t>(std::ceil(extent[axis] / voxelSize)), 1u, static_cast<std::uint32_t>(resolution));
+			return size;
+		}
+	}
+
+	VoxelGrid::VoxelGrid(std::span<const Triangle> triangles, int resolution, int threadCount)
+	{
+		const AABB bounds = getBounds(triangles);
+		float voxelSize;
+		const std::array<std::uint32_t, 3> size = getGridSize(bounds, resolution, voxelSize);
+		*this = VoxelGrid(bounds.minCoords, voxelSize, size);
+
+		// Voxel range touched by a coordinate range along an axis; the division may round across a voxel
+		// boundary, so the ends are checked against the boundaries computed as in getVoxelBounds()
+		auto cellRange = [this](float minValue, float maxValue, int axis, std::uint32_t& first, std::uint32_t& last)
+		{
+			const float limit = float(this->size[axis] - 1);
+			first = static_cast<std::uint32_t>(std::clamp(std::floor((minValue - origin[axis]) / this->voxelSize), 0.0f, limit));
+			last = static_cast<std::uint32_t>(std::clamp(std::floor((maxValue - origin[axis]) / this->voxelSize), 0.0f, limit));
+			if (first > 0 && origin[axis] + float(first) * this->voxelSize >= minValue)
+				--first;
+			if (last < this->size[axis] - 1 && origin[axis] + float(last + 1) * this->voxelSize <= maxValue)
+				++last;
+		};
+
+		// Every thread owns a slab of z slices, whose rows no other thread writes
+		if (threadCount <= 0)
+			threadCount = ::mpn::defaultThreadCount();
+		threadCount = static_cast<int>(std::min<std::uint32_t>(threadCount, size[2]));
+		const std::uint64_t slabs = static_cast<std::uint64_t>(threadCount);
+		auto slabStart = [&](std::uint64_t slab) { return static_cast<std::uint32_t>(size[2] * slab / slabs); };
+		auto slabOf = [&](std::uint32_t z) { return static_cast<std::uint32_t>(((z + 1) * slabs - 1) / size[2]); };
+
+		// Triangles binned by the slabs they touch with a counting sort, so each thread only sees its own
+		std::vector<std::uint32_t> firstSlab(triangles.size()), lastSlab(triangles.size());
+		std::vector<std::uint32_t> binOffsets(slabs + 1, 0);
+		for (size_t i = 0; i < triangles.size(); ++i)
+		{
+			const AABB box = createAABB(triangles[i]);
+			std::uint32_t first, last;
+			cellRange(box.minCoords[2], box.maxCoords[2], 2, first, last);
+			firstSlab[i] = slabOf(first);
+			lastSlab[i] = slabOf(last);
+			for (std::uint32_t slab = firstSlab[i]; slab <= lastSlab[i]; ++slab)
+				++binOffsets[slab + 1];
+		}
+		for (std::uint64_t slab = 0; slab < slabs; ++slab)
+			binOffsets[slab + 1] += binOffsets[slab];
+		std::vector<std::uint32_t> binned(binOffsets.back());
+		{
+			std::vector<std::uint32_t> next(binOffsets.begin(), binOffsets.end() - 1);
+			for (size_t i = 0; i < triangles.size(); ++i)
+				for (std::uint32_t slab = firstSlab[i]; slab <= lastSlab[i]; ++slab)
+					binned[next[slab]++] = static_cast<std::uint32_t>(i);
+		}
+
+		auto worker = [&](int thread)
+		{
+			const std::uint32_t slabBegin = slabStart(thread);
+			const std::uint32_t slabEnd = slabStart(thread + 1);
+			for (std::uint32_t bin = binOffsets[thread]; bin < binOffsets[thread + 1]; ++bin)
+			{
+				const Triangle& triangle = triangles[binned[bin]];
+				const AABB box = createAABB(triangle);
+				std::uint32_t first[3], last[3];
+				for (int axis = 0; axis < 3; ++axis)
+					cellRange(box.minCoords[axis], box.maxCoords[axis], axis, first[axis], last[axis]);
+				first[2] = std::max(first[2], slabBegin);
+				last[2] = std::min(last[2], slabEnd - 1);
+				for (std::uint32_t z = first[2]; z <= last[2]; ++z)
+					for (std::uint32_t y = first[1]; y <= last[1]; ++y)
+						for (std::uint32_t x = first[0]; x <= last[0]; ++x)
+						{
+							if (!get(x, y, z) && overlaps(triangle, getVoxelBounds(x, y, z)))
+								set(x, y, z);
+						}
+			}
+		};
+
+		std::vector<std::thread> workers;
+		workers.reserve(threadCount - 1);
+		for (int i = 1; i < threadCount; ++i)
+			workers.emplace_back(worker, i);
+		worker(0);
+		for (std::thread& thread : workers)
+			thread.join();
+	}
+
+	AABB VoxelGrid::getVoxelBounds(std::uint32_t x, std::uint32_t y, std::uint32_t z) const
+	{
+		const ::mpn::Point3 minCoords = origin + ::mpn::Vector3(float(x), float(y), float(z)) * voxelSize;
+		return AABB(minCoords, minCoords + ::mpn::Vector3(voxelSize, voxelSize, voxelSize));
+	}
+
+	float VoxelGrid::intersect(const Line& line, std::array<std::uint32_t, 3>* hitVoxel) const noexcept
+	{
+		float result = INVALID_DISTANCE;
+		traverse(line, [&](std::uint32_t x, std::uint32_t y, std::uint32_t z, float entry)
+			{
+				if (!get(x, y, z))
+					return true;
+				result = entry;
+				if (hitVoxel)
+					*hitVoxel = { x, y, z };
+				return false;
+			});
+		return result;
+	}
+
+	size_t VoxelGrid::count() const noexcept
+	{
+		size_t result = 0;
+		for (std::uint64_t word : words)
+			result += std::popcount(word);
+		return result;
+	}
+}
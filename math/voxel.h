@@ -0,0 +1,135 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "primitives.h"
+
+namespace geom {
+
+	/*Occupancy grid of cubic voxels, one bit each. Rows along x are packed into 64 bit words and padded
+	  to whole words, so rows never share a word and can be written by different threads.*/
+	class VoxelGrid
+	{
+	public:
+		VoxelGrid() = default;
+
+		/*Empty grid of the given number of voxels per axis starting at 'origin'.
+		 Throws std::invalid_argument if the voxel size is not positive or an axis has no voxels.*/
+		VoxelGrid(const ::mpn::Point3& origin, float voxelSize, const ::std::array<::std::uint32_t, 3>& size);
+
+		/*Conservative surface voxelization: every voxel touched by a triangle is set, tested with
+		  overlaps(Triangle, AABB). The grid spans the triangle bounds with 'resolution' voxels along the
+		  longest side. Slabs of z slices are filled by 'threadCount' threads (mpn::defaultThreadCount() if zero).
+		 Throws std::invalid_argument if there are no triangles, they have no extent or the resolution is not positive.*/
+		VoxelGrid(::std::span<const Triangle> triangles, int resolution, int threadCount = 0);
+
+		bool get(::std::uint32_t x, ::std::uint32_t y, ::std::uint32_t z) const noexcept
+		{
+			return (words[wordIndex(x, y, z)] >> (x % 64)) & 1;
+		}
+
+		void set(::std::uint32_t x, ::std::uint32_t y, ::std::uint32_t z) noexcept
+		{
+			words[wordIndex(x, y, z)] |= ::std::uint64_t(1) << (x % 64);
+		}
+
+		/*Box of the voxel with the given coordinates.*/
+		AABB getVoxelBounds(::std::uint32_t x, ::std::uint32_t y, ::std::uint32_t z) const;
+
+		/*Returns the distance at which the line enters the first set voxel, or INVALID_DISTANCE.
+		  The coordinates of the voxel are written to 'hitVoxel' if it is not null.*/
+		float intersect(const Line& line, ::std::array<::std::uint32_t, 3>* hitVoxel = nullptr) const noexcept;
+
+		/*3D-DDA (Amanatides and Woo): visits the voxels pierced by the line in order, set or not.
+		 - visit: bool(x, y, z, entryDistance), returns false to stop.*/
+		template<typename Visit>
+		void traverse(const Line& line, Visit&& visit) const;
+
+		/*Number of set voxels.*/
+		size_t count() const noexcept;
+
+		const ::mpn::Point3& getOrigin() const noexcept { return origin; }
+		float getVoxelSize() const noexcept { return voxelSize; }
+		const ::std::array<::std::uint32_t, 3>& getSize() const noexcept { return size; }
+
+	private:
+		size_t wordIndex(::std::uint32_t x, ::std::uint32_t y, ::std::uint32_t z) const noexcept
+		{
+			return (size_t(z) * size[1] + y) * rowWords + x / 64;
+		}
+
+		::mpn::Point3 origin;
+		float voxelSize = 0.0f;
+		::std::array<::std::uint32_t, 3> size{};
+		size_t rowWords = 0;
+		::std::vector<::std::uint64_t> words;
+	};
+
+	template<typename Visit>
+	void VoxelGrid::traverse(const Line& line, Visit&& visit) const
+	{
+		if (words.empty())
+			return;
+
+		// Clip the line to the grid
+		float tmin = 0.0f;
+		float tmax = INFINITY;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const float inverse = 1.0f / line.v[axis];
+			const float t1 = (origin[axis] - line.P[axis]) * inverse;
+			const float t2 = (origin[axis] + float(size[axis]) * voxelSize - line.P[axis]) * inverse;
+			tmin = ::std::max(tmin, ::std::min(t1, t2));
+			tmax = ::std::min(tmax, ::std::max(t1, t2));
+		}
+		if (!(tmax >= tmin))
+			return;
+
+		int cell[3], step[3];
+		float next[3], delta[3];
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			// Entry voxel, clamped as the entry point may round to just outside the grid
+			const float local = (line.P[axis] + tmin * line.v[axis] - origin[axis]) / voxelSize;
+			cell[axis] = ::std::min(::std::max(static_cast<int>(::std::floor(local)), 0), static_cast<int>(size[axis]) - 1);
+			if (line.v[axis] > 0.0f)
+			{
+				step[axis] = 1;
+				delta[axis] = voxelSize / line.v[axis];
+				next[axis] = (origin[axis] + float(cell[axis] + 1) * voxelSize - line.P[axis]) / line.v[axis];
+			}
+			else if (line.v[axis] < 0.0f)
+			{
+				step[axis] = -1;
+				delta[axis] = -voxelSize / line.v[axis];
+				next[axis] = (origin[axis] + float(cell[axis]) * voxelSize - line.P[axis]) / line.v[axis];
+			}
+			else
+			{
+				step[axis] = 0;
+				delta[axis] = INFINITY;
+				next[axis] = INFINITY;
+			}
+		}
+
+		float entry = tmin;
+		for (;;)
+		{
+			if (!visit(static_cast<::std::uint32_t>(cell[0]), static_cast<::std::uint32_t>(cell[1]), static_cast<::std::uint32_t>(cell[2]), entry))
+				return;
+			// Step across the nearest voxel boundary
+			const int axis = next[0] < next[1] ? (next[0] < next[2] ? 0 : 2) : (next[1] < next[2] ? 1 : 2);
+			if (next[axis] > tmax)
+				return;
+			cell[axis] += step[axis];
+			if (cell[axis] < 0 || cell[axis] >= static_cast<int>(size[axis]))
+				return;
+			entry = next[axis];
+			next[axis] += delta[axis];
+		}
+	}
+}
@@ -0,0 +1,361 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cfloat>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "bvh.h"
+#include "counters.h"
+#include "primitives.h"
+#include "simd.h"
+
+namespace geom {
+
+	/*Node of a hierarchy with up to N children, collapsed from a binary BVH.
+	  Child bounds are stored as structure of arrays so one line can be tested against all of them at once.
+	  Children are packed to the front, unused slots are masked out by 'childCount'.*/
+	template<int N>
+	struct alignas(64) WideBVHNode
+	{
+		float minCoords[3][N];
+		float maxCoords[3][N];
+		::std::uint32_t child[N];	// node index of an inner child, first primitive of a leaf child
+		::std::uint16_t count[N];	// number of primitives of a leaf child, 0 for inner children
+		::std::uint8_t childCount;
+	};
+
+	static_assert(sizeof(WideBVHNode<4>) == 128, "4 wide nodes should fill two cache lines");
+	static_assert(sizeof(WideBVHNode<8>) == 256, "8 wide nodes should fill four cache lines");
+
+	/*Line constants shared by all the box tests of a traversal.*/
+	struct WideLine
+	{
+		float origin[3];
+		float inverseDirection[3];
+
+		explicit WideLine(const Line& line) noexcept
+			: origin{ line.P[0], line.P[1], line.P[2] },
+			inverseDirection{ 1.0f / line.v[0], 1.0f / line.v[1], 1.0f / line.v[2] }
+		{}
+	};
+
+	/*Slab test of the line against every child of the node, the same test as AABB::entryDistance.
+	  Writes the entry distances to 'distances' and returns the bit mask of the children entered within [0, maxDistance].*/
+	template<int N>
+	int intersectChildren(const WideBVHNode<N>& node, const WideLine& line, float maxDistance, float* distances) noexcept
+	{
+		int mask = 0;
+		for (int i = 0; i < N; ++i)
+		{
+			float tmin = 0.0f;
+			float tmax = maxDistance;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				const float t1 = (node.minCoords[axis][i] - line.origin[axis]) * line.inverseDirection[axis];
+				const float t2 = (node.maxCoords[axis][i] - line.origin[axis]) * line.inverseDirection[axis];
+				tmin = ::std::max(tmin, ::std::min(t1, t2));
+				tmax = ::std::min(tmax, ::std::max(t1, t2));
+			}
+			distances[i] = tmin;
+			if (tmax >= tmin)
+				mask |= 1 << i;
+		}
+		return mask & ((1 << node.childCount) - 1);
+	}
+
+#ifdef MPN_SSE2
+	namespace wide {
+
+		// Slab test of the four children from 'first' on, the mask is not limited to the child count
+		template<int N>
+		int intersectFourChildren(const WideBVHNode<N>& node, int first, const WideLine& line, float maxDistance, float* distances) noexcept
+		{
+			__m128 tmin = _mm_setzero_ps();
+			__m128 tmax = _mm_set1_ps(maxDistance);
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				const __m128 origin = _mm_set1_ps(line.origin[axis]);
+				const __m128 inverse = _mm_set1_ps(line.inverseDirection[axis]);
+				const __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minCoords[axis] + first), origin), inverse);
+				const __m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxCoords[axis] + first), origin), inverse);
+				tmin = _mm_max_ps(tmin, _mm_min_ps(t1, t2));
+				tmax = _mm_min_ps(tmax, _mm_max_ps(t1, t2));
+			}
+			_mm_store_ps(distances + first, tmin);
+			return _mm_movemask_ps(_mm_cmpge_ps(tmax, tmin));
+		}
+	}
+
+	template<>
+	inline int intersectChildren<4>(const WideBVHNode<4>& node, const WideLine& line, float maxDistance, float* distances) noexcept
+	{
+		return wide::intersectFourChildren(node, 0, line, maxDistance, distances) & ((1 << node.childCount) - 1);
+	}
+
+#ifndef MPN_AVX
+	// Two halves of four without AVX
+	template<>
+	inline int intersectChildren<8>(const WideBVHNode<8>& node, const WideLine& line, float maxDistance, float* distances) noexcept
+	{
+		const int mask = wide::intersectFourChildren(node, 0, line, maxDistance, distances)
+			| wide::intersectFourChildren(node, 4, line, maxDistance, distances) << 4;
+		return mask & ((1 << node.childCount) - 1);
+	}
+#endif
+#endif
+
+#ifdef MPN_AVX
+	template<>
+	inline int intersectChildren<8>(const WideBVHNode<8>& node, const WideLine& line, float maxDistance, float* distances) noexcept
+	{
+		__m256 tmin = _mm256_setzero_ps();
+		__m256 tmax = _mm256_set1_ps(maxDistance);
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const __m256 origin = _mm256_set1_ps(line.origin[axis]);
+			const __m256 inverse = _mm256_set1_ps(line.inverseDirection[axis]);
+			const __m256 t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.minCoords[axis]), origin), inverse);
+			const __m256 t2 = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.maxCoords[axis]), origin), inverse);
+			tmin = _mm256_max_ps(tmin, _mm256_min_ps(t1, t2));
+			tmax = _mm256_min_ps(tmax, _mm256_max_ps(t1, t2));
+		}
+		_mm256_store_ps(distances, tmin);
+		return _mm256_movemask_ps(_mm256_cmp_ps(tmax, tmin, _CMP_GE_OQ)) & ((1 << node.childCount) - 1);
+	}
+#endif
+
+	/*Bounding volume hierarchy with N (4 or 8) children per node, for single incoherent lines.
+	  The children of a node are tested in one SSE2 register for N = 4, and in one AVX or two SSE2 registers for N = 8.
+	  Collapsed from a binary BVH and addressing the same primitive order, so a mesh can keep its
+	  primitives and only swap the hierarchy.*/
+	template<int N>
+	class WideBVH
+	{
+		static_assert(N == 4 || N == 8, "Wide nodes hold 4 or 8 children");
+
+	public:
+		WideBVH() = default;
+
+		/*Throws std::invalid_argument if a leaf of the binary hierarchy is too large for a wide node.*/
+		explicit WideBVH(const BVH& bvh);
+
+		/*Same as BVH::intersect.*/
+		template<typename IntersectPrimitive>
+		float intersect(const Line& line, IntersectPrimitive&& intersectPrimitive, ::std::uint32_t* hitPrimitive = nullptr) const;
+
+		/*Same as BVH::occludes.*/
+		template<typename OccludesPrimitive>
+		bool occludes(const Line& line, float maxDistance, OccludesPrimitive&& occludesPrimitive) const;
+
+		bool empty() const noexcept { return nodes.empty(); }
+		const ::std::vector<WideBVHNode<N>>& getNodes() const noexcept { return nodes; }
+
+	private:
+		static constexpr int STACK_SIZE = BVH::MAX_DEPTH * (N - 1) + 1;
+
+		struct StackEntry
+		{
+			::std::uint32_t child;
+			::std::uint32_t count;
+			float distance;
+		};
+
+		void collapse(::std::span<const BVHNode> binary, ::std::uint32_t binaryIndex, ::std::uint32_t wideIndex);
+
+		::std::vector<WideBVHNode<N>> nodes;
+	};
+
+	template<int N>
+	WideBVH<N>::WideBVH(const BVH& bvh)
+	{
+		if (bvh.empty())
+			return;
+		nodes.emplace_back();
+		collapse(bvh.getNodes(), 0, 0);
+	}
+
+	template<int N>
+	void WideBVH<N>::collapse(::std::span<const BVHNode> binary, ::std::uint32_t binaryIndex, ::std::uint32_t wideIndex)
+	{
+		// Open up the largest inner child until the node is full
+		::std::uint32_t slots[N];
+		int slotCount = 0;
+		const BVHNode& root = binary[binaryIndex];
+		if (root.isLeaf())
+		{
+			slots[slotCount++] = binaryIndex;
+		}
+		else
+		{
+			slots[slotCount++] = binaryIndex + 1;
+			slots[slotCount++] = root.offset;
+		}
+		while (slotCount < N)
+		{
+			int largest = -1;
+			float largestArea = -1.0f;
+			for (int i = 0; i < slotCount; ++i)
+			{
+				const BVHNode& node = binary[slots[i]];
+				if (node.isLeaf())
+					continue;
+				const ::mpn::Vector3 d = node.bounds.maxCoords - node.bounds.minCoords;
+				const float area = d[0] * d[1] + d[1] * d[2] + d[2] * d[0];
+				if (area > largestArea)
+				{
+					largestArea = area;
+					largest = i;
+				}
+			}
+			if (largest < 0)
+				break;
+			const ::std::uint32_t opened = slots[largest];
+			slots[largest] = opened + 1;
+			slots[slotCount++] = binary[opened].offset;
+		}
+
+		WideBVHNode<N> wide{};
+		wide.childCount = static_cast<::std::uint8_t>(slotCount);
+		for (int i = 0; i < N; ++i)
+		{
+			const AABB& bounds = i < slotCount ? binary[slots[i]].bounds : binary[slots[0]].bounds;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				wide.minCoords[axis][i] = bounds.minCoords[axis];
+				wide.maxCoords[axis][i] = bounds.maxCoords[axis];
+			}
+		}
+		for (int i = 0; i < slotCount; ++i)
+		{
+			const BVHNode& node = binary[slots[i]];
+			if (node.isLeaf())
+			{
+				if (node.count > UINT16_MAX)
+					throw ::std::invalid_argument("Leaf too large for a wide node");
+				wide.child[i] = node.offset;
+				wide.count[i] = static_cast<::std::uint16_t>(node.count);
+			}
+		}
+		nodes[wideIndex] = wide;
+
+		for (int i = 0; i < slotCount; ++i)
+		{
+			if (binary[slots[i]].isLeaf())
+				continue;
+			const ::std::uint32_t childIndex = static_cast<::std::uint32_t>(nodes.size());
+			nodes.emplace_back();
+			nodes[wideIndex].child[i] = childIndex;
+			collapse(binary, slots[i], childIndex);
+		}
+	}
+
+	template<int N>
+	template<typename IntersectPrimitive>
+	float WideBVH<N>::intersect(const Line& line, IntersectPrimitive&& intersectPrimitive, ::std::uint32_t* hitPrimitive) const
+	{
+		float closest = INVALID_DISTANCE;
+		if (nodes.empty())
+			return closest;
+
+		const WideLine wideLine(line);
+		StackEntry stack[STACK_SIZE];
+		int stackSize = 0;
+		::mpn::TraversalDepth<STACK_SIZE> depth;
+		stack[stackSize++] = StackEntry{ 0, 0, 0.0f };
+		while (stackSize > 0)
+		{
+			const StackEntry entry = stack[--stackSize];
+			if (closest >= 0.0f && entry.distance > closest)
+				continue;
+			depth.visit(stackSize);
+
+			if (entry.count != 0)
+			{
+				for (::std::uint32_t i = entry.child; i < entry.child + entry.count; ++i)
+				{
+					const float distance = intersectPrimitive(i, line);
+					if (distance >= 0.0f && (closest < 0.0f || distance < closest))
+					{
+						closest = distance;
+						if (hitPrimitive != nullptr)
+							*hitPrimitive = i;
+					}
+				}
+				continue;
+			}
+
+			const WideBVHNode<N>& node = nodes[entry.child];
+			alignas(32) float distances[N];
+			int mask = intersectChildren(node, wideLine, closest >= 0.0f ? closest : FLT_MAX, distances);
+			::mpn::count(::mpn::Counter::AABBTests, node.childCount);
+			::mpn::count(::mpn::Counter::AABBHits, ::std::popcount(static_cast<unsigned>(mask)));
+
+			// Push the children far to near, so the nearest one is popped first
+			StackEntry hits[N];
+			int hitCount = 0;
+			while (mask != 0)
+			{
+				const int i = ::std::countr_zero(static_cast<unsigned>(mask));
+				mask &= mask - 1;
+				StackEntry hit{ node.child[i], node.count[i], distances[i] };
+				int position = hitCount++;
+				while (position > 0 && hits[position - 1].distance < hit.distance)
+				{
+					hits[position] = hits[position - 1];
+					--position;
+				}
+				hits[position] = hit;
+			}
+			for (int i = 0; i < hitCount; ++i)
+			{
+				depth.pushChild(stackSize);
+				stack[stackSize++] = hits[i];
+			}
+		}
+		return closest;
+	}
+
+	template<int N>
+	template<typename OccludesPrimitive>
+	bool WideBVH<N>::occludes(const Line& line, float maxDistance, OccludesPrimitive&& occludesPrimitive) const
+	{
+		if (nodes.empty())
+			return false;
+
+		const WideLine wideLine(line);
+		StackEntry stack[STACK_SIZE];
+		int stackSize = 0;
+		::mpn::TraversalDepth<STACK_SIZE> depth;
+		stack[stackSize++] = StackEntry{ 0, 0, 0.0f };
+		while (stackSize > 0)
+		{
+			const StackEntry entry = stack[--stackSize];
+			depth.visit(stackSize);
+			if (entry.count != 0)
+			{
+				for (::std::uint32_t i = entry.child; i < entry.child + entry.count; ++i)
+					if (occludesPrimitive(i, line, maxDistance))
+						return true;
+				continue;
+			}
+
+			const WideBVHNode<N>& node = nodes[entry.child];
+			alignas(32) float distances[N];
+			int mask = intersectChildren(node, wideLine, maxDistance, distances);
+			::mpn::count(::mpn::Counter::AABBTests, node.childCount);
+			::mpn::count(::mpn::Counter::AABBHits, ::std::popcount(static_cast<unsigned>(mask)));
+			while (mask != 0)
+			{
+				const int i = ::std::countr_zero(static_cast<unsigned>(mask));
+				mask &= mask - 1;
+				depth.pushChild(stackSize);
+				stack[stackSize++] = StackEntry{ node.child[i], node.count[i], distances[i] };
+			}
+		}
+		return false;
+	}
+}